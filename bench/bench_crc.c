@@ -0,0 +1,165 @@
+/*
+ * compares countCrc with countCrcParallel on 1..N threads
+ * usage: bench_crc [-t THREADS] [-s SLICE_MIB] [-m SIZE_MIB] [-M] [-U DEPTH] [-c] [FILE]
+ * with -U every run is done with pread and then through io_uring with DEPTH reads queued
+ * without FILE temporary file of SIZE_MIB megabytes is generated,
+ * file is treated as SDC container with 0x100 bytes long header
+ */
+#include "../src/xsdc.h"
+
+#include <getopt.h>
+#include <sys/time.h>
+
+#define BENCH_HDRSIZE 0x100
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static int generate(char *path, size_t mib)
+{
+    int fd = mkstemp(path);
+    if(fd == -1)
+        return errno;
+    uint64_t *block = (uint64_t*)malloc(0x100000);
+    uint64_t x = 0x9e3779b97f4a7c15ULL;
+    size_t i, j;
+    for(i = 0; i < mib; i++)
+    {
+        //xorshift, so data is not trivially compressible by storage
+        for(j = 0; j < 0x100000 / sizeof(uint64_t); j++)
+        {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            block[j] = x;
+        }
+        if(write(fd, block, 0x100000) != 0x100000)
+        {
+            free(block);
+            close(fd);
+            return errno;
+        }
+    }
+    free(block);
+    close(fd);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t slice = CRC_SLICE;
+    size_t mib = 2048;
+    int noMmap = 0, cold = 0, option;
+    uint32_t ioDepth = 0;
+    while((option = getopt(argc, argv, "t:s:m:MU:c")) != -1)
+    {
+        switch(option)
+        {
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 's':
+            slice = (size_t)atoi(optarg) << 20;
+            break;
+        case 'm':
+            mib = atoi(optarg);
+            break;
+        case 'M':
+            noMmap = 1;
+            break;
+        case 'U':
+            ioDepth = atoi(optarg);
+            noMmap = 1;
+            break;
+        case 'c':
+            cold = 1;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-t THREADS] [-s SLICE_MIB] [-m SIZE_MIB] [-M] [-U DEPTH] [-c] [FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(threads < 1 || slice == 0)
+        return 1;
+
+    char tmpPath[] = "/tmp/bench_crcXXXXXX";
+    const char *path = tmpPath;
+    if(optind < argc)
+        path = argv[optind];
+    else
+    {
+        fprintf(stderr, "generating %zu MiB test file\n", mib);
+        if(generate(tmpPath, mib) != 0)
+        {
+            perror(tmpPath);
+            return 1;
+        }
+    }
+
+    SdcInput in;
+    int err = openInput(&in, path, noMmap);
+    if(err != 0)
+    {
+        errno = err;
+        perror(path);
+        return 1;
+    }
+    double mb = (in.size - BENCH_HDRSIZE - 4) / 1048576.0;
+    printf("%s: %.0f MiB, %s, slice %zu MiB%s\n", path, mb, in.map ? "mmap" : "pread",
+           slice >> 20, cold ? ", cold cache" : "");
+
+    IoRing probe;
+    if(ioDepth != 0 && initRing(&probe, 1) != 0)
+    {
+        fprintf(stderr, "io_uring not available, pread only\n");
+        ioDepth = 0;
+    }
+    else if(ioDepth != 0)
+        freeRing(&probe);
+
+    uLong reference = 0;
+    int runs = ioDepth != 0 ? 2 : 1, i;
+    for(i = 0; i < (threads + 1) * runs; i++)
+    {
+        int t = i / runs, run = i % runs;
+        in.ioDepth = run ? ioDepth : 0;
+        //drop the file from page cache (clean pages only)
+        if(cold)
+        {
+            if(in.map != NULL)
+                madvise(in.map, in.size, MADV_DONTNEED);
+            posix_fadvise(fileno(in.file), 0, 0, POSIX_FADV_DONTNEED);
+        }
+
+        double start = now();
+        uLong crc;
+        if(t == 0)
+            crc = countCrc(&in, BENCH_HDRSIZE);
+        else
+            crc = countCrcParallel(&in, BENCH_HDRSIZE, t, slice);
+        double elapsed = now() - start;
+        if(i == 0)
+            reference = crc;
+
+        if(t == 0)
+            printf("countCrc           ");
+        else
+            printf("countCrcParallel %2d", t);
+        if(ioDepth != 0)
+            printf("  %-8s", run ? "io_uring" : "pread");
+        printf("  %8.3f s  %9.1f MiB/s  crc 0x%08lX%s\n", elapsed, mb / elapsed, crc,
+               crc == reference ? "" : "  MISMATCH");
+        if(crc != reference)
+            err = 1;
+    }
+
+    closeInput(&in);
+    if(path == tmpPath)
+        unlink(tmpPath);
+    return err;
+}
@@ -0,0 +1,206 @@
+/*
+ * compares inflate backends, one call per entry, with zlib streaming the way
+ * entries larger than INFLATE_WHOLE_MAX are unpacked, on the same corpus
+ * usage: bench_inflate [-m SIZE_MIB] [-e ENTRY_KIB] [-l LEVEL] [-r ROUNDS] [FILE]
+ * corpus is FILE (or SIZE_MIB of generated text) cut into entries of ENTRY_KIB
+ * and compressed as raw deflate; every run has to reproduce it byte for byte
+ */
+#include "../src/xsdc.h"
+#include "../src/inflater.h"
+
+#include <getopt.h>
+#include <sys/time.h>
+
+typedef struct benchentry_t
+{
+  uint8_t       *packed;
+  size_t        packedLength;
+  size_t        length;
+} BenchEntry;
+
+static double now()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/*
+ * fill LENGTH bytes of BUFFER with words picked by xorshift, compresses about 3:1
+ */
+static void generate(uint8_t *buffer, size_t length)
+{
+    static const char *words[] =
+    {
+        "setup", "install", "the ", "of ", "windows ", "file ", "disk ", "image ",
+        "data", "\r\n", "key", "0x1f ", "container ", "version ", "update ", "and "
+    };
+    uint64_t x = 0x9e3779b97f4a7c15ULL;
+    size_t pos = 0;
+    while(pos < length)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        const char *word = words[x % (sizeof(words) / sizeof(words[0]))];
+        size_t n = strlen(word);
+        if(n > length - pos)
+            n = length - pos;
+        memcpy(buffer + pos, word, n);
+        pos += n;
+    }
+}
+
+static size_t compressEntry(const uint8_t *data, size_t length, int level, uint8_t **packed)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    deflateInit2(&zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    *packed = (uint8_t*)malloc(deflateBound(&zs, length));
+    zs.next_in = (Bytef*)data;
+    zs.avail_in = length;
+    zs.next_out = *packed;
+    zs.avail_out = deflateBound(&zs, length);
+    deflate(&zs, Z_FINISH);
+    size_t packedLength = zs.total_out;
+    deflateEnd(&zs);
+    return packedLength;
+}
+
+/*
+ * inflate ENTRY with zlib in 16 KiB input and 1 MiB output windows, as extractSerial does
+ */
+static int streamEntry(Inflater *inf, BenchEntry *entry, uint8_t *out)
+{
+    z_stream *stream = &inf->stream;
+    inflateReset(stream);
+    size_t consumed = 0, produced = 0;
+    int r = Z_OK;
+    while(r != Z_STREAM_END)
+    {
+        if(stream->avail_in == 0)
+        {
+            size_t part = entry->packedLength - consumed < 0x4000 ? entry->packedLength - consumed : 0x4000;
+            if(part == 0)
+                return Z_BUF_ERROR;
+            stream->next_in = entry->packed + consumed;
+            stream->avail_in = part;
+            consumed += part;
+        }
+        size_t window = entry->length - produced < 0x100000 ? entry->length - produced : 0x100000;
+        stream->next_out = out + produced;
+        stream->avail_out = window;
+        r = inflate(stream, Z_NO_FLUSH);
+        if(r < Z_OK)
+            return r;
+        produced += window - stream->avail_out;
+    }
+    return produced == entry->length ? Z_OK : Z_BUF_ERROR;
+}
+
+int main(int argc, char **argv)
+{
+    size_t mib = 256, entryKib = 1024;
+    int level = 6, rounds = 3, option;
+    while((option = getopt(argc, argv, "m:e:l:r:")) != -1)
+    {
+        switch(option)
+        {
+        case 'm':
+            mib = atoi(optarg);
+            break;
+        case 'e':
+            entryKib = atoi(optarg);
+            break;
+        case 'l':
+            level = atoi(optarg);
+            break;
+        case 'r':
+            rounds = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-m SIZE_MIB] [-e ENTRY_KIB] [-l LEVEL] [-r ROUNDS] [FILE]\n", argv[0]);
+            return 1;
+        }
+    }
+    size_t entrySize = entryKib << 10;
+    if(mib == 0 || entrySize == 0 || entrySize > INFLATE_WHOLE_MAX || rounds < 1)
+        return 1;
+
+    //corpus
+    size_t total = mib << 20;
+    uint8_t *corpus;
+    if(optind < argc)
+    {
+        SdcInput in;
+        int err = openInput(&in, argv[optind], 0);
+        if(err != 0)
+        {
+            errno = err;
+            perror(argv[optind]);
+            return 1;
+        }
+        total = in.size;
+        corpus = (uint8_t*)malloc(total);
+        readInput(&in, 0, corpus, total);
+        closeInput(&in);
+    }
+    else
+    {
+        corpus = (uint8_t*)malloc(total);
+        generate(corpus, total);
+    }
+    uint32_t count = (total + entrySize - 1) / entrySize, i;
+    BenchEntry *entries = (BenchEntry*)calloc(count, sizeof(BenchEntry));
+    size_t packedTotal = 0;
+    for(i = 0; i < count; i++)
+    {
+        size_t start = (size_t)i * entrySize;
+        entries[i].length = total - start < entrySize ? total - start : entrySize;
+        entries[i].packedLength = compressEntry(corpus + start, entries[i].length, level, &entries[i].packed);
+        packedTotal += entries[i].packedLength;
+    }
+    printf("%s: %.1f MiB in %u entries of %zu KiB, compressed to %.1f MiB at level %d\n",
+           optind < argc ? argv[optind] : "generated text", total / 1048576.0, count, entryKib,
+           packedTotal / 1048576.0, level);
+
+    uint8_t *out = (uint8_t*)malloc(entrySize);
+    int failed = 0, b;
+    for(b = -1; b == -1 || inflateBackendAt(b) != NULL; b++)
+    {
+        //-1 is streaming zlib, the rest are one-shot backends
+        selectInflateBackend(b < 0 ? "zlib" : inflateBackendAt(b));
+        Inflater inf;
+        initInflater(&inf, SIG_ENCRYPTED);
+        double best = 0;
+        int r, mismatch = 0;
+        for(r = -1; r < rounds; r++)
+        {
+            //round -1 only checks output against corpus, it is not timed
+            double start = now();
+            for(i = 0; i < count; i++)
+            {
+                int result = b < 0 ? streamEntry(&inf, &entries[i], out)
+                                   : inflateWhole(&inf, entries[i].packed, entries[i].packedLength, out, entries[i].length);
+                if(r < 0 && (result != Z_OK || memcmp(out, corpus + (size_t)i * entrySize, entries[i].length) != 0))
+                    mismatch = 1;
+            }
+            double elapsed = now() - start;
+            if(r < 0)
+                continue;
+            if(r == 0 || elapsed < best)
+                best = elapsed;
+        }
+        freeInflater(&inf);
+        printf("%-10s %-9s  %8.3f s  %9.1f MiB/s%s\n", b < 0 ? "zlib" : inflateBackendAt(b),
+               b < 0 ? "streaming" : "one-shot", best, total / 1048576.0 / best, mismatch ? "  MISMATCH" : "");
+        failed |= mismatch;
+    }
+
+    for(i = 0; i < count; i++)
+        free(entries[i].packed);
+    free(entries);
+    free(out);
+    free(corpus);
+    return failed;
+}
@@ -0,0 +1,421 @@
+/*
+ * times core kernels on buffers of 64 B up to MAX_MIB, reports median ns/byte
+ * and GB/s of REPS samples taken after WARMUP ones, with minimum and spread
+ * usage: bench_kernels [-M MAX_MIB] [-r REPS] [-w WARMUP] [-k KERNEL]...
+ *                      [-b BASELINE] [-T PERCENT] [-o BASELINE]
+ * -b compares medians with BASELINE and fails if any is more than PERCENT
+ * (default 10) slower, -o writes medians of this run as new baseline
+ */
+#include "../src/xsdc.h"
+#include "../src/inflater.h"
+#include "../src/output.h"
+
+#include <getopt.h>
+#include <math.h>
+
+//every sample runs kernel at least this long
+#define BENCH_SAMPLE_NS 20000000.0
+
+//larger sizes of kernel are skipped once one call takes longer than this
+#define BENCH_CALL_NS 500000000.0
+
+//copies of input prepared at once for kernels that change it
+#define BENCH_POOL_BYTES 0x4000000
+
+typedef struct kernel_t
+{
+  const char    *name;
+  void          (*setup)(uint8_t *data, size_t size);	//fill input of SIZE bytes, may be NULL
+  void          (*run)(uint8_t *data, size_t size);
+  int           consumes;	//run changes input so that next run would differ, it gets fresh copy
+  size_t        maxSize;	//largest size kernel is used for, 0 for no limit
+} Kernel;
+
+typedef struct result_t
+{
+  const char    *kernel;
+  size_t        size;
+  double        median;	//ns per byte
+} Result;
+
+static BlowfishKey benchKey;
+static Inflater benchInflater;
+static uint8_t *packed = NULL, *unpacked = NULL;
+static size_t packedLength = 0;
+static volatile uLong crcSink;
+
+static double nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*
+ * fill LENGTH bytes of BUFFER with words picked by xorshift, compresses about 3:1
+ */
+static void generate(uint8_t *buffer, size_t length)
+{
+    static const char *words[] =
+    {
+        "setup", "install", "the ", "of ", "windows ", "file ", "disk ", "image ",
+        "data", "\r\n", "key", "0x1f ", "container ", "version ", "update ", "and "
+    };
+    uint64_t x = 0x9e3779b97f4a7c15ULL;
+    size_t pos = 0;
+    while(pos < length)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        const char *word = words[x % (sizeof(words) / sizeof(words[0]))];
+        size_t n = strlen(word);
+        if(n > length - pos)
+            n = length - pos;
+        memcpy(buffer + pos, word, n);
+        pos += n;
+    }
+}
+
+static void runDecryptData(uint8_t *data, size_t size)
+{
+    uint32_t length = size;
+    decryptData(data, &length, data, "0123456789qWeRtYuIoPaSdFgHjKlZxC", 32);
+}
+
+static void runBlowfish(uint8_t *data, size_t size)
+{
+    blowfishDecrypt(&benchKey, data, size);
+}
+
+static void runXor(uint8_t *data, size_t size)
+{
+    xorBuffer(0x5a, data, size);
+}
+
+static void runCountCrc(uint8_t *data, size_t size)
+{
+    //data area starts after 4 bytes of header size
+    SdcInput in;
+    openMemory(&in, data, size + 4);
+    crcSink = countCrc(&in, 0);
+}
+
+/*
+ * directory names of 4 to 11 bytes separated by backslashes, terminated
+ */
+static void setupPath(uint8_t *data, size_t size)
+{
+    generate(data, size);
+    size_t i;
+    for(i = 0; i < size; i++)
+    {
+        if(data[i] == ' ' || data[i] == '\r' || data[i] == '\n')
+            data[i] = '\\';
+    }
+    data[size - 1] = '\0';
+}
+
+static void runPath(uint8_t *data, size_t size)
+{
+    dosPathToUnix((char*)data);
+}
+
+/*
+ * compress SIZE bytes of text as raw deflate for inflate kernels
+ */
+static void setupInflate(uint8_t *data, size_t size)
+{
+    free(packed);
+    free(unpacked);
+    generate(data, size);
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    deflateInit2(&zs, 6, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    size_t bound = deflateBound(&zs, size);
+    packed = (uint8_t*)malloc(bound);
+    unpacked = (uint8_t*)malloc(size);
+    zs.next_in = data;
+    zs.avail_in = size;
+    zs.next_out = packed;
+    zs.avail_out = bound;
+    deflate(&zs, Z_FINISH);
+    packedLength = zs.total_out;
+    deflateEnd(&zs);
+}
+
+/*
+ * inflate in 16 KiB input and OUTPUT_BUFFER output windows, as extractSerial does
+ */
+static void runInflate(uint8_t *data, size_t size)
+{
+    z_stream *stream = &benchInflater.stream;
+    inflateReset(stream);
+    size_t consumed = 0, produced = 0;
+    int r = Z_OK;
+    while(r == Z_OK)
+    {
+        if(stream->avail_in == 0)
+        {
+            size_t part = packedLength - consumed < 0x4000 ? packedLength - consumed : 0x4000;
+            stream->next_in = packed + consumed;
+            stream->avail_in = part;
+            consumed += part;
+        }
+        size_t window = size - produced < OUTPUT_BUFFER ? size - produced : OUTPUT_BUFFER;
+        stream->next_out = unpacked + produced;
+        stream->avail_out = window;
+        r = inflate(stream, Z_NO_FLUSH);
+        produced += window - stream->avail_out;
+    }
+}
+
+static void runInflateWhole(uint8_t *data, size_t size)
+{
+    inflateWhole(&benchInflater, packed, packedLength, unpacked, size);
+}
+
+static const Kernel kernels[] =
+{
+  {"decryptData", NULL, runDecryptData, 0, 0},
+  {"blowfish", NULL, runBlowfish, 0, 0},
+  {"xorBuffer", NULL, runXor, 0, 0},
+  {"countCrc", NULL, runCountCrc, 0, 0},
+  {"dosPathToUnix", setupPath, runPath, 1, 0},
+  {"inflate", setupInflate, runInflate, 0, 0},
+  {"inflateWhole", setupInflate, runInflateWhole, 0, INFLATE_WHOLE_MAX}
+};
+
+#define KERNEL_COUNT (sizeof(kernels) / sizeof(kernels[0]))
+
+static int byValue(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * return ns taken by ITERATIONS runs of KERNEL on SIZE bytes; kernels that
+ * change input run on copies of INPUT prepared in POOL of COPIES untimed
+ */
+static double sample(const Kernel *kernel, uint8_t *input, uint8_t *pool, size_t copies, size_t size,
+                     uint64_t iterations)
+{
+    double elapsed = 0;
+    uint64_t done = 0;
+    while(done < iterations)
+    {
+        uint64_t batch = iterations - done, i;
+        if(kernel->consumes && batch > copies)
+            batch = copies;
+        if(kernel->consumes)
+        {
+            for(i = 0; i < batch; i++)
+                memcpy(pool + i * size, input, size);
+        }
+        double start = nowNs();
+        for(i = 0; i < batch; i++)
+            kernel->run(kernel->consumes ? pool + i * size : input, size);
+        elapsed += nowNs() - start;
+        done += batch;
+    }
+    return elapsed;
+}
+
+/*
+ * return median ns/byte of SIZE in BASELINE of COUNT results of KERNEL, 0 if not there
+ */
+static double baselineOf(const Result *baseline, uint32_t count, const char *kernel, size_t size)
+{
+    uint32_t i;
+    for(i = 0; i < count; i++)
+    {
+        if(baseline[i].size == size && strcmp(baseline[i].kernel, kernel) == 0)
+            return baseline[i].median;
+    }
+    return 0;
+}
+
+/*
+ * load results from baseline file at PATH into RESULTS, returns their number or
+ * -1 when file cannot be read
+ */
+static int loadBaseline(const char *path, Result **results)
+{
+    FILE *f = fopen(path, "r");
+    if(f == NULL)
+        return -1;
+    char name[64];
+    unsigned long long size;
+    double median;
+    int count = 0;
+    *results = NULL;
+    while(fscanf(f, "%63s %llu %lf", name, &size, &median) == 3)
+    {
+        *results = (Result*)realloc(*results, sizeof(Result) * (count + 1));
+        (*results)[count].kernel = strdup(name);
+        (*results)[count].size = size;
+        (*results)[count].median = median;
+        count++;
+    }
+    fclose(f);
+    return count;
+}
+
+static const char *formatSize(char *buffer, size_t size)
+{
+    if(size >= 0x100000)
+        sprintf(buffer, "%zu MiB", size >> 20);
+    else if(size >= 0x400)
+        sprintf(buffer, "%zu KiB", size >> 10);
+    else
+        sprintf(buffer, "%zu B", size);
+    return buffer;
+}
+
+int main(int argc, char **argv)
+{
+    size_t maxMib = 64;
+    int reps = 9, warmup = 2, option;
+    double threshold = 10;
+    const char *baselinePath = NULL, *outPath = NULL;
+    const char *selected[KERNEL_COUNT];
+    uint32_t selectedCount = 0;
+    while((option = getopt(argc, argv, "M:r:w:k:b:T:o:")) != -1)
+    {
+        switch(option)
+        {
+        case 'M':
+            maxMib = atoi(optarg);
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        case 'w':
+            warmup = atoi(optarg);
+            break;
+        case 'k':
+            if(selectedCount < KERNEL_COUNT)
+                selected[selectedCount++] = optarg;
+            break;
+        case 'b':
+            baselinePath = optarg;
+            break;
+        case 'T':
+            threshold = atof(optarg);
+            break;
+        case 'o':
+            outPath = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-M MAX_MIB] [-r REPS] [-w WARMUP] [-k KERNEL]... [-b BASELINE] "
+                    "[-T PERCENT] [-o BASELINE]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(maxMib == 0 || reps < 1 || warmup < 0)
+        return 1;
+
+    Result *baseline = NULL;
+    int baselineCount = 0;
+    if(baselinePath != NULL && (baselineCount = loadBaseline(baselinePath, &baseline)) < 0)
+    {
+        perror(baselinePath);
+        return 1;
+    }
+    FILE *out = NULL;
+    if(outPath != NULL && (out = fopen(outPath, "w")) == NULL)
+    {
+        perror(outPath);
+        return 1;
+    }
+
+    initKernels();
+    blowfishInit(&benchKey, "cXzLkJhGfDsApOiUyTrEwQ0987654321", 32);
+    selectInflateBackend(inflateBackendAt(0));
+    initInflater(&benchInflater, SIG_ENCRYPTED);
+    size_t maxSize = maxMib << 20;
+    uint8_t *input = (uint8_t*)malloc(maxSize + 4);
+    uint8_t *pool = (uint8_t*)malloc(maxSize > BENCH_POOL_BYTES ? maxSize : BENCH_POOL_BYTES);
+    printf("%s kernels, %s inflate, median of %d samples after %d warmup\n", kernelName(),
+           inflateBackendName(), reps, warmup);
+    printf("%-14s %8s %10s %8s %10s %7s %8s\n", "kernel", "size", "ns/byte", "GB/s", "min", "spread", "base");
+
+    double *samples = (double*)malloc(sizeof(double) * reps);
+    uint32_t k, regressions = 0;
+    for(k = 0; k < KERNEL_COUNT; k++)
+    {
+        const Kernel *kernel = &kernels[k];
+        uint32_t s;
+        for(s = 0; s < selectedCount && strcmp(selected[s], kernel->name) != 0; s++)
+            ;
+        if(selectedCount != 0 && s == selectedCount)
+            continue;
+
+        size_t size;
+        int tooSlow = 0;
+        for(size = 64; size <= maxSize && (kernel->maxSize == 0 || size <= kernel->maxSize); size *= 4)
+        {
+            char sizeText[24];
+            formatSize(sizeText, size);
+            if(tooSlow)
+            {
+                printf("%-14s %8s %10s\n", kernel->name, sizeText, "skipped");
+                continue;
+            }
+            generate(input, size + 4);
+            if(kernel->setup != NULL)
+                kernel->setup(input, size);
+            size_t copies = BENCH_POOL_BYTES / size;
+            if(copies == 0)
+                copies = 1;
+
+            //as many runs as fill a sample, first call warms up caches
+            double one = sample(kernel, input, pool, copies, size, 1);
+            uint64_t iterations = one >= BENCH_SAMPLE_NS ? 1 : (uint64_t)(BENCH_SAMPLE_NS / (one > 1 ? one : 1)) + 1;
+            tooSlow = one > BENCH_CALL_NS;
+            int i;
+            for(i = 0; i < warmup; i++)
+                sample(kernel, input, pool, copies, size, iterations);
+            double mean = 0;
+            for(i = 0; i < reps; i++)
+            {
+                samples[i] = sample(kernel, input, pool, copies, size, iterations) / ((double)iterations * size);
+                mean += samples[i] / reps;
+            }
+            double deviation = 0;
+            for(i = 0; i < reps; i++)
+                deviation += (samples[i] - mean) * (samples[i] - mean) / reps;
+            qsort(samples, reps, sizeof(double), byValue);
+            double median = reps % 2 ? samples[reps / 2] : (samples[reps / 2 - 1] + samples[reps / 2]) / 2;
+
+            char compared[32] = "-";
+            double base = baselineOf(baseline, baselineCount, kernel->name, size);
+            int regressed = base > 0 && median > base * (1 + threshold / 100);
+            if(base > 0)
+                snprintf(compared, sizeof(compared), "%+.1f%%", (median / base - 1) * 100);
+            printf("%-14s %8s %10.4f %8.3f %10.4f %6.1f%% %8s%s\n", kernel->name, sizeText, median, 1 / median,
+                   samples[0], sqrt(deviation) / mean * 100, compared, regressed ? "  REGRESSION" : "");
+            fflush(stdout);
+            regressions += regressed;
+            if(out != NULL)
+                fprintf(out, "%s %zu %.6f\n", kernel->name, size, median);
+        }
+    }
+
+    if(baselinePath != NULL)
+        printf("%u results more than %.0f%% slower than %s\n", regressions, threshold, baselinePath);
+    if(out != NULL)
+        fclose(out);
+    freeInflater(&benchInflater);
+    free(samples);
+    free(pool);
+    free(input);
+    free(packed);
+    free(unpacked);
+    int i;
+    for(i = 0; i < baselineCount; i++)
+        free((char*)baseline[i].kernel);
+    free(baseline);
+    return regressions != 0 ? 2 : 0;
+}
@@ -0,0 +1,215 @@
+#include "batch.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+typedef struct batchpool_t
+{
+  BatchItem     *items;
+  uint32_t      count;
+  uint32_t      *order;	//items in order they should be started
+  uint8_t       *taken;	//per item, set when some worker took it
+  uint32_t      left;	//items not taken yet
+  uint32_t      running;
+  size_t        used;	//memory of running items
+  size_t        budget;
+  uint32_t      failed;
+  int           (*unpack)(BatchItem*, void*);
+  void          *arg;
+  void          (*report)(BatchItem*);
+  pthread_mutex_t lock;
+  pthread_cond_t  freed;	//signalled when running item finishes
+} BatchPool;
+
+int addBatchItem(BatchItem **items, uint32_t *count, const char *path, const char *key)
+{
+    BatchItem *grown = (BatchItem*)realloc(*items, sizeof(BatchItem) * (*count + 1));
+    if(grown == NULL)
+        return errno;
+    *items = grown;
+    BatchItem *item = &grown[*count];
+    memset(item, 0, sizeof(BatchItem));
+    item->path = strdup(path);
+    if(key != NULL)
+        item->key = strdup(key);
+    (*count)++;
+    return 0;
+}
+
+int loadManifest(BatchItem **items, uint32_t *count, const char *path)
+{
+    FILE *manifest = fopen(path, "r");
+    if(manifest == NULL)
+        return errno;
+
+    char *line = NULL;
+    size_t capacity = 0;
+    ssize_t length;
+    int result = 0;
+    while(result == 0 && (length = getline(&line, &capacity, manifest)) != -1)
+    {
+        //strip line ending, also the windows one
+        while(length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+            line[--length] = '\0';
+        if(length == 0 || line[0] == '#')
+            continue;
+
+        char *key = strchr(line, '\t');
+        if(key != NULL)
+            *key++ = '\0';
+        result = addBatchItem(items, count, line, key);
+    }
+    free(line);
+    fclose(manifest);
+    return result;
+}
+
+void freeBatchItems(BatchItem *items, uint32_t count)
+{
+    uint32_t i;
+    for(i = 0; i < count; i++)
+    {
+        free(items[i].path);
+        free(items[i].key);
+    }
+    free(items);
+}
+
+typedef struct sortkey_t
+{
+  off_t         size;
+  uint32_t      index;
+} SortKey;
+
+static int bySizeDesc(const void *a, const void *b)
+{
+    const SortKey *ka = (const SortKey*)a;
+    const SortKey *kb = (const SortKey*)b;
+    if(ka->size != kb->size)
+        return ka->size > kb->size ? -1 : 1;
+    //keep order of equal ones as given
+    return ka->index < kb->index ? -1 : 1;
+}
+
+void orderBatch(BatchItem *items, uint32_t count, uint32_t *order)
+{
+    if(count == 0)
+        return;
+    SortKey *sorted = (SortKey*)malloc(sizeof(SortKey) * count);
+    uint32_t i;
+    for(i = 0; i < count; i++)
+    {
+        sorted[i].size = items[i].size;
+        sorted[i].index = i;
+    }
+    qsort(sorted, count, sizeof(SortKey), bySizeDesc);
+
+    //large one, small one, next large one...
+    uint32_t low = 0, high = count - 1;
+    for(i = 0; i < count; i++)
+        order[i] = (i % 2 == 0) ? sorted[low++].index : sorted[high--].index;
+    free(sorted);
+}
+
+/*
+ * take next item that fits into budget, waits while nothing fits; NULL when all are taken
+ */
+static BatchItem *takeItem(BatchPool *pool)
+{
+    BatchItem *item = NULL;
+    pthread_mutex_lock(&pool->lock);
+    while(item == NULL && pool->left > 0)
+    {
+        uint32_t i;
+        for(i = 0; i < pool->count; i++)
+        {
+            uint32_t index = pool->order[i];
+            if(pool->taken[index])
+                continue;
+            size_t memory = pool->items[index].memory;
+            if(pool->budget == 0 || pool->running == 0 || pool->used + memory <= pool->budget)
+            {
+                item = &pool->items[index];
+                pool->taken[index] = 1;
+                pool->left--;
+                pool->running++;
+                pool->used += memory;
+                break;
+            }
+        }
+        if(item == NULL)
+            pthread_cond_wait(&pool->freed, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return item;
+}
+
+static void *batchWorker(void *arg)
+{
+    BatchPool *pool = (BatchPool*)arg;
+    BatchItem *item;
+    while((item = takeItem(pool)) != NULL)
+    {
+        item->status = pool->unpack(item, pool->arg);
+
+        pthread_mutex_lock(&pool->lock);
+        item->done = 1;
+        pool->running--;
+        pool->used -= item->memory;
+        if(item->status != 0)
+            pool->failed++;
+        if(pool->report)
+            pool->report(item);
+        pthread_cond_broadcast(&pool->freed);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+uint32_t runBatch(BatchItem *items, uint32_t count, int workers, size_t budget,
+                  int (*unpack)(BatchItem*, void*), void *arg, void (*report)(BatchItem*))
+{
+    BatchPool pool;
+    pool.items = items;
+    pool.count = count;
+    pool.order = (uint32_t*)malloc(sizeof(uint32_t) * (count ? count : 1));
+    pool.taken = (uint8_t*)calloc(count ? count : 1, 1);
+    pool.left = count;
+    pool.running = 0;
+    pool.used = 0;
+    pool.budget = budget;
+    pool.failed = 0;
+    pool.unpack = unpack;
+    pool.arg = arg;
+    pool.report = report;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.freed, NULL);
+    orderBatch(items, count, pool.order);
+
+    if(workers > count)
+        workers = count;
+    if(workers < 1)
+        workers = 1;
+    pthread_t *threads = (pthread_t*)malloc(sizeof(pthread_t) * workers);
+    int i, started = 0;
+    for(i = 0; i < workers; i++)
+    {
+        if(pthread_create(&threads[started], NULL, batchWorker, &pool) == 0)
+            started++;
+    }
+
+    //could not start any thread, do the work here
+    if(started == 0)
+        batchWorker(&pool);
+    for(i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
+    free(pool.order);
+    free(pool.taken);
+    pthread_cond_destroy(&pool.freed);
+    pthread_mutex_destroy(&pool.lock);
+    return pool.failed;
+}
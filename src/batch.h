@@ -0,0 +1,53 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+typedef struct batchitem_t
+{
+  char          *path;	//container to unpack
+  char          *key;	//key string, NULL for content of PATH.key
+  off_t         size;	//size of container in bytes, 0 if not known
+  size_t        memory;	//memory needed while container is unpacked
+  int           status;	//exit status of unpacking, valid when done
+  int           done;
+} BatchItem;
+
+/*
+ * append container PATH with KEY (may be NULL) to ITEMS of COUNT entries,
+ * both strings are copied; returns 0 or errno
+ */
+int addBatchItem(BatchItem **items, uint32_t *count, const char *path, const char *key);
+
+/*
+ * append containers listed in manifest at PATH to ITEMS of COUNT entries; every
+ * non-empty line is a path, optionally followed by a tab and key string,
+ * lines starting with # are skipped; returns 0 or errno
+ */
+int loadManifest(BatchItem **items, uint32_t *count, const char *path);
+
+/*
+ * free strings and array of COUNT ITEMS
+ */
+void freeBatchItems(BatchItem *items, uint32_t count);
+
+/*
+ * fill ORDER with indices of COUNT ITEMS alternating the largest and the
+ * smallest container not yet ordered
+ */
+void orderBatch(BatchItem *items, uint32_t count, uint32_t *order);
+
+/*
+ * unpack COUNT ITEMS with UNPACK (its result is stored as item status) on WORKERS
+ * threads; items are taken in orderBatch order, skipping those that would exceed
+ * BUDGET bytes (0 for no limit) together with items being unpacked, an item is
+ * always started when nothing else runs; REPORT (may be NULL) is called serialized
+ * after every item; returns number of items with non-zero status
+ */
+uint32_t runBatch(BatchItem *items, uint32_t count, int workers, size_t budget,
+                  int (*unpack)(BatchItem*, void*), void *arg, void (*report)(BatchItem*));
+
+#endif
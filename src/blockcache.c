@@ -0,0 +1,191 @@
+#include "blockcache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+int initBlockCache(BlockCache *cache, uint32_t blockSize, uint64_t budget)
+{
+    memset(cache, 0, sizeof(BlockCache));
+    cache->blockSize = blockSize ? blockSize : BLOCK_SIZE;
+    cache->budget = budget;
+
+    //about two buckets per block that fits in budget
+    uint64_t blocks = budget / cache->blockSize + 1;
+    uint32_t size = 64;
+    while(size < blocks * 2 && size < 0x1000000)
+        size <<= 1;
+    cache->buckets = (CachedBlock**)calloc(size, sizeof(CachedBlock*));
+    if(cache->buckets == NULL)
+        return ENOMEM;
+    cache->mask = size - 1;
+    return 0;
+}
+
+void freeBlockCache(BlockCache *cache)
+{
+    CachedBlock *b = cache->newest;
+    while(b != NULL)
+    {
+        CachedBlock *older = b->older;
+        free(b->data);
+        free(b);
+        b = older;
+    }
+    free(cache->buckets);
+    memset(cache, 0, sizeof(BlockCache));
+}
+
+static uint32_t hashBlock(const BlockCache *cache, uint32_t entry, uint64_t block)
+{
+    uint64_t h = (block ^ ((uint64_t)entry << 40)) * 0x9e3779b97f4a7c15ULL;
+    return (uint32_t)(h >> 32) & cache->mask;
+}
+
+static void unlinkBlock(BlockCache *cache, CachedBlock *b)
+{
+    if(b->newer != NULL)
+        b->newer->older = b->older;
+    else
+        cache->newest = b->older;
+    if(b->older != NULL)
+        b->older->newer = b->newer;
+    else
+        cache->oldest = b->newer;
+    b->newer = b->older = NULL;
+}
+
+static void pushBlock(BlockCache *cache, CachedBlock *b)
+{
+    b->older = cache->newest;
+    b->newer = NULL;
+    if(cache->newest != NULL)
+        cache->newest->newer = b;
+    else
+        cache->oldest = b;
+    cache->newest = b;
+}
+
+/*
+ * remove B from CACHE and free it
+ */
+static void dropBlock(BlockCache *cache, CachedBlock *b)
+{
+    CachedBlock **link = &cache->buckets[hashBlock(cache, b->entry, b->block)];
+    while(*link != b)
+        link = &(*link)->chain;
+    *link = b->chain;
+    unlinkBlock(cache, b);
+    cache->used -= b->length;
+    free(b->data);
+    free(b);
+}
+
+CachedBlock *findBlock(BlockCache *cache, uint32_t entry, uint64_t block)
+{
+    CachedBlock *b = cache->buckets[hashBlock(cache, entry, block)];
+    while(b != NULL && (b->entry != entry || b->block != block))
+        b = b->chain;
+    if(b == NULL)
+    {
+        cache->misses++;
+        return NULL;
+    }
+    cache->hits++;
+    if(b != cache->newest)
+    {
+        unlinkBlock(cache, b);
+        pushBlock(cache, b);
+    }
+    return b;
+}
+
+CachedBlock *addBlock(BlockCache *cache, uint32_t entry, uint64_t block, uint8_t *data, uint32_t length)
+{
+    CachedBlock *b = (CachedBlock*)malloc(sizeof(CachedBlock));
+    if(b == NULL)
+    {
+        free(data);
+        return NULL;
+    }
+    while(cache->oldest != NULL && cache->used + length > cache->budget)
+        dropBlock(cache, cache->oldest);
+
+    uint32_t bucket = hashBlock(cache, entry, block);
+    b->entry = entry;
+    b->block = block;
+    b->data = data;
+    b->length = length;
+    b->chain = cache->buckets[bucket];
+    cache->buckets[bucket] = b;
+    pushBlock(cache, b);
+    cache->used += length;
+    return b;
+}
+
+/*
+ * unpack block BLOCK of entry ENTRY of SIZE bytes with READER into CACHE
+ */
+static CachedBlock *loadBlock(BlockCache *cache, XsdmReader *reader, uint32_t entry, uint64_t size,
+                              uint64_t block, int *error)
+{
+    uint64_t start = block * cache->blockSize;
+    uint32_t length = size - start < cache->blockSize ? size - start : cache->blockSize;
+    uint8_t *data = (uint8_t*)malloc(length ? length : 1);
+    if(data == NULL)
+    {
+        *error = ENOMEM;
+        return NULL;
+    }
+    if(xsdmTell(reader) != start && (*error = xsdmSeek(reader, start)) != 0)
+    {
+        free(data);
+        return NULL;
+    }
+
+    uint32_t done = 0;
+    while(done < length)
+    {
+        ssize_t bytes = xsdmRead(reader, data + done, length - done);
+        if(bytes <= 0)
+        {
+            *error = bytes < 0 ? -bytes : EIO;
+            free(data);
+            return NULL;
+        }
+        done += bytes;
+    }
+
+    CachedBlock *b = addBlock(cache, entry, block, data, length);
+    if(b == NULL)
+        *error = ENOMEM;
+    return b;
+}
+
+ssize_t readRange(BlockCache *cache, XsdmReader *reader, uint32_t entry, uint64_t size,
+                  void *buffer, size_t length, uint64_t offset)
+{
+    if(offset >= size)
+        return 0;
+    if(length > size - offset)
+        length = size - offset;
+
+    size_t copied = 0;
+    while(copied < length)
+    {
+        uint64_t position = offset + copied;
+        uint64_t block = position / cache->blockSize;
+        int error = 0;
+        CachedBlock *b = findBlock(cache, entry, block);
+        if(b == NULL && (b = loadBlock(cache, reader, entry, size, block, &error)) == NULL)
+            return copied != 0 ? (ssize_t)copied : -error;
+
+        uint32_t start = position - block * cache->blockSize;
+        size_t bytes = b->length - start;
+        if(bytes > length - copied)
+            bytes = length - copied;
+        memcpy((uint8_t*)buffer + copied, b->data + start, bytes);
+        copied += bytes;
+    }
+    return copied;
+}
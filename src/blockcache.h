@@ -0,0 +1,71 @@
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "libxsdm.h"
+
+//default size of one cached block of unpacked entry
+#define BLOCK_SIZE 0x20000
+
+typedef struct cachedblock_t
+{
+  uint32_t      entry;
+  uint64_t      block;	//offset in entry divided by block size
+  uint8_t       *data;
+  uint32_t      length;	//block size, less only for last block of entry
+  struct cachedblock_t *chain;	//next block in the same bucket
+  struct cachedblock_t *newer;	//neighbours in LRU list
+  struct cachedblock_t *older;
+} CachedBlock;
+
+/*
+ * unpacked blocks of entries kept in memory up to budget, least recently used
+ * one is dropped first; not thread safe
+ */
+typedef struct blockcache_t
+{
+  CachedBlock   **buckets;
+  uint32_t      mask;	//number of buckets - 1, number of buckets is power of 2
+  CachedBlock   *newest;
+  CachedBlock   *oldest;
+  uint32_t      blockSize;
+  uint64_t      budget;	//bytes of data of all blocks
+  uint64_t      used;
+  uint64_t      hits;
+  uint64_t      misses;
+} BlockCache;
+
+/*
+ * initialize empty CACHE of blocks of BLOCKSIZE bytes holding at most BUDGET bytes
+ * (at least one block); returns 0 or errno
+ */
+int initBlockCache(BlockCache *cache, uint32_t blockSize, uint64_t budget);
+
+/*
+ * free CACHE with all its blocks
+ */
+void freeBlockCache(BlockCache *cache);
+
+/*
+ * return block BLOCK of entry ENTRY and mark it recently used or NULL if it is not
+ * cached
+ */
+CachedBlock *findBlock(BlockCache *cache, uint32_t entry, uint64_t block);
+
+/*
+ * store DATA (taken over, malloc'd) of LENGTH bytes as block BLOCK of entry ENTRY,
+ * dropping least recently used blocks to stay in budget; returns the new block
+ */
+CachedBlock *addBlock(BlockCache *cache, uint32_t entry, uint64_t block, uint8_t *data, uint32_t length);
+
+/*
+ * copy up to LENGTH bytes from OFFSET of entry ENTRY of SIZE bytes into BUFFER,
+ * blocks missing in CACHE are unpacked by READER (open on that entry) which
+ * seeks as needed; returns number of bytes copied or negative errno
+ */
+ssize_t readRange(BlockCache *cache, XsdmReader *reader, uint32_t entry, uint64_t size,
+                  void *buffer, size_t length, uint64_t offset);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef BLOWFISH_H
+#define BLOWFISH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BF_BLOCKSIZE 8
+
+/*
+ * expanded key, computing it is expensive (521 block encryptions),
+ * so it should be done once per key and then reused
+ */
+typedef struct blowfishkey_t
+{
+  uint32_t      p[18];
+  uint32_t      s[4][256];
+} BlowfishKey;
+
+/*
+ * expand KEY of KEYLENGTH bytes (at most 56) into BF
+ */
+void blowfishInit(BlowfishKey *bf, const void *key, uint32_t keyLength);
+
+/*
+ * decrypt SIZE bytes of BUFFER in place in ECB mode, words of each block are
+ * little endian as in mcrypt's "blowfish-compat", trailing partial block is left as is
+ */
+void blowfishDecrypt(const BlowfishKey *bf, void *buffer, size_t size);
+
+/*
+ * encrypt SIZE bytes of BUFFER in place, counterpart of blowfishDecrypt
+ */
+void blowfishEncrypt(const BlowfishKey *bf, void *buffer, size_t size);
+
+#endif
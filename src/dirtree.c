@@ -0,0 +1,244 @@
+#define _GNU_SOURCE
+#include "dirtree.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+//permissions of created directories
+#define DIR_MODE (S_IRWXU | S_IRWXG | S_IROTH | S_IWOTH | S_IXOTH)
+
+/*
+ * return FNV-1a hash of LENGTH bytes of PATH
+ */
+static uint32_t hashPath(const char *path, uint32_t length)
+{
+    uint32_t hash = 2166136261u;
+    uint32_t i;
+    for(i = 0; i < length; i++)
+        hash = (hash ^ (uint8_t)path[i]) * 16777619u;
+    return hash;
+}
+
+/*
+ * return PATH (of LENGTH bytes) of directory D relative to its nearest open directory,
+ * terminated in BUFFER of PATH_MAX bytes, NULL if it does not fit
+ */
+static const char *relativePath(DirTree *tree, int32_t d, const char *path, uint32_t length, char *buffer)
+{
+    int32_t opened = tree->dirs[d].opened;
+    uint32_t skip = opened >= 0 ? tree->dirs[opened].length : 0;
+
+    //components below open directory, without separators it ends with
+    while(skip < length && opened >= 0 && path[skip] == '/')
+        skip++;
+    if(length - skip >= PATH_MAX)
+        return NULL;
+    memcpy(buffer, path + skip, length - skip);
+    buffer[length - skip] = '\0';
+    return buffer;
+}
+
+/*
+ * create directory D of TREE whose parent is PARENT and keep it open while
+ * there is room for it
+ */
+static void makeDir(DirTree *tree, int32_t d, int32_t parent)
+{
+    TreeDir *dir = &tree->dirs[d];
+    const char *name = dir->path + tree->dirs[parent].length + 1;
+    uint32_t nameLength = dir->path + dir->length - name;
+
+    //"a//b" and "a/./b" name the same directory as "a/b"
+    dir->error = tree->dirs[parent].error;
+    if(dir->error != 0 || nameLength == 0 || (nameLength == 1 && name[0] == '.'))
+        return;
+
+    char buffer[PATH_MAX];
+    const char *path = relativePath(tree, d, dir->path, dir->length, buffer);
+    int at = dir->opened >= 0 ? tree->dirs[dir->opened].fd : AT_FDCWD;
+    if(path == NULL)
+    {
+        dir->error = ENAMETOOLONG;
+        return;
+    }
+
+    StatMark mark;
+    statBegin(STS_MKDIR, &mark);
+    uint64_t calls = 1;
+    if(mkdirat(at, path, DIR_MODE) != 0 && errno != EEXIST)
+        dir->error = errno;
+    else if(tree->fds < tree->fdLimit)
+    {
+        calls++;
+        int fd = openat(at, path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if(fd >= 0)
+        {
+            dir->fd = fd;
+            dir->opened = d;
+            tree->fds++;
+        }
+        else if(errno == ENOTDIR || errno == ENOENT)
+            dir->error = errno;
+    }
+    statEnd(STS_MKDIR, &mark, 0, 0, calls, NULL);
+}
+
+/*
+ * return index of directory at PATH (of LENGTH bytes, below root) in TREE, adding it
+ * and directories above it when they are not there yet; -1 when out of memory
+ */
+static int32_t findDir(DirTree *tree, const char *path, uint32_t length)
+{
+    uint32_t bucket = hashPath(path, length) & tree->mask;
+    int32_t d;
+    for(d = tree->buckets[bucket]; d >= 0; d = tree->dirs[d].next)
+    {
+        if(tree->dirs[d].length == length && memcmp(tree->dirs[d].path, path, length) == 0)
+            return d;
+    }
+
+    //root is always there, so parent of any other directory is found or added
+    const char *slash = (const char*)memrchr(path, '/', length);
+    int32_t parent = findDir(tree, path, slash - path);
+    if(parent < 0)
+        return -1;
+
+    if(tree->count == tree->capacity)
+    {
+        TreeDir *dirs = (TreeDir*)realloc(tree->dirs, sizeof(TreeDir) * tree->capacity * 2);
+        if(dirs == NULL)
+            return -1;
+        tree->dirs = dirs;
+        tree->capacity *= 2;
+    }
+    d = tree->count++;
+    TreeDir *dir = &tree->dirs[d];
+    dir->path = path;
+    dir->length = length;
+    dir->next = tree->buckets[bucket];
+    dir->opened = tree->dirs[parent].opened;
+    dir->fd = -1;
+    dir->error = 0;
+    tree->buckets[bucket] = d;
+    if(tree->create)
+        makeDir(tree, d, parent);
+    return d;
+}
+
+int buildDirTree(DirTree *tree, const char *root, SdcEntry *entries, uint32_t count, const char *suffix, int create)
+{
+    memset(tree, 0, sizeof(DirTree));
+    tree->create = create;
+    tree->fdLimit = DIRTREE_FDS;
+    struct rlimit limit;
+    if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur / 4 < tree->fdLimit)
+        tree->fdLimit = limit.rlim_cur / 4;
+
+    size_t rootLength = strlen(root);
+    size_t suffixLength = suffix != NULL ? strlen(suffix) : 0;
+    size_t size = rootLength + 1;
+    uint32_t i, buckets = 16;
+    for(i = 0; i < count; i++)
+        size += rootLength + 1 + strlen(entries[i].name) + suffixLength + 1;
+    while(buckets < count)
+        buckets *= 2;
+
+    tree->arena = (char*)malloc(size);
+    tree->capacity = 16;
+    tree->dirs = (TreeDir*)malloc(sizeof(TreeDir) * tree->capacity);
+    tree->buckets = (int32_t*)malloc(sizeof(int32_t) * buckets);
+    if(tree->arena == NULL || tree->dirs == NULL || tree->buckets == NULL)
+    {
+        freeDirTree(tree);
+        return ENOMEM;
+    }
+    memset(tree->buckets, 0xff, sizeof(int32_t) * buckets);
+    tree->mask = buckets - 1;
+
+    memcpy(tree->arena, root, rootLength + 1);
+    TreeDir *top = &tree->dirs[tree->count++];
+    top->path = tree->arena;
+    top->length = rootLength;
+    top->next = -1;
+    top->fd = create ? open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC) : -1;
+    top->opened = top->fd >= 0 ? 0 : -1;
+    top->error = 0;
+    tree->fds = top->fd >= 0;
+    tree->buckets[hashPath(root, rootLength) & tree->mask] = 0;
+
+    char *path = tree->arena + rootLength + 1;
+    int32_t last = 0;
+    for(i = 0; i < count; i++)
+    {
+        SdcEntry *entry = &entries[i];
+        size_t nameLength = strlen(entry->name);
+        memcpy(path, root, rootLength);
+        path[rootLength] = '/';
+        memcpy(path + rootLength + 1, entry->name, nameLength);
+        if(suffixLength != 0)
+            memcpy(path + rootLength + 1 + nameLength, suffix, suffixLength);
+        path[rootLength + 1 + nameLength + suffixLength] = '\0';
+
+        //entries of one directory usually come one after another
+        const char *slash = (const char*)memrchr(entry->name, '/', nameLength);
+        uint32_t length = slash != NULL ? rootLength + 1 + (slash - entry->name) : rootLength;
+        int32_t d = last;
+        if(tree->dirs[d].length != length || memcmp(tree->dirs[d].path, path, length) != 0)
+            d = findDir(tree, path, length);
+        if(d < 0)
+        {
+            freeDirTree(tree);
+            return ENOMEM;
+        }
+        last = d;
+
+        entry->outFile = path;
+        entry->dirFd = AT_FDCWD;
+        entry->outName = NULL;
+        int32_t opened = tree->dirs[d].opened;
+        if(opened >= 0)
+        {
+            const char *name = path + tree->dirs[opened].length;
+            while(*name == '/')
+                name++;
+            entry->dirFd = tree->dirs[opened].fd;
+            entry->outName = name;
+        }
+        path += rootLength + 1 + nameLength + suffixLength + 1;
+    }
+    return 0;
+}
+
+int finishOutput(const SdcEntry *entry, const char *suffix, int keep)
+{
+    const char *name = entryOutput(entry);
+    if(!keep)
+        return unlinkat(entry->dirFd, name, 0) == 0 ? 0 : errno;
+
+    char final[PATH_MAX];
+    size_t length = strlen(name) - strlen(suffix);
+    if(length >= sizeof(final))
+        return ENAMETOOLONG;
+    memcpy(final, name, length);
+    final[length] = '\0';
+    return renameat(entry->dirFd, name, entry->dirFd, final) == 0 ? 0 : errno;
+}
+
+void freeDirTree(DirTree *tree)
+{
+    uint32_t i;
+    for(i = 0; i < tree->count; i++)
+    {
+        if(tree->dirs[i].fd >= 0)
+            close(tree->dirs[i].fd);
+    }
+    free(tree->arena);
+    free(tree->dirs);
+    free(tree->buckets);
+    memset(tree, 0, sizeof(DirTree));
+}
@@ -0,0 +1,58 @@
+#ifndef DIRTREE_H
+#define DIRTREE_H
+
+#include <stdint.h>
+
+#include "extract.h"
+
+//most directories kept open, less if file descriptor limit is low
+#define DIRTREE_FDS 256
+
+typedef struct treedir_t
+{
+  const char    *path;	//prefix of output path in arena, not terminated
+  uint32_t      length;
+  int32_t       next;	//next directory in the same bucket, -1 ends chain
+  int32_t       opened;	//nearest directory (itself or above) kept open, -1 for none
+  int           fd;	//-1 when not kept open
+  int           error;	//errno of failed creation
+} TreeDir;
+
+/*
+ * output directories of container, each of them created once; dirs[0] is the
+ * directory outputs are unpacked into
+ */
+typedef struct dirtree_t
+{
+  char          *arena;	//output paths of all entries, one after another
+  TreeDir       *dirs;
+  uint32_t      count;
+  uint32_t      capacity;
+  int32_t       *buckets;	//first directory of every hash bucket
+  uint32_t      mask;	//number of buckets - 1, number of buckets is power of 2
+  uint32_t      fds;	//directories kept open
+  uint32_t      fdLimit;
+  int           create;	//directories are created, not only laid out
+} DirTree;
+
+/*
+ * lay out output paths of COUNT ENTRIES under ROOT (with SUFFIX appended, may be
+ * NULL) in one arena of TREE and point their outFile at them; with CREATE every
+ * directory they need is made once, up to DIRTREE_FDS of them are kept open and
+ * entries are given dirFd and outName relative to nearest one; directories that
+ * could not be made keep their errno; returns 0 or ENOMEM
+ */
+int buildDirTree(DirTree *tree, const char *root, SdcEntry *entries, uint32_t count, const char *suffix, int create);
+
+/*
+ * rename output of ENTRY to its outFile without SUFFIX if KEEP is set, remove it
+ * otherwise; returns 0 or errno
+ */
+int finishOutput(const SdcEntry *entry, const char *suffix, int keep);
+
+/*
+ * close directories of TREE and free it with all paths of its entries
+ */
+void freeDirTree(DirTree *tree);
+
+#endif
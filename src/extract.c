@@ -0,0 +1,948 @@
+#include "extract.h"
+#include "pipeline.h"
+
+#include <fnmatch.h>
+
+typedef struct pool_t
+{
+  Extractor     *ex;
+  SdcEntry      *entries;
+  uint32_t      count;
+  uint32_t      next;	//next entry to be handed out
+  int           failed;
+  int           stop;	//set after fatal failure, no more entries are handed out
+  void          (*report)(SdcEntry*);
+  pthread_mutex_t lock;
+} Pool;
+
+typedef struct segment_t
+{
+  const Checkpoint *start;	//point segment starts at, NULL for beginning of entry
+  off_t         input;	//compressed bytes of segment, up to next point
+  off_t         inputEnd;
+  uint64_t      output;	//bytes of entry it unpacks to
+  uint64_t      outputEnd;
+  uLong         crc;	//of its compressed bytes, when counted
+  ExtractStatus status;
+  int           error;
+  EntryStats    stats;
+} Segment;
+
+typedef struct segmentpool_t
+{
+  Extractor     *ex;
+  Output        *file;	//output of whole entry, segments write into it
+  Segment       *segments;
+  uint32_t      count;
+  uint32_t      next;	//next segment to be handed out
+  int           stop;	//set after first failure
+  pthread_mutex_t lock;
+} SegmentPool;
+
+void fillEntries(SdcEntry *entries, Header *hdr, uint32_t hdrSize, FileName *fn)
+{
+    off_t filestart = hdrSize + 4;
+    uint32_t i;
+    for(i = 0; i < hdr->headerSize; i++)
+    {
+        SdcEntry *entry = &entries[i];
+        memset(entry, 0, sizeof(SdcEntry));
+        entry->file = &hdr->files[i];
+        entry->index = i;
+        entry->status = EX_PENDING;
+        entry->dirFd = AT_FDCWD;
+        entry->offset = filestart;
+        if(hdr->headerSignature == SIG_ELARGE)
+        {
+            entry->compressedSize = entry->file->file4gb.compressedSize;
+            entry->fileSize = entry->file->file4gb.fileSize;
+            entry->name = (char*)(&fn->fileName) + entry->file->file4gb.fileNameOffset;
+        }
+        else
+        {
+            entry->compressedSize = entry->file->file.compressedSize;
+            entry->fileSize = entry->file->file.fileSize;
+            entry->name = (char*)(&fn->fileName) + entry->file->file.fileNameOffset;
+        }
+        dosPathToUnix(entry->name);
+        filestart += entry->compressedSize;
+    }
+}
+
+const char *entryOutput(const SdcEntry *entry)
+{
+    return entry->outName != NULL ? entry->outName : entry->outFile;
+}
+
+uint32_t selectEntries(SdcEntry *entries, uint32_t count, char **patterns, uint32_t patternCount, uint32_t *hits)
+{
+    uint32_t i, p, selected = 0;
+    if(hits != NULL)
+        memset(hits, 0, sizeof(uint32_t) * patternCount);
+    for(i = 0; i < count; i++)
+    {
+        int match = 0;
+        for(p = 0; p < patternCount; p++)
+        {
+            if(fnmatch(patterns[p], entries[i].name, 0) == 0)
+            {
+                match = 1;
+                if(hits != NULL)
+                    hits[p]++;
+            }
+        }
+        //entries stay sorted by offset, so stream input is still read in order
+        if(match)
+            entries[selected++] = entries[i];
+    }
+    return selected;
+}
+
+int initExtractState(ExtractState *st, uint32_t signature)
+{
+    st->input = (unsigned char*)malloc(0x4000);
+    st->output = allocOutputBuffer(OUTPUT_BUFFER);
+    st->packed = NULL;
+    st->unpacked = NULL;
+    st->packedSize = 0;
+    st->unpackedSize = 0;
+    st->checkpoint = NULL;
+    st->ring = NULL;
+    st->noRing = 0;
+    return initInflater(&st->inflater, signature);
+}
+
+void freeExtractState(ExtractState *st)
+{
+    freeInflater(&st->inflater);
+    free(st->input);
+    st->input = NULL;
+    free(st->output);
+    st->output = NULL;
+    free(st->packed);
+    st->packed = NULL;
+    free(st->unpacked);
+    st->unpacked = NULL;
+    free(st->checkpoint);
+    st->checkpoint = NULL;
+    if(st->ring != NULL)
+        freeRing(st->ring);
+    free(st->ring);
+    st->ring = NULL;
+}
+
+/*
+ * return io_uring of ST for reads of unmapped container IN and writes, NULL when
+ * blocking I/O is used
+ */
+static IoRing *entryRing(ExtractState *st, SdcInput *in)
+{
+    if(in->ioDepth == 0 || in->map != NULL || in->stream || st->noRing)
+        return NULL;
+    if(st->ring == NULL)
+    {
+        st->ring = (IoRing*)malloc(sizeof(IoRing));
+        if(st->ring == NULL || initRing(st->ring, in->ioDepth) != 0)
+        {
+            free(st->ring);
+            st->ring = NULL;
+            st->noRing = 1;
+        }
+    }
+    return st->ring;
+}
+
+/*
+ * unpack ENTRY of seekable container with one inflateWhole call and store result
+ * into STATUS; returns 0 without touching ENTRY if it has to go the streaming way
+ * (it does not fit, is damaged or ends early), so results stay the same as
+ * streaming ones
+ */
+static int extractWhole(Extractor *ex, ExtractState *st, SdcEntry *entry, ExtractStatus *status)
+{
+    SdcInput *in = ex->in;
+    size_t packedLength = entry->compressedSize;
+    if(in->stream || entry->fileSize == 0 || entry->fileSize > INFLATE_WHOLE_MAX
+        || packedLength > INFLATE_WHOLE_MAX || entry->offset + (off_t)packedLength > in->size)
+        return 0;
+
+    const uint8_t *packed;
+    if(in->map != NULL)
+        packed = in->map + entry->offset;
+    else
+    {
+        if(st->packedSize < packedLength)
+        {
+            free(st->packed);
+            st->packedSize = packedLength;
+            st->packed = (unsigned char*)malloc(st->packedSize);
+        }
+        if(st->packed == NULL)
+        {
+            st->packedSize = 0;
+            return 0;
+        }
+        if(readInput(in, entry->offset, st->packed, packedLength) != packedLength)
+            return 0;
+        packed = st->packed;
+    }
+
+    //small entries are decoded straight into write buffer
+    uint8_t *unpacked = st->output;
+    if(entry->fileSize > OUTPUT_BUFFER)
+    {
+        if(st->unpackedSize < entry->fileSize)
+        {
+            free(st->unpacked);
+            st->unpackedSize = entry->fileSize;
+            st->unpacked = allocOutputBuffer(st->unpackedSize);
+        }
+        if(st->unpacked == NULL)
+        {
+            st->unpackedSize = 0;
+            return 0;
+        }
+        unpacked = st->unpacked;
+    }
+
+    StatMark mark;
+    statBegin(STS_INFLATE, &mark);
+    int r = inflateWhole(&st->inflater, packed, packedLength, unpacked, entry->fileSize);
+    statEnd(STS_INFLATE, &mark, packedLength, r == Z_OK ? entry->fileSize : 0, 0, &entry->stats);
+    if(r != Z_OK)
+        return 0;
+
+    entry->crc = crc32(0L, Z_NULL, 0);
+    entry->crcLength = 0;
+    if(ex->countCrc)
+    {
+        statBegin(STS_CRC, &mark);
+        entry->crc = crcKernel(entry->crc, packed, packedLength);
+        entry->crcLength = packedLength;
+        statEnd(STS_CRC, &mark, packedLength, 0, 0, &entry->stats);
+    }
+
+    statBegin(STS_XOR, &mark);
+    xorBuffer(ex->xorVal, unpacked, entry->fileSize);
+    statEnd(STS_XOR, &mark, entry->fileSize, entry->fileSize, 0, &entry->stats);
+
+    Output out;
+    r = openOutputAt(&out, entry->dirFd, ex->discard ? NULL : entryOutput(entry), entry->fileSize, st->output, OUTPUT_BUFFER, ex->direct);
+    if(r != 0)
+    {
+        entry->error = r;
+        *status = entry->status = EX_OPEN;
+        return 1;
+    }
+    out.stats = &entry->stats;
+    out.progress = entry->progress;
+    if(unpacked == st->output)
+        r = commitOutput(&out, entry->fileSize);
+    else
+        r = writeOutput(&out, unpacked, entry->fileSize);
+    int closed = closeOutput(&out);
+    if(r == 0)
+        r = closed;
+    if(r != 0)
+    {
+        entry->error = r;
+        *status = entry->status = EX_WRITE;
+        return 1;
+    }
+    *status = entry->status = EX_OK;
+    return 1;
+}
+
+/*
+ * load checkpoint of ENTRY into st->checkpoint, returns 0 if there is none or it
+ * does not fit ENTRY
+ */
+static int findCheckpoint(Extractor *ex, ExtractState *st, SdcEntry *entry)
+{
+    if(st->checkpoint == NULL && (st->checkpoint = (Checkpoint*)malloc(sizeof(Checkpoint))) == NULL)
+        return 0;
+    Checkpoint *point = st->checkpoint;
+    if(!resumePoint(ex->resume, entry->index, point))
+        return 0;
+    return point->input > (uint64_t)entry->offset
+        && point->input <= entry->offset + entry->compressedSize
+        && point->output <= entry->fileSize;
+}
+
+/*
+ * make ST continue inflating ENTRY from st->checkpoint into OUT,
+ * returns Z_OK, zlib error code or errno of reopening output
+ */
+static int resumeEntry(Extractor *ex, ExtractState *st, SdcEntry *entry, Output *out)
+{
+    Checkpoint *point = st->checkpoint;
+
+    //block starts inside byte before checkpoint input
+    uint8_t previous = 0;
+    if(point->bits != 0 && readInput(ex->in, point->input - 1, &previous, 1) != 1)
+        return Z_ERRNO;
+    int r = inflateAtPoint(&st->inflater.stream, point->bits, previous, point->window, point->windowLength);
+    if(r != Z_OK)
+        return r;
+    return reopenOutput(out, entry->dirFd, entryOutput(entry), point->output, st->output, OUTPUT_BUFFER);
+}
+
+/*
+ * record position of STREAM, which stopped at block boundary of ENTRY after
+ * consuming compressed bytes up to INPUTPOS, as checkpoint once OUT is written;
+ * returns 0 or errno
+ */
+static int takeCheckpoint(Extractor *ex, ExtractState *st, SdcEntry *entry, Output *out, off_t inputPos)
+{
+    if(st->checkpoint == NULL && (st->checkpoint = (Checkpoint*)malloc(sizeof(Checkpoint))) == NULL)
+        return ENOMEM;
+    Checkpoint *point = st->checkpoint;
+    z_stream *stream = &st->inflater.stream;
+
+    //buffer holds XORed output, dictionary is what inflate produced
+    point->windowLength = RESUME_WINDOW;
+    memcpy(point->window, out->buffer + out->fill - RESUME_WINDOW, RESUME_WINDOW);
+    xorBuffer(ex->xorVal, point->window, RESUME_WINDOW);
+
+    //only this file has to be durable, workers sync their own outside state lock
+    int result = flushOutput(out);
+    if(result != 0)
+        return result;
+    if(out->fd != -1 && fdatasync(out->fd) != 0)
+        return errno;
+    point->entry = entry->index;
+    point->bits = stream->data_type & 7;
+    point->input = inputPos - stream->avail_in;
+    point->output = out->pos;
+    return resumeCheckpoint(ex->resume, point);
+}
+
+/*
+ * add position of STREAM, which stopped at block boundary of ENTRY after OUTPUT bytes
+ * and consuming compressed bytes up to INPUTPOS, to seek points; returns 0 or errno
+ */
+static int recordSeekPoint(Extractor *ex, ExtractState *st, SdcEntry *entry, off_t inputPos, uint64_t output)
+{
+    if(st->checkpoint == NULL && (st->checkpoint = (Checkpoint*)malloc(sizeof(Checkpoint))) == NULL)
+        return ENOMEM;
+    Checkpoint *point = st->checkpoint;
+    z_stream *stream = &st->inflater.stream;
+
+    //window is taken from inflate, output buffer may have been flushed just now
+    uInt windowLength = RESUME_WINDOW;
+    if(inflateGetDictionary(stream, point->window, &windowLength) != Z_OK)
+        return EINVAL;
+    point->entry = entry->index;
+    point->bits = stream->data_type & 7;
+    point->input = inputPos - stream->avail_in;
+    point->output = output;
+    point->windowLength = windowLength;
+    return addSeekPoint(ex->points, point);
+}
+
+/*
+ * unpack ENTRY on calling thread only
+ */
+static ExtractStatus extractSerial(Extractor *ex, ExtractState *st, SdcEntry *entry)
+{
+    ExtractStatus status;
+    int resumed = ex->resume != NULL && findCheckpoint(ex, st, entry);
+    int record = ex->points != NULL && !ex->points->loaded && entry->fileSize > ex->points->header.span;
+    if(!resumed && !record && extractWhole(ex, st, entry, &status))
+        return status;
+
+    //previous entry may have been resumed as raw deflate
+    z_stream *stream = &st->inflater.stream;
+    SdcInput *in = ex->in;
+    int r = inflateReset2(stream, st->inflater.signature == SIG_ELARGE ? MAX_WBITS : -MAX_WBITS);
+    if(r != Z_OK)
+    {
+        entry->error = r;
+        return entry->status = EX_INIT;
+    }
+    stream->next_in = Z_NULL;
+    stream->avail_in = 0;
+    entry->crc = crc32(0L, Z_NULL, 0);
+    entry->crcLength = 0;
+
+    Output out;
+    if(resumed)
+    {
+        r = resumeEntry(ex, st, entry, &out);
+        if(r < Z_OK)
+        {
+            entry->error = r;
+            return entry->status = EX_INIT;
+        }
+    }
+    else
+        r = openOutputAt(&out, entry->dirFd, ex->discard ? NULL : entryOutput(entry), entry->fileSize, st->output, OUTPUT_BUFFER, ex->direct);
+    if(r != 0)
+    {
+        entry->error = r;
+        return entry->status = EX_OPEN;
+    }
+    out.stats = &entry->stats;
+    out.progress = entry->progress;
+    IoRing *ring = entryRing(st, in);
+    if(ring != NULL)
+        ringOutput(&out, ring);
+
+    //read from file, but never past the end of this entry
+    off_t inputPos = resumed ? (off_t)st->checkpoint->input : entry->offset;
+    uint64_t compressedRemaining = entry->offset + entry->compressedSize - inputPos;
+    adviseInput(in, inputPos, compressedRemaining);
+    if(ring != NULL)
+        startRingRead(ring, fileno(in->file), inputPos, inputPos + compressedRemaining);
+    unsigned int bytesToRead = 0x4000;
+
+    unsigned int bytesRemaining = entry->fileSize - (resumed ? st->checkpoint->output : 0);
+    progressAdd(entry->progress, entry->fileSize - bytesRemaining);
+
+    //with checkpoints or seek points inflate stops at every block boundary, one of
+    //them is taken every interval (span) of output
+    int flush = ex->resume != NULL || record ? Z_BLOCK : Z_NO_FLUSH;
+    uint64_t lastPoint = entry->fileSize - bytesRemaining;
+    uint64_t lastSeek = lastPoint;
+    int result;
+    StatMark mark;
+
+    //verified entry goes on until stream end, it must not produce more
+    r = Z_OK;
+    while(bytesRemaining != 0 || (ex->discard && r != Z_STREAM_END))
+    {
+        Bytef *fresh = NULL;
+        if(in->map != NULL)
+        {
+            //inflate straight from mapped container, next chunk when previous is consumed
+            result = 0;
+            if(stream->avail_in == 0)
+            {
+                result = compressedRemaining < 0x40000000 ? compressedRemaining : 0x40000000;
+                stream->next_in = (Bytef*)in->map + inputPos;
+            }
+            fresh = stream->next_in;
+        }
+        else if(ring != NULL)
+        {
+            //queued blocks are inflated in place, next one when previous is consumed
+            result = 0;
+            if(stream->avail_in == 0)
+            {
+                const uint8_t *block = NULL;
+                uint64_t enters = ring->enters;
+                statBegin(STS_READ, &mark);
+                ssize_t bytes = nextRingRead(ring, &block);
+                result = bytes > 0 ? bytes : 0;
+                statEnd(STS_READ, &mark, result, result, ring->enters - enters, &entry->stats);
+                stream->next_in = (Bytef*)block;
+            }
+            fresh = stream->next_in;
+        }
+        else
+        {
+            //move unconsumed tail to the front and fill up the rest
+            if(stream->avail_in != 0)
+                memmove(st->input,stream->next_in,stream->avail_in);
+            stream->next_in = (Bytef*)st->input;
+            fresh = stream->next_in + stream->avail_in;
+            result = bytesToRead-stream->avail_in;
+            if(result > compressedRemaining)
+                result = compressedRemaining;
+            result = readInput(in, inputPos, fresh, result);
+        }
+        if(result == 0 && stream->avail_in == 0)	//stop only if stream iflated whole previous buffer
+            break;					//still have bytes remaining but entry end reached
+        compressedRemaining -= result;
+        inputPos += result;
+
+        //checksum the same bytes we are about to inflate
+        if(ex->countCrc)
+        {
+            statBegin(STS_CRC, &mark);
+            entry->crc = crcKernel(entry->crc, fresh, result);
+            entry->crcLength += result;
+            statEnd(STS_CRC, &mark, result, 0, 0, &entry->stats);
+        }
+
+        //decode straight into write buffer, it is written once full
+        size_t space;
+        Bytef *decoded = outputSpace(&out, &space);
+        stream->avail_in += result;
+        stream->next_out = decoded;
+        stream->avail_out = space;
+        stream->total_in = 0;
+        stream->total_out = 0;
+        statBegin(STS_INFLATE, &mark);
+        r = inflate(stream,flush);
+        statEnd(STS_INFLATE, &mark, stream->total_in, stream->total_out, 0, &entry->stats);
+        if(r < Z_OK)
+        {
+            closeOutput(&out);
+            entry->error = r;
+            return entry->status = EX_INFLATE;
+        }
+        if(ex->discard && stream->total_out > bytesRemaining)
+        {
+            closeOutput(&out);
+            entry->error = EFBIG;
+            return entry->status = EX_SIZE;
+        }
+
+        //XOR
+        statBegin(STS_XOR, &mark);
+        xorBuffer(ex->xorVal, decoded, stream->total_out);
+        statEnd(STS_XOR, &mark, stream->total_out, stream->total_out, 0, &entry->stats);
+
+        //write to file
+        if((result = commitOutput(&out, stream->total_out)) != 0)
+        {
+            closeOutput(&out);
+            entry->error = result;
+            return entry->status = EX_WRITE;
+        }
+        bytesRemaining -= stream->total_out;
+        if(r == Z_STREAM_END)
+            break;
+
+        if(ex->resume != NULL && (stream->data_type & 0xc0) == 0x80 && out.fill >= RESUME_WINDOW
+            && entry->fileSize - bytesRemaining - lastPoint >= ex->resume->interval)
+        {
+            if((result = takeCheckpoint(ex, st, entry, &out, inputPos)) != 0)
+            {
+                closeOutput(&out);
+                entry->error = result;
+                return entry->status = EX_WRITE;
+            }
+            lastPoint = entry->fileSize - bytesRemaining;
+        }
+
+        //missing seek point only makes later runs slower
+        if(record && (stream->data_type & 0xc0) == 0x80
+            && entry->fileSize - bytesRemaining - lastSeek >= ex->points->header.span)
+        {
+            recordSeekPoint(ex, st, entry, inputPos, entry->fileSize - bytesRemaining);
+            lastSeek = entry->fileSize - bytesRemaining;
+        }
+    }
+    if((result = closeOutput(&out)) != 0)
+    {
+        entry->error = result;
+        return entry->status = EX_WRITE;
+    }
+
+    if(bytesRemaining != 0 || (ex->discard && r != Z_STREAM_END))
+        return entry->status = EX_EOF;
+    return entry->status = EX_OK;
+}
+
+/*
+ * inflate SEG of entry into FILE with STREAM, reading into INPUT (of 0x40000 bytes,
+ * unused when container is mapped) and writing through OUTPUT of OUTPUT_BUFFER bytes
+ */
+static ExtractStatus inflateSegment(Extractor *ex, Output *file, Segment *seg, z_stream *stream,
+                                    uint8_t *input, uint8_t *output)
+{
+    SdcInput *in = ex->in;
+    const Checkpoint *point = seg->start;
+    int r;
+    if(point == NULL)
+        r = inflateReset2(stream, ex->signature == SIG_ELARGE ? MAX_WBITS : -MAX_WBITS);
+    else
+    {
+        uint8_t previous = 0;
+        if(point->bits != 0 && readInput(in, point->input - 1, &previous, 1) != 1)
+            r = Z_ERRNO;
+        else
+            r = inflateAtPoint(stream, point->bits, previous, point->window, point->windowLength);
+    }
+    if(r != Z_OK)
+    {
+        seg->error = r;
+        return seg->status = EX_INIT;
+    }
+
+    Output out;
+    shareOutput(&out, file, seg->output, output, OUTPUT_BUFFER);
+    out.stats = &seg->stats;
+    out.progress = file->progress;
+    seg->crc = crc32(0L, Z_NULL, 0);
+    stream->avail_in = 0;
+
+    //segment never reads past next point, byte shared with it is read by both
+    off_t inputPos = seg->input;
+    uint64_t remaining = seg->outputEnd - seg->output;
+    StatMark mark;
+    r = Z_OK;
+    while(remaining != 0 && r != Z_STREAM_END)
+    {
+        if(stream->avail_in == 0)
+        {
+            size_t chunk = seg->inputEnd - inputPos < 0x40000 ? seg->inputEnd - inputPos : 0x40000;
+            if(in->map != NULL)
+                stream->next_in = (Bytef*)in->map + inputPos;
+            else
+            {
+                chunk = readInput(in, inputPos, input, chunk);
+                stream->next_in = input;
+            }
+            if(chunk == 0)
+                break;
+            if(ex->countCrc)
+            {
+                statBegin(STS_CRC, &mark);
+                seg->crc = crcKernel(seg->crc, stream->next_in, chunk);
+                statEnd(STS_CRC, &mark, chunk, 0, 0, &seg->stats);
+            }
+            stream->avail_in = chunk;
+            inputPos += chunk;
+        }
+
+        size_t space;
+        Bytef *decoded = outputSpace(&out, &space);
+        stream->next_out = decoded;
+        stream->avail_out = space < remaining ? space : remaining;
+        stream->total_in = 0;
+        stream->total_out = 0;
+        statBegin(STS_INFLATE, &mark);
+        r = inflate(stream, Z_NO_FLUSH);
+        statEnd(STS_INFLATE, &mark, stream->total_in, stream->total_out, 0, &seg->stats);
+        if(r < Z_OK && r != Z_BUF_ERROR)
+        {
+            flushOutput(&out);
+            seg->error = r;
+            return seg->status = EX_INFLATE;
+        }
+
+        statBegin(STS_XOR, &mark);
+        xorBuffer(ex->xorVal, decoded, stream->total_out);
+        statEnd(STS_XOR, &mark, stream->total_out, stream->total_out, 0, &seg->stats);
+        int result = commitOutput(&out, stream->total_out);
+        if(result != 0)
+        {
+            seg->error = result;
+            return seg->status = EX_WRITE;
+        }
+        remaining -= stream->total_out;
+        if(stream->total_out == 0 && stream->avail_in != 0)
+            break;
+    }
+    if((r = flushOutput(&out)) != 0)
+    {
+        seg->error = r;
+        return seg->status = EX_WRITE;
+    }
+    if(remaining != 0)
+        return seg->status = EX_EOF;
+
+    //rest of compressed bytes (end of block, zlib trailer) belongs to segment too
+    while(ex->countCrc && inputPos < seg->inputEnd)
+    {
+        size_t chunk = seg->inputEnd - inputPos < 0x40000 ? seg->inputEnd - inputPos : 0x40000;
+        const uint8_t *data = in->map != NULL ? in->map + inputPos : input;
+        if(in->map == NULL && (chunk = readInput(in, inputPos, input, chunk)) == 0)
+            return seg->status = EX_EOF;
+        seg->crc = crcKernel(seg->crc, data, chunk);
+        inputPos += chunk;
+    }
+    return seg->status = EX_OK;
+}
+
+static void *segmentWorker(void *arg)
+{
+    SegmentPool *pool = (SegmentPool*)arg;
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    int r = inflateInit2(&stream, -MAX_WBITS);
+    uint8_t *input = pool->ex->in->map == NULL ? (uint8_t*)malloc(0x40000) : NULL;
+    uint8_t *output = allocOutputBuffer(OUTPUT_BUFFER);
+
+    while(1)
+    {
+        pthread_mutex_lock(&pool->lock);
+        if(pool->stop || pool->next >= pool->count)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        Segment *seg = &pool->segments[pool->next++];
+        pthread_mutex_unlock(&pool->lock);
+
+        if(r != Z_OK || output == NULL || (pool->ex->in->map == NULL && input == NULL))
+        {
+            seg->error = r != Z_OK ? r : Z_MEM_ERROR;
+            seg->status = EX_INIT;
+        }
+        else
+            inflateSegment(pool->ex, pool->file, seg, &stream, input, output);
+        if(seg->status != EX_OK)
+        {
+            pthread_mutex_lock(&pool->lock);
+            pool->stop = 1;
+            pthread_mutex_unlock(&pool->lock);
+        }
+    }
+
+    if(r == Z_OK)
+        inflateEnd(&stream);
+    free(input);
+    free(output);
+    return NULL;
+}
+
+/*
+ * return number of seek points of ENTRY usable for splitting it and store first of them
+ * into FIRST, 0 if it has none or any of them does not fit ENTRY
+ */
+static uint32_t entrySegments(Extractor *ex, SdcEntry *entry, const Checkpoint **first)
+{
+    uint32_t count = entrySeekPoints(ex->points, entry->index, first);
+    uint32_t i;
+    for(i = 0; i < count; i++)
+    {
+        const Checkpoint *point = *first + i;
+        if(point->input <= (uint64_t)entry->offset || point->input > entry->offset + entry->compressedSize
+            || point->output == 0 || point->output >= entry->fileSize
+            || (i != 0 && point->input <= point[-1].input))
+            return 0;
+    }
+    return count;
+}
+
+/*
+ * unpack ENTRY split at its COUNT seek points starting at POINTS on ex->segments threads,
+ * each segment is written at its offset; crc of entry is combined from those of segments
+ */
+static ExtractStatus extractSegments(Extractor *ex, SdcEntry *entry, const Checkpoint *points, uint32_t count)
+{
+    Output file;
+    int result = openOutputAt(&file, entry->dirFd, entryOutput(entry), entry->fileSize, NULL, 0, 0);
+    if(result != 0)
+    {
+        entry->error = result;
+        return entry->status = EX_OPEN;
+    }
+    file.progress = entry->progress;
+
+    SegmentPool pool;
+    pool.ex = ex;
+    pool.file = &file;
+    pool.count = count + 1;
+    pool.next = 0;
+    pool.stop = 0;
+    pool.segments = (Segment*)calloc(pool.count, sizeof(Segment));
+    if(pool.segments == NULL)
+    {
+        closeOutput(&file);
+        entry->error = Z_MEM_ERROR;
+        return entry->status = EX_INIT;
+    }
+    pthread_mutex_init(&pool.lock, NULL);
+    uint32_t i;
+    for(i = 0; i < pool.count; i++)
+    {
+        Segment *seg = &pool.segments[i];
+        seg->start = i ? &points[i - 1] : NULL;
+        seg->input = i ? (off_t)points[i - 1].input : entry->offset;
+        seg->output = i ? points[i - 1].output : 0;
+        seg->inputEnd = i < count ? (off_t)points[i].input : entry->offset + (off_t)entry->compressedSize;
+        seg->outputEnd = i < count ? points[i].output : entry->fileSize;
+    }
+
+    int jobs = ex->segments < pool.count ? ex->segments : pool.count;
+    pthread_t *threads = (pthread_t*)malloc(sizeof(pthread_t) * jobs);
+    int started = 0;
+    for(i = 0; i < jobs && threads != NULL; i++)
+    {
+        if(pthread_create(&threads[started], NULL, segmentWorker, &pool) == 0)
+            started++;
+    }
+    if(started == 0)
+        segmentWorker(&pool);
+    for(i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_mutex_destroy(&pool.lock);
+
+    //first failed segment decides, its file is incomplete
+    entry->status = EX_OK;
+    entry->crc = crc32(0L, Z_NULL, 0);
+    entry->crcLength = entry->compressedSize;
+    for(i = 0; i < pool.count; i++)
+    {
+        Segment *seg = &pool.segments[i];
+        int stage;
+        for(stage = 0; stage < STS_COUNT; stage++)
+            entry->stats.stageNs[stage] += seg->stats.stageNs[stage];
+        if(entry->status == EX_OK && seg->status != EX_OK)
+        {
+            entry->status = seg->status;
+            entry->error = seg->error;
+        }
+        entry->crc = crc32_combine(entry->crc, seg->crc, seg->inputEnd - seg->input);
+    }
+    free(pool.segments);
+
+    //preallocated file is complete, it must not be cut
+    if(entry->status == EX_OK)
+        file.pos = entry->fileSize;
+    if((result = closeOutput(&file)) != 0 && entry->status == EX_OK)
+    {
+        entry->error = result;
+        entry->status = EX_WRITE;
+    }
+    return entry->status;
+}
+
+/*
+ * return non-zero if ENTRY was unpacked by earlier run and its file is still there
+ */
+static int entryDone(Extractor *ex, SdcEntry *entry)
+{
+    struct stat st;
+    return resumeDone(ex->resume, entry->index) && fstatat(entry->dirFd, entryOutput(entry), &st, 0) == 0
+        && S_ISREG(st.st_mode) && st.st_size == entry->fileSize;
+}
+
+/*
+ * make file of unpacked ENTRY durable before state claims it done, returns 0 or errno
+ */
+static int syncEntry(Extractor *ex, SdcEntry *entry)
+{
+    if(ex->discard)
+        return 0;
+    int fd = openat(entry->dirFd, entryOutput(entry), O_RDONLY);
+    if(fd < 0)
+        return errno;
+    int error = fdatasync(fd) != 0 ? errno : 0;
+    close(fd);
+    return error;
+}
+
+ExtractStatus extractEntry(Extractor *ex, ExtractState *st, SdcEntry *entry)
+{
+    StatMark mark;
+    statBegin(STS_COUNT, &mark);
+    ExtractStatus status;
+    const Checkpoint *points;
+    uint32_t pointCount = 0;
+    if(ex->resume != NULL && entryDone(ex, entry))
+    {
+        progressAdd(NULL, entry->fileSize);
+        return entry->status = EX_OK;
+    }
+    entry->progress = progressEntry(entry->name, entry->fileSize);
+    if(ex->resume == NULL && ex->points != NULL && ex->points->loaded && ex->segments > 1 && !ex->discard)
+        pointCount = entrySegments(ex, entry, &points);
+    if(pointCount != 0)
+        status = extractSegments(ex, entry, points, pointCount);
+    else if(ex->resume == NULL && (ex->points == NULL || ex->points->loaded) && ex->queueDepth > 0
+            && entry->compressedSize > (ex->chunkSize ? ex->chunkSize : PIPELINE_CHUNK))
+        status = extractEntryPipelined(ex, st, entry);
+    else
+        status = extractSerial(ex, st, entry);
+    if(ex->resume != NULL && status == EX_OK && syncEntry(ex, entry) == 0)
+        resumeFinish(ex->resume, entry->index, entry->fileSize);
+    progressEntryDone(entry->progress);
+    entry->progress = NULL;
+
+    //assigned, so that fallback from pipeline is not counted twice
+    if(statsEnabled)
+    {
+        StatMark now;
+        statNow(STS_COUNT, &now);
+        entry->stats.wallNs = now.wall - mark.wall;
+    }
+    return status;
+}
+
+static void *extractWorker(void *arg)
+{
+    Pool *pool = (Pool*)arg;
+    ExtractState st;
+    int r = initExtractState(&st, pool->ex->signature);
+
+    while(1)
+    {
+        pthread_mutex_lock(&pool->lock);
+        if(pool->stop || pool->next >= pool->count)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        SdcEntry *entry = &pool->entries[pool->next++];
+        pthread_mutex_unlock(&pool->lock);
+
+        if(r != Z_OK)
+        {
+            entry->error = r;
+            entry->status = EX_INIT;
+        }
+        else
+            extractEntry(pool->ex, &st, entry);
+
+        //report under lock so that lines of different workers do not mix
+        pthread_mutex_lock(&pool->lock);
+        if(entry->status != EX_OK)
+        {
+            pool->failed++;
+            if(entry->status != EX_EOF)
+                pool->stop = 1;
+        }
+        if(pool->report)
+            pool->report(entry);
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    freeExtractState(&st);
+    return NULL;
+}
+
+int extractParallel(Extractor *ex, SdcEntry *entries, uint32_t count, int jobs, void (*report)(SdcEntry*))
+{
+    Pool pool;
+    pool.ex = ex;
+    pool.entries = entries;
+    pool.count = count;
+    pool.next = 0;
+    pool.failed = 0;
+    pool.stop = 0;
+    pool.report = report;
+    pthread_mutex_init(&pool.lock, NULL);
+
+    if(jobs > count)
+        jobs = count;
+    if(jobs < 1)
+        jobs = 1;
+    pthread_t *threads = (pthread_t*)malloc(sizeof(pthread_t) * jobs);
+    int i, started = 0;
+    for(i = 0; i < jobs; i++)
+    {
+        if(pthread_create(&threads[started], NULL, extractWorker, &pool) == 0)
+            started++;
+    }
+
+    //could not start any thread, do the work here
+    if(started == 0)
+        extractWorker(&pool);
+    for(i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
+    pthread_mutex_destroy(&pool.lock);
+    return pool.failed;
+}
+
+uLong combineEntryCrc(SdcInput *in, SdcEntry *entries, uint32_t count, off_t start)
+{
+    uLong crc = crc32(0L, Z_NULL, 0);
+    uint32_t i;
+    for(i = 0; i < count; i++)
+    {
+        if(start < entries[i].offset)
+            crc = updateCrc(in, start, entries[i].offset, crc);
+        crc = crc32_combine(crc, entries[i].crc, entries[i].crcLength);
+        start = entries[i].offset + entries[i].crcLength;
+    }
+    return updateCrc(in, start, in->size, crc);
+}
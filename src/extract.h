@@ -0,0 +1,129 @@
+#ifndef EXTRACT_H
+#define EXTRACT_H
+
+#include "xsdc.h"
+#include "output.h"
+#include "inflater.h"
+#include "resume.h"
+#include "seekindex.h"
+
+#include <pthread.h>
+#include <fcntl.h>
+
+typedef enum
+{
+  EX_OK = 0,
+  EX_OPEN,	//output file could not be opened
+  EX_INIT,	//inflateInit failed
+  EX_INFLATE,	//inflate failed
+  EX_EOF,	//entry ended before whole file was unpacked
+  EX_WRITE,	//writing output file failed
+  EX_SIZE,	//entry inflates to more than its size
+  EX_PENDING	//not started, unpacking stopped at earlier failure
+} ExtractStatus;
+
+typedef struct sdcentry_t
+{
+  FileUnion     *file;	//entry in decrypted header
+  uint32_t      index;	//position in header, kept when entries are selected
+  char          *name;	//path inside container (unix style)
+  char          *outFile;	//file entry is unpacked to
+  int           dirFd;	//directory outName is relative to, AT_FDCWD by default
+  const char    *outName;	//outFile relative to dirFd, NULL for outFile itself
+  off_t         offset;	//start of compressed data in container
+  uint64_t      compressedSize;
+  uint32_t      fileSize;
+  uLong         crc;	//crc32 of compressed bytes read while unpacking
+  off_t         crcLength;	//number of bytes covered by CRC
+  ExtractStatus status;
+  int           error;	//errno or zlib error code of failed entry
+  EntryStats    stats;	//filled only when statsEnabled
+  ProgressSlot  *progress;	//slot while being unpacked with progress shown, else NULL
+} SdcEntry;
+
+typedef struct extractor_t
+{
+  SdcInput      *in;
+  uint32_t      signature;	//headerSignature, selects zlib or raw deflate
+  uint8_t       xorVal;
+  int           countCrc;	//checksum compressed bytes while unpacking
+  uint32_t      queueDepth;	//chunks between pipeline stages, 0 disables pipeline
+  size_t        chunkSize;	//size of pipeline chunk
+  int           direct;	//write output files with O_DIRECT
+  int           discard;	//only verify entries: nothing is written and every one
+				//has to end exactly at its size
+  ResumeState   *resume;	//skip entries done by earlier run, continue from and take
+				//checkpoints; NULL disables
+  SeekIndex     *points;	//seek points of entries, recorded while unpacking unless
+				//loaded; NULL disables
+  int           segments;	//threads unpacking one entry between loaded seek points
+} Extractor;
+
+typedef struct extractstate_t
+{
+  Inflater      inflater;
+  unsigned char *input;	//compressed chunk, used only when container is not mapped
+  unsigned char *output;	//write buffer of OUTPUT_BUFFER bytes, inflated into directly
+  unsigned char *packed;	//whole compressed entry, when container is not mapped
+  unsigned char *unpacked;	//whole entry larger than output
+  size_t        packedSize;	//allocated sizes, grown up to INFLATE_WHOLE_MAX
+  size_t        unpackedSize;
+  Checkpoint    *checkpoint;	//allocated with first one taken or used
+  IoRing        *ring;	//queued reads and writes, set up with first entry needing it
+  int           noRing;	//setting it up failed, blocking I/O is used
+} ExtractState;
+
+/*
+ * fill COUNT entries of ENTRIES from decrypted HDR whose names were decoded into FN,
+ * offsets are computed from data area starting after header of HDRSIZE bytes;
+ * entries are EX_PENDING until they are unpacked
+ */
+void fillEntries(SdcEntry *entries, Header *hdr, uint32_t hdrSize, FileName *fn);
+
+/*
+ * move entries of ENTRIES (COUNT of them) whose name matches any of PATTERNCOUNT
+ * shell PATTERNS to the front, keeping their order, and return their number;
+ * wildcards match '/' too; HITS (may be NULL) receives number of entries
+ * matched by every pattern
+ */
+uint32_t selectEntries(SdcEntry *entries, uint32_t count, char **patterns, uint32_t patternCount, uint32_t *hits);
+
+/*
+ * return name output of ENTRY is opened with relative to its dirFd
+ */
+const char *entryOutput(const SdcEntry *entry);
+
+/*
+ * allocate buffers and initialize inflate stream of ST for container with SIGNATURE,
+ * returns Z_OK or zlib error code
+ */
+int initExtractState(ExtractState *st, uint32_t signature);
+
+/*
+ * free everything allocated by initExtractState
+ */
+void freeExtractState(ExtractState *st);
+
+/*
+ * inflate ENTRY into its outFile using buffers of ST, result is also stored in ENTRY;
+ * entries larger than one chunk go through extractEntryPipelined if ex->queueDepth is set,
+ * entries up to INFLATE_WHOLE_MAX of seekable container are inflated in one call;
+ * with ex->resume they are all unpacked serially, so that checkpoints can be taken;
+ * entries with loaded seek points are split at them and unpacked on ex->segments threads
+ */
+ExtractStatus extractEntry(Extractor *ex, ExtractState *st, SdcEntry *entry);
+
+/*
+ * extract COUNT ENTRIES on JOBS threads, REPORT is called (serialized) after every entry;
+ * stops handing out entries after first failure other than EX_EOF,
+ * returns number of entries that failed
+ */
+int extractParallel(Extractor *ex, SdcEntry *entries, uint32_t count, int jobs, void (*report)(SdcEntry*));
+
+/*
+ * count crc of data area of IN starting at START from CRCs of COUNT unpacked ENTRIES,
+ * bytes not covered by them (gaps and trailing data) are read from IN
+ */
+uLong combineEntryCrc(SdcInput *in, SdcEntry *entries, uint32_t count, off_t start);
+
+#endif
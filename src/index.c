@@ -0,0 +1,157 @@
+#include "index.h"
+
+/*
+ * fnv-1a of LENGTH bytes of DATA continuing from HASH
+ */
+static uint64_t hashBytes(uint64_t hash, const void *data, size_t length)
+{
+    const uint8_t *p = (const uint8_t*)data;
+    size_t i;
+    for(i = 0; i < length; i++)
+    {
+        hash ^= p[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+uint64_t hashKey(const UnpackData *ud)
+{
+    //only a hash is kept, index must not reveal the key
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    hash = hashBytes(hash, &ud->checksum, sizeof(ud->checksum));
+    hash = hashBytes(hash, &ud->xorVal, sizeof(ud->xorVal));
+    hash = hashBytes(hash, ud->fileNameKey, 32);
+    hash = hashBytes(hash, ud->headerKey, 32);
+    return hash;
+}
+
+int indexKey(IndexKey *key, int fd, const UnpackData *ud)
+{
+    struct stat st;
+    if(fstat(fd, &st) != 0)
+        return errno;
+    if(!S_ISREG(st.st_mode))
+        return EINVAL;
+
+    memset(key, 0, sizeof(IndexKey));
+    key->device = st.st_dev;
+    key->inode = st.st_ino;
+    key->size = st.st_size;
+    key->mtimeSec = st.st_mtim.tv_sec;
+    key->mtimeNsec = st.st_mtim.tv_nsec;
+    key->keyHash = hashKey(ud);
+    return 0;
+}
+
+char *indexPath(const char *sdcFile, const char *dir, const IndexKey *key)
+{
+    char *path;
+    if(dir == NULL)
+    {
+        path = (char*)malloc(strlen(sdcFile) + sizeof(INDEX_SUFFIX));
+        sprintf(path, "%s%s", sdcFile, INDEX_SUFFIX);
+    }
+    else
+    {
+        //containers of cache directory are told apart by their identity
+        path = (char*)malloc(strlen(dir) + 2 + 2 * 16 + 1 + sizeof(INDEX_SUFFIX));
+        sprintf(path, "%s/%016llx-%016llx%s", dir, (unsigned long long)key->device,
+                (unsigned long long)key->inode, INDEX_SUFFIX);
+    }
+    return path;
+}
+
+Header *loadIndex(const char *path, const IndexKey *key, uint32_t *hdrSize, int *crcKnown, uLong *crc)
+{
+    FILE *f = fopen(path, "r");
+    if(f == NULL)
+        return NULL;
+
+    IndexHeader ih;
+    Header *hdr = NULL;
+    if(fread(&ih, sizeof(ih), 1, f) != 1
+        || memcmp(ih.magic, INDEX_MAGIC, sizeof(ih.magic)) != 0
+        || memcmp(&ih.key, key, sizeof(IndexKey)) != 0
+        || ih.headerSize < sizeof(Header))
+    {
+        //container or key changed since index was made
+        fclose(f);
+        return NULL;
+    }
+
+    //trailing check catches index cut short or damaged
+    uint32_t check;
+    hdr = (Header*)calloc(1, getDataOutputSize(ih.headerSize));
+    if(hdr == NULL
+        || fread(hdr, ih.headerSize, 1, f) != 1
+        || fread(&check, sizeof(check), 1, f) != 1
+        || fgetc(f) != EOF)
+    {
+        free(hdr);
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+
+    uLong sum = crc32(0L, (Bytef*)&ih, sizeof(ih));
+    sum = crc32(sum, (Bytef*)hdr, ih.headerSize);
+    if(sum != check)
+    {
+        free(hdr);
+        return NULL;
+    }
+
+    *hdrSize = ih.headerSize;
+    *crcKnown = ih.crcKnown != 0;
+    *crc = ih.crc;
+    return hdr;
+}
+
+int saveIndex(const char *path, const IndexKey *key, const Header *hdr, uint32_t hdrSize, int crcKnown, uLong crc)
+{
+    IndexHeader ih;
+    memset(&ih, 0, sizeof(ih));
+    memcpy(ih.magic, INDEX_MAGIC, sizeof(ih.magic));
+    ih.key = *key;
+    ih.headerSize = hdrSize;
+    ih.crcKnown = crcKnown != 0;
+    ih.crc = crcKnown ? crc : 0;
+    uint32_t check = crc32(crc32(0L, (Bytef*)&ih, sizeof(ih)), (Bytef*)hdr, hdrSize);
+
+    //written under temporary name in the same directory and renamed over old one,
+    //so readers see either whole old index or whole new one
+    char *tmpPath = (char*)malloc(strlen(path) + 8);
+    sprintf(tmpPath, "%s.XXXXXX", path);
+    int fd = mkstemp(tmpPath);
+    if(fd < 0)
+    {
+        int error = errno;
+        free(tmpPath);
+        return error;
+    }
+
+    int error = 0;
+    FILE *f = fdopen(fd, "w");
+    if(f == NULL)
+    {
+        error = errno;
+        close(fd);
+    }
+    else
+    {
+        if(fwrite(&ih, sizeof(ih), 1, f) != 1
+            || fwrite(hdr, hdrSize, 1, f) != 1
+            || fwrite(&check, sizeof(check), 1, f) != 1
+            || fflush(f) != 0)
+            error = errno ? errno : EIO;
+        if(fclose(f) != 0 && error == 0)
+            error = errno;
+    }
+    if(error == 0 && rename(tmpPath, path) != 0)
+        error = errno;
+    if(error != 0)
+        unlink(tmpPath);
+    free(tmpPath);
+    return error;
+}
@@ -0,0 +1,62 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+#include "xsdc.h"
+
+//name of index stored next to container, appended to its path
+#define INDEX_SUFFIX ".xsdm-index"
+
+#define INDEX_MAGIC "XSDMIDX1"
+
+typedef struct __attribute__ ((__packed__))
+{
+  uint64_t      device;	//identity of container file
+  uint64_t      inode;
+  uint64_t      size;
+  int64_t       mtimeSec;
+  int64_t       mtimeNsec;
+  uint64_t      keyHash;	//hash of decoded key, index of other key is stale
+} IndexKey;
+
+typedef struct __attribute__ ((__packed__))
+{
+  char          magic[8];	//INDEX_MAGIC
+  IndexKey      key;
+  uint32_t      headerSize;	//size of header following this struct
+  uint32_t      crcKnown;	//crc of data area was counted
+  uint32_t      crc;
+} IndexHeader;
+//   uint8_t       header[headerSize];	decrypted header with decoded file names
+//   uint32_t      check;	crc32 of everything above
+
+/*
+ * return hash of key in UD, stored instead of the key itself
+ */
+uint64_t hashKey(const UnpackData *ud);
+
+/*
+ * fill KEY with identity of container opened as FD and hash of key in UD,
+ * returns 0 or errno
+ */
+int indexKey(IndexKey *key, int fd, const UnpackData *ud);
+
+/*
+ * return path of index of container at SDCFILE with KEY, kept in DIR or next
+ * to container if DIR is NULL; free() it when done
+ */
+char *indexPath(const char *sdcFile, const char *dir, const IndexKey *key);
+
+/*
+ * load index at PATH if it was made for KEY, returns decrypted header with decoded
+ * names (free() it when done) and fills HDRSIZE, CRCKNOWN and CRC; NULL if there
+ * is no index or it is stale or damaged
+ */
+Header *loadIndex(const char *path, const IndexKey *key, uint32_t *hdrSize, int *crcKnown, uLong *crc);
+
+/*
+ * atomically replace index at PATH with HDR of HDRSIZE bytes (names already
+ * decoded) for KEY, CRC is stored only if CRCKNOWN; returns 0 or errno
+ */
+int saveIndex(const char *path, const IndexKey *key, const Header *hdr, uint32_t hdrSize, int crcKnown, uLong crc);
+
+#endif
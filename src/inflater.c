@@ -0,0 +1,118 @@
+#include "inflater.h"
+#include "xsdc.h"
+
+#ifdef HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#endif
+
+static int zlibWhole(Inflater *inf, const uint8_t *in, size_t inLength, uint8_t *out, size_t outLength)
+{
+    z_stream *stream = &inf->stream;
+    int r = inflateReset(stream);
+    if(r != Z_OK)
+        return r;
+    stream->next_in = (Bytef*)in;
+    stream->avail_in = inLength;
+    stream->next_out = out;
+    stream->avail_out = outLength;
+    r = inflate(stream, Z_FINISH);
+    if(r == Z_STREAM_END)
+        return stream->total_out == outLength ? Z_OK : Z_BUF_ERROR;
+    return r == Z_OK ? Z_BUF_ERROR : r;
+}
+
+#ifdef HAVE_LIBDEFLATE
+static void *libdeflateAlloc()
+{
+    return libdeflate_alloc_decompressor();
+}
+
+static void libdeflateRelease(void *state)
+{
+    libdeflate_free_decompressor((struct libdeflate_decompressor*)state);
+}
+
+static int libdeflateWhole(Inflater *inf, const uint8_t *in, size_t inLength, uint8_t *out, size_t outLength)
+{
+    struct libdeflate_decompressor *d = (struct libdeflate_decompressor*)inf->state;
+    size_t consumed, produced;
+    enum libdeflate_result r;
+    if(inf->signature == SIG_ELARGE)
+        r = libdeflate_zlib_decompress_ex(d, in, inLength, out, outLength, &consumed, &produced);
+    else
+        r = libdeflate_deflate_decompress_ex(d, in, inLength, out, outLength, &consumed, &produced);
+    if(r == LIBDEFLATE_SUCCESS)
+        return produced == outLength ? Z_OK : Z_BUF_ERROR;
+    return r == LIBDEFLATE_BAD_DATA ? Z_DATA_ERROR : Z_BUF_ERROR;
+}
+#endif
+
+//fastest first
+static const InflateBackend backends[] =
+{
+#ifdef HAVE_LIBDEFLATE
+  {"libdeflate", libdeflateAlloc, libdeflateRelease, libdeflateWhole},
+#endif
+  {"zlib", NULL, NULL, zlibWhole}
+};
+
+static const InflateBackend *selected = &backends[0];
+
+int selectInflateBackend(const char *name)
+{
+    size_t i;
+    for(i = 0; i < sizeof(backends) / sizeof(backends[0]); i++)
+    {
+        if(strcmp(backends[i].name, name) == 0)
+        {
+            selected = &backends[i];
+            return 0;
+        }
+    }
+    return ENOENT;
+}
+
+const char *inflateBackendAt(int index)
+{
+    if(index < 0 || (size_t)index >= sizeof(backends) / sizeof(backends[0]))
+        return NULL;
+    return backends[index].name;
+}
+
+const char *inflateBackendName()
+{
+    return selected->name;
+}
+
+int initInflater(Inflater *inf, uint32_t signature)
+{
+    inf->stream.next_in = Z_NULL;
+    inf->stream.avail_in = 0;
+    inf->stream.zalloc = Z_NULL;
+    inf->stream.zfree = Z_NULL;
+    inf->stream.opaque = Z_NULL;
+    inf->signature = signature;
+    inf->backend = selected;
+    inf->state = NULL;
+    if(selected->alloc != NULL && (inf->state = selected->alloc()) == NULL)
+        return Z_MEM_ERROR;
+
+    //0xd1 has zlib header, others are raw deflate
+    if(signature == SIG_ELARGE)
+        return inflateInit(&inf->stream);
+    else
+        return inflateInit2_(&inf->stream,-15,ZLIB_VERSION,(int)sizeof(z_stream));
+}
+
+void freeInflater(Inflater *inf)
+{
+    inflateEnd(&inf->stream);
+    if(inf->state != NULL)
+        inf->backend->release(inf->state);
+    inf->state = NULL;
+}
+
+int inflateWhole(Inflater *inf, const uint8_t *in, size_t inLength, uint8_t *out, size_t outLength)
+{
+    return inf->backend->whole(inf, in, inLength, out, outLength);
+}
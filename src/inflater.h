@@ -0,0 +1,66 @@
+#ifndef INFLATER_H
+#define INFLATER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <zlib.h>
+
+//entries up to this size (both compressed and unpacked) are inflated in one call
+#define INFLATE_WHOLE_MAX 0x800000
+
+struct inflater_t;
+
+typedef struct inflatebackend_t
+{
+  const char    *name;
+  void          *(*alloc)();	//state of one-shot decompressor, NULL for none
+  void          (*release)(void *state);
+  int           (*whole)(struct inflater_t *inf, const uint8_t *in, size_t inLength,
+                         uint8_t *out, size_t outLength);	//see inflateWhole
+} InflateBackend;
+
+typedef struct inflater_t
+{
+  z_stream      stream;	//streaming inflate, zlib with every backend
+  uint32_t      signature;	//headerSignature, selects zlib wrapped or raw deflate
+  const InflateBackend *backend;
+  void          *state;	//one-shot decompressor of backend
+} Inflater;
+
+/*
+ * select inflate backend NAME used by inflaters initialized from now on,
+ * returns 0 or ENOENT if there is no such backend (or it was not built in)
+ */
+int selectInflateBackend(const char *name);
+
+/*
+ * return name of INDEXth backend built in, NULL past the last one; the first
+ * one is fastest and selected by default
+ */
+const char *inflateBackendAt(int index);
+
+/*
+ * return name of selected backend, for verbose output
+ */
+const char *inflateBackendName();
+
+/*
+ * initialize INF for container with SIGNATURE using selected backend,
+ * returns Z_OK or zlib error code
+ */
+int initInflater(Inflater *inf, uint32_t signature);
+
+/*
+ * free everything allocated by initInflater
+ */
+void freeInflater(Inflater *inf);
+
+/*
+ * inflate whole entry of INLENGTH bytes at IN into OUTLENGTH bytes at OUT in one call;
+ * returns Z_OK only if stream ended after exactly OUTLENGTH bytes (bytes of IN
+ * past stream end are ignored), otherwise zlib error code and content of OUT
+ * is undefined; every backend produces the same bytes
+ */
+int inflateWhole(Inflater *inf, const uint8_t *in, size_t inLength, uint8_t *out, size_t outLength);
+
+#endif
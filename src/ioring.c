@@ -0,0 +1,431 @@
+#define _GNU_SOURCE
+#include "ioring.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+
+#ifdef HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+
+/*
+ * create kernel ring of RING with room for every slot and map its queues;
+ * returns 0 or errno
+ */
+static int setupRing(IoRing *ring)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = syscall(__NR_io_uring_setup, 2 * ring->depth, &p);
+    if(fd < 0)
+        return errno == EPERM ? ENOSYS : errno;
+    ring->fd = fd;
+
+    ring->sqMapSize = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    ring->cqMapSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if(p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if(ring->cqMapSize > ring->sqMapSize)
+            ring->sqMapSize = ring->cqMapSize;
+        ring->cqMapSize = ring->sqMapSize;
+    }
+    ring->sqMap = mmap(NULL, ring->sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                       IORING_OFF_SQ_RING);
+    if(ring->sqMap == MAP_FAILED)
+    {
+        ring->sqMap = NULL;
+        return errno;
+    }
+    ring->cqMap = ring->sqMap;
+    if(!(p.features & IORING_FEAT_SINGLE_MMAP))
+    {
+        ring->cqMap = mmap(NULL, ring->cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                           IORING_OFF_CQ_RING);
+        if(ring->cqMap == MAP_FAILED)
+        {
+            ring->cqMap = NULL;
+            return errno;
+        }
+    }
+    ring->sqeSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqeSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if(ring->sqes == MAP_FAILED)
+    {
+        ring->sqes = NULL;
+        return errno;
+    }
+
+    uint8_t *sq = (uint8_t*)ring->sqMap, *cq = (uint8_t*)ring->cqMap;
+    ring->sqHead = (uint32_t*)(sq + p.sq_off.head);
+    ring->sqTail = (uint32_t*)(sq + p.sq_off.tail);
+    ring->sqMask = *(uint32_t*)(sq + p.sq_off.ring_mask);
+    ring->sqArray = (uint32_t*)(sq + p.sq_off.array);
+    ring->cqHead = (uint32_t*)(cq + p.cq_off.head);
+    ring->cqTail = (uint32_t*)(cq + p.cq_off.tail);
+    ring->cqMask = *(uint32_t*)(cq + p.cq_off.ring_mask);
+    ring->cqes = cq + p.cq_off.cqes;
+
+    //registered buffers save mapping them on every request, they are optional
+    //(locked memory may be limited)
+    uint32_t i, count = 2 * ring->depth;
+    struct iovec *iov = (struct iovec*)malloc(sizeof(struct iovec) * count);
+    if(iov != NULL)
+    {
+        for(i = 0; i < count; i++)
+        {
+            iov[i].iov_base = ring->slots[i].buffer;
+            iov[i].iov_len = IORING_BLOCK;
+        }
+        ring->registered = syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iov, count) == 0;
+        free(iov);
+    }
+    return 0;
+}
+
+static void unmapRing(IoRing *ring)
+{
+    if(ring->sqes != NULL)
+        munmap(ring->sqes, ring->sqeSize);
+    if(ring->cqMap != NULL && ring->cqMap != ring->sqMap)
+        munmap(ring->cqMap, ring->cqMapSize);
+    if(ring->sqMap != NULL)
+        munmap(ring->sqMap, ring->sqMapSize);
+    if(ring->fd >= 0)
+        close(ring->fd);
+    ring->sqes = ring->cqMap = ring->sqMap = NULL;
+    ring->fd = -1;
+}
+
+/*
+ * put request of slot S into submission queue of RING, it is passed to kernel by
+ * next enterRing
+ */
+static void queueSlot(IoRing *ring, uint32_t s, int write)
+{
+    IoSlot *slot = &ring->slots[s];
+    uint32_t tail = *ring->sqTail;
+    uint32_t index = tail & ring->sqMask;
+    struct io_uring_sqe *sqe = &((struct io_uring_sqe*)ring->sqes)[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    if(ring->registered)
+    {
+        sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe->buf_index = s;
+    }
+    else
+        sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = slot->fd;
+    sqe->off = slot->offset;
+    sqe->addr = (uintptr_t)slot->buffer;
+    sqe->len = slot->length;
+    sqe->user_data = s;
+    ring->sqArray[index] = index;
+    __atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+    slot->state = IOS_QUEUED;
+    ring->unsubmitted++;
+    ring->inFlight++;
+}
+
+/*
+ * pass queued requests of RING to kernel and wait until at least WAIT of them
+ * complete; returns 0 or errno
+ */
+static int enterRing(IoRing *ring, uint32_t wait)
+{
+    while(ring->unsubmitted != 0 || wait != 0)
+    {
+        int r = syscall(__NR_io_uring_enter, ring->fd, ring->unsubmitted, wait, wait ? IORING_ENTER_GETEVENTS : 0,
+                        NULL, 0);
+        ring->enters++;
+        if(r >= 0)
+        {
+            ring->unsubmitted -= r;
+            return 0;
+        }
+        if(errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            return errno;
+    }
+    return 0;
+}
+
+static void completeSlot(IoRing *ring, uint32_t s, int32_t result);
+
+/*
+ * handle every completion waiting in RING
+ */
+static void reapRing(IoRing *ring)
+{
+    uint32_t head = *ring->cqHead;
+    uint32_t tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+    while(head != tail)
+    {
+        struct io_uring_cqe *cqe = &((struct io_uring_cqe*)ring->cqes)[head & ring->cqMask];
+        completeSlot(ring, cqe->user_data, cqe->res);
+        head++;
+    }
+    __atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+}
+#else
+static int setupRing(IoRing *ring)
+{
+    return ENOSYS;
+}
+
+static void unmapRing(IoRing *ring)
+{
+}
+
+static void queueSlot(IoRing *ring, uint32_t s, int write)
+{
+}
+
+static int enterRing(IoRing *ring, uint32_t wait)
+{
+    return ENOSYS;
+}
+
+static void reapRing(IoRing *ring)
+{
+}
+#endif
+
+/*
+ * finish slot S of RING whose request transferred RESULT bytes (or failed with
+ * -RESULT); short writes are completed here
+ */
+static void completeSlot(IoRing *ring, uint32_t s, int32_t result)
+{
+    IoSlot *slot = &ring->slots[s];
+    ring->inFlight--;
+    slot->result = result;
+    if(s < ring->depth)
+    {
+        slot->state = IOS_DONE;
+        return;
+    }
+
+    uint32_t done = result > 0 ? result : 0;
+    while(result >= 0 && done < slot->length)
+    {
+        ssize_t bytes = pwrite(slot->fd, slot->buffer + done, slot->length - done, slot->offset + done);
+        if(bytes < 0 && errno == EINTR)
+            continue;
+        result = bytes > 0 ? 0 : (bytes < 0 ? -errno : -EIO);
+        done += bytes > 0 ? bytes : 0;
+    }
+    if(result < 0 && ring->writeError == 0)
+        ring->writeError = -result;
+    slot->state = IOS_FREE;
+}
+
+/*
+ * submit what is queued on RING and wait for at least one completion (none if
+ * nothing is in flight)
+ */
+static void waitRing(IoRing *ring)
+{
+    int error = enterRing(ring, ring->inFlight != 0);
+    reapRing(ring);
+    if(error == 0)
+        return;
+
+    //kernel refused to go on, queued requests fail
+    uint32_t s;
+    for(s = 0; s < 2 * ring->depth; s++)
+    {
+        if(ring->slots[s].state == IOS_QUEUED)
+            completeSlot(ring, s, -error);
+    }
+    ring->unsubmitted = 0;
+}
+
+int initRing(IoRing *ring, uint32_t depth)
+{
+    memset(ring, 0, sizeof(IoRing));
+    ring->fd = -1;
+    ring->readFd = -1;
+    ring->depth = depth ? depth : IORING_DEPTH;
+    ring->slots = (IoSlot*)calloc(2 * ring->depth, sizeof(IoSlot));
+    void *buffers = NULL;
+    if(ring->slots == NULL || posix_memalign(&buffers, 0x1000, (size_t)2 * ring->depth * IORING_BLOCK) != 0)
+    {
+        free(ring->slots);
+        ring->slots = NULL;
+        return ENOMEM;
+    }
+    ring->buffers = (uint8_t*)buffers;
+    uint32_t s;
+    for(s = 0; s < 2 * ring->depth; s++)
+        ring->slots[s].buffer = ring->buffers + (size_t)s * IORING_BLOCK;
+
+    int error = setupRing(ring);
+    if(error != 0)
+    {
+        unmapRing(ring);
+        free(ring->slots);
+        free(ring->buffers);
+        ring->slots = NULL;
+        ring->buffers = NULL;
+    }
+    return error;
+}
+
+void freeRing(IoRing *ring)
+{
+    if(ring->slots == NULL)
+        return;
+    stopRingRead(ring);
+    ringDrain(ring);
+    unmapRing(ring);
+    free(ring->slots);
+    free(ring->buffers);
+    ring->slots = NULL;
+    ring->buffers = NULL;
+}
+
+/*
+ * queue reads of range of RING until DEPTH blocks are ahead of the caller
+ */
+static void queueReads(IoRing *ring)
+{
+    uint32_t queued = 0;
+    while(ring->readIssued - ring->readTaken < ring->depth && ring->readNext < ring->readEnd)
+    {
+        uint32_t s = ring->readIssued % ring->depth;
+        if(ring->slots[s].state != IOS_FREE)
+            break;
+        IoSlot *slot = &ring->slots[s];
+        slot->fd = ring->readFd;
+        slot->offset = ring->readNext;
+        slot->length = ring->readEnd - ring->readNext < IORING_BLOCK ? ring->readEnd - ring->readNext : IORING_BLOCK;
+        queueSlot(ring, s, 0);
+        ring->readNext += slot->length;
+        ring->readIssued++;
+        queued++;
+    }
+    if(queued != 0 && enterRing(ring, 0) != 0)
+        waitRing(ring);
+}
+
+void startRingRead(IoRing *ring, int fd, off_t start, off_t end)
+{
+    stopRingRead(ring);
+    ring->readFd = fd;
+    ring->readNext = start;
+    ring->readEnd = end;
+    queueReads(ring);
+}
+
+ssize_t nextRingRead(IoRing *ring, const uint8_t **block)
+{
+    //block returned last time is not needed any more
+    uint32_t s;
+    if(ring->readTaken != 0 && ring->slots[(ring->readTaken - 1) % ring->depth].state == IOS_OWNED)
+        ring->slots[(ring->readTaken - 1) % ring->depth].state = IOS_FREE;
+    queueReads(ring);
+    if(ring->readTaken == ring->readIssued || ring->readShort)
+        return 0;
+
+    s = ring->readTaken % ring->depth;
+    IoSlot *slot = &ring->slots[s];
+    while(slot->state == IOS_QUEUED)
+        waitRing(ring);
+    ring->readTaken++;
+    slot->state = IOS_OWNED;
+    if(slot->result < 0)
+        return slot->result;
+
+    //regular files are read short only at their end, anything else is read here
+    uint32_t done = slot->result;
+    while(done < slot->length)
+    {
+        ssize_t bytes = pread(slot->fd, slot->buffer + done, slot->length - done, slot->offset + done);
+        if(bytes < 0 && errno == EINTR)
+            continue;
+        if(bytes < 0)
+            return -errno;
+        if(bytes == 0)
+            break;
+        done += bytes;
+    }
+
+    //blocks queued after end of file would not follow this one
+    if(done < slot->length)
+    {
+        ring->readEnd = ring->readNext;
+        ring->readShort = 1;
+    }
+    *block = slot->buffer;
+    return done;
+}
+
+void stopRingRead(IoRing *ring)
+{
+    uint32_t s;
+    for(s = 0; s < ring->depth; s++)
+    {
+        while(ring->slots[s].state == IOS_QUEUED)
+            waitRing(ring);
+        ring->slots[s].state = IOS_FREE;
+    }
+    ring->readFd = -1;
+    ring->readNext = ring->readEnd = 0;
+    ring->readIssued = ring->readTaken = 0;
+    ring->readShort = 0;
+}
+
+uint8_t *ringWriteBuffer(IoRing *ring)
+{
+    while(1)
+    {
+        uint32_t i;
+        for(i = 0; i < ring->depth; i++)
+        {
+            uint32_t s = ring->depth + (ring->writeNext + i) % ring->depth;
+            if(ring->slots[s].state == IOS_FREE)
+            {
+                ring->slots[s].state = IOS_OWNED;
+                ring->writeNext = (s - ring->depth + 1) % ring->depth;
+                return ring->slots[s].buffer;
+            }
+        }
+        if(ring->inFlight == 0)
+            return NULL;
+        waitRing(ring);
+    }
+}
+
+void ringWrite(IoRing *ring, uint8_t *buffer, int fd, off_t offset, uint32_t length)
+{
+    uint32_t s = (buffer - ring->buffers) / IORING_BLOCK;
+    IoSlot *slot = &ring->slots[s];
+    slot->fd = fd;
+    slot->offset = offset;
+    slot->length = length;
+    queueSlot(ring, s, 1);
+    if(enterRing(ring, 0) != 0)
+        waitRing(ring);
+    reapRing(ring);
+}
+
+void ringRelease(IoRing *ring, uint8_t *buffer)
+{
+    ring->slots[(buffer - ring->buffers) / IORING_BLOCK].state = IOS_FREE;
+}
+
+int ringDrain(IoRing *ring)
+{
+    uint32_t s;
+    for(s = ring->depth; s < 2 * ring->depth; s++)
+    {
+        while(ring->slots[s].state == IOS_QUEUED)
+            waitRing(ring);
+    }
+    int error = ring->writeError;
+    ring->writeError = 0;
+    return error;
+}
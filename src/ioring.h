@@ -0,0 +1,120 @@
+#ifndef IORING_H
+#define IORING_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+//default number of reads (and as many writes) one thread keeps queued
+#define IORING_DEPTH 8
+
+//size of buffer of one queued read or write
+#define IORING_BLOCK 0x40000
+
+typedef enum
+{
+  IOS_FREE = 0,
+  IOS_OWNED,	//write buffer being filled by caller
+  IOS_QUEUED,	//submitted, not completed yet
+  IOS_DONE	//read completed, waiting to be returned
+} IoSlotState;
+
+typedef struct ioslot_t
+{
+  uint8_t       *buffer;	//IORING_BLOCK bytes, OUTPUT_ALIGN aligned
+  IoSlotState   state;
+  int           fd;
+  off_t         offset;
+  uint32_t      length;
+  int32_t       result;	//bytes transferred or negative errno
+} IoSlot;
+
+/*
+ * io_uring of one thread with DEPTH read slots followed by DEPTH write slots;
+ * reads of one range are kept queued ahead of the caller, full write buffers are
+ * queued while the next one is filled
+ */
+typedef struct ioring_t
+{
+  int           fd;	//-1 when not set up
+  uint32_t      depth;
+  int           registered;	//buffers are registered, fixed reads and writes are used
+  IoSlot        *slots;
+  uint8_t       *buffers;
+  uint32_t      *sqHead;	//submission ring shared with kernel
+  uint32_t      *sqTail;
+  uint32_t      sqMask;
+  uint32_t      *sqArray;
+  void          *sqes;
+  uint32_t      *cqHead;	//completion ring
+  uint32_t      *cqTail;
+  uint32_t      cqMask;
+  void          *cqes;
+  void          *sqMap;
+  size_t        sqMapSize;
+  void          *cqMap;	//same as sqMap when kernel maps both at once
+  size_t        cqMapSize;
+  size_t        sqeSize;
+  uint32_t      unsubmitted;	//queued in submission ring, not passed to kernel yet
+  uint32_t      inFlight;
+  int           readFd;	//range being read
+  off_t         readNext;	//offset of next read to be queued
+  off_t         readEnd;
+  uint64_t      readIssued;	//blocks queued so far, block N is in slot N % depth
+  uint64_t      readTaken;	//blocks returned to caller
+  int           readShort;	//file ended in the last block returned
+  uint32_t      writeNext;	//write slot tried first
+  int           writeError;	//first failed queued write, returned by ringDrain
+  uint64_t      enters;	//io_uring_enter calls made
+} IoRing;
+
+/*
+ * set up RING keeping up to DEPTH reads and DEPTH writes queued; returns 0 or errno,
+ * ENOSYS when io_uring is not supported by build or kernel (or is not allowed)
+ */
+int initRing(IoRing *ring, uint32_t depth);
+
+/*
+ * wait for everything queued on RING and free it
+ */
+void freeRing(IoRing *ring);
+
+/*
+ * start reading bytes from START to END of file FD through RING, queueing reads of
+ * IORING_BLOCK bytes ahead; pending reads of previous range are waited for
+ */
+void startRingRead(IoRing *ring, int fd, off_t start, off_t end);
+
+/*
+ * store next block of range being read by RING into BLOCK, it stays valid until the
+ * next call; returns its length, 0 at end of range or negative errno
+ */
+ssize_t nextRingRead(IoRing *ring, const uint8_t **block);
+
+/*
+ * stop reading range of RING, waiting for reads still queued
+ */
+void stopRingRead(IoRing *ring);
+
+/*
+ * return free write buffer of IORING_BLOCK bytes of RING, waiting for a queued write
+ * to complete if there is none
+ */
+uint8_t *ringWriteBuffer(IoRing *ring);
+
+/*
+ * queue write of LENGTH bytes of BUFFER (from ringWriteBuffer) to FD at OFFSET,
+ * the buffer is returned to RING once written
+ */
+void ringWrite(IoRing *ring, uint8_t *buffer, int fd, off_t offset, uint32_t length);
+
+/*
+ * give BUFFER from ringWriteBuffer back to RING unwritten
+ */
+void ringRelease(IoRing *ring, uint8_t *buffer);
+
+/*
+ * wait for all writes queued on RING, returns 0 or errno of first one that failed
+ */
+int ringDrain(IoRing *ring);
+
+#endif
@@ -0,0 +1,332 @@
+#include "kernels.h"
+
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+static void xorResolve(uint8_t factor, unsigned char *buffer, size_t size);
+static uLong crcResolve(uLong crc, const unsigned char *buffer, size_t size);
+
+void (*xorKernel)(uint8_t, unsigned char*, size_t) = xorResolve;
+uLong (*crcKernel)(uLong, const unsigned char*, size_t) = crcResolve;
+
+static pthread_once_t kernelsOnce = PTHREAD_ONCE_INIT;
+static const char *selectedName = "scalar";
+
+/*
+ * zlib's crc32 with size_t length, its tables beat anything portable we could do
+ */
+static uLong crcZlib(uLong crc, const unsigned char *buffer, size_t size)
+{
+    while(size > 0x40000000)
+    {
+        crc = crc32(crc, buffer, 0x40000000);
+        buffer += 0x40000000;
+        size -= 0x40000000;
+    }
+    return crc32(crc, buffer, size);
+}
+
+static void selectKernels()
+{
+    xorKernel = xorScalar;
+    crcKernel = crcZlib;
+    selectedName = "scalar";
+    if(xorKernelSupported(KL_AVX512))
+    {
+        xorKernel = xorAvx512;
+        selectedName = "avx512";
+    }
+    else if(xorKernelSupported(KL_AVX2))
+    {
+        xorKernel = xorAvx2;
+        selectedName = "avx2";
+    }
+    else if(xorKernelSupported(KL_SSE2))
+    {
+        xorKernel = xorSse2;
+        selectedName = "sse2";
+    }
+    if(crcPclmulSupported())
+        crcKernel = crcPclmul;
+}
+
+void initKernels()
+{
+    pthread_once(&kernelsOnce, selectKernels);
+}
+
+static void xorResolve(uint8_t factor, unsigned char *buffer, size_t size)
+{
+    initKernels();
+    xorKernel(factor, buffer, size);
+}
+
+static uLong crcResolve(uLong crc, const unsigned char *buffer, size_t size)
+{
+    initKernels();
+    return crcKernel(crc, buffer, size);
+}
+
+const char *kernelName()
+{
+    initKernels();
+    return selectedName;
+}
+
+int xorKernelSupported(KernelLevel level)
+{
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    switch(level)
+    {
+    case KL_SCALAR:
+        return 1;
+    case KL_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case KL_AVX2:
+        return __builtin_cpu_supports("avx2");
+    case KL_AVX512:
+        return __builtin_cpu_supports("avx512f");
+    }
+    return 0;
+#else
+    return level == KL_SCALAR;
+#endif
+}
+
+int crcPclmulSupported()
+{
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+#else
+    return 0;
+#endif
+}
+
+void xorScalar(uint8_t factor, unsigned char *buffer, size_t size)
+{
+    size_t i;
+    for(i = 0; i < size; i++)
+    {
+        buffer[i] ^= factor;
+    }
+}
+
+uLong crcScalar(uLong crc, const unsigned char *buffer, size_t size)
+{
+    //bit at a time with reflected polynomial used by zlib
+    uint32_t c = (uint32_t)crc ^ 0xffffffff;
+    int j;
+    while(size--)
+    {
+        c ^= *buffer++;
+        for(j = 0; j < 8; j++)
+            c = (c & 1) ? (c >> 1) ^ 0xedb88320 : (c >> 1);
+    }
+    return c ^ 0xffffffff;
+}
+
+#ifdef KERNELS_X86
+
+__attribute__((target("sse2")))
+void xorSse2(uint8_t factor, unsigned char *buffer, size_t size)
+{
+    __m128i f = _mm_set1_epi8((char)factor);
+    size_t i = 0;
+    for(; i + 64 <= size; i += 64)
+    {
+        __m128i a = _mm_loadu_si128((__m128i*)(buffer + i));
+        __m128i b = _mm_loadu_si128((__m128i*)(buffer + i + 16));
+        __m128i c = _mm_loadu_si128((__m128i*)(buffer + i + 32));
+        __m128i d = _mm_loadu_si128((__m128i*)(buffer + i + 48));
+        _mm_storeu_si128((__m128i*)(buffer + i), _mm_xor_si128(a, f));
+        _mm_storeu_si128((__m128i*)(buffer + i + 16), _mm_xor_si128(b, f));
+        _mm_storeu_si128((__m128i*)(buffer + i + 32), _mm_xor_si128(c, f));
+        _mm_storeu_si128((__m128i*)(buffer + i + 48), _mm_xor_si128(d, f));
+    }
+    for(; i + 16 <= size; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((__m128i*)(buffer + i));
+        _mm_storeu_si128((__m128i*)(buffer + i), _mm_xor_si128(a, f));
+    }
+    xorScalar(factor, buffer + i, size - i);
+}
+
+__attribute__((target("avx2")))
+void xorAvx2(uint8_t factor, unsigned char *buffer, size_t size)
+{
+    __m256i f = _mm256_set1_epi8((char)factor);
+    size_t i = 0;
+    for(; i + 128 <= size; i += 128)
+    {
+        __m256i a = _mm256_loadu_si256((__m256i*)(buffer + i));
+        __m256i b = _mm256_loadu_si256((__m256i*)(buffer + i + 32));
+        __m256i c = _mm256_loadu_si256((__m256i*)(buffer + i + 64));
+        __m256i d = _mm256_loadu_si256((__m256i*)(buffer + i + 96));
+        _mm256_storeu_si256((__m256i*)(buffer + i), _mm256_xor_si256(a, f));
+        _mm256_storeu_si256((__m256i*)(buffer + i + 32), _mm256_xor_si256(b, f));
+        _mm256_storeu_si256((__m256i*)(buffer + i + 64), _mm256_xor_si256(c, f));
+        _mm256_storeu_si256((__m256i*)(buffer + i + 96), _mm256_xor_si256(d, f));
+    }
+    for(; i + 32 <= size; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((__m256i*)(buffer + i));
+        _mm256_storeu_si256((__m256i*)(buffer + i), _mm256_xor_si256(a, f));
+    }
+    xorSse2(factor, buffer + i, size - i);
+}
+
+__attribute__((target("avx512f")))
+void xorAvx512(uint8_t factor, unsigned char *buffer, size_t size)
+{
+    __m512i f = _mm512_set1_epi32(factor * 0x01010101u);
+    size_t i = 0;
+    for(; i + 256 <= size; i += 256)
+    {
+        __m512i a = _mm512_loadu_si512((void*)(buffer + i));
+        __m512i b = _mm512_loadu_si512((void*)(buffer + i + 64));
+        __m512i c = _mm512_loadu_si512((void*)(buffer + i + 128));
+        __m512i d = _mm512_loadu_si512((void*)(buffer + i + 192));
+        _mm512_storeu_si512((void*)(buffer + i), _mm512_xor_si512(a, f));
+        _mm512_storeu_si512((void*)(buffer + i + 64), _mm512_xor_si512(b, f));
+        _mm512_storeu_si512((void*)(buffer + i + 128), _mm512_xor_si512(c, f));
+        _mm512_storeu_si512((void*)(buffer + i + 192), _mm512_xor_si512(d, f));
+    }
+    for(; i + 64 <= size; i += 64)
+    {
+        __m512i a = _mm512_loadu_si512((void*)(buffer + i));
+        _mm512_storeu_si512((void*)(buffer + i), _mm512_xor_si512(a, f));
+    }
+    xorSse2(factor, buffer + i, size - i);
+}
+
+/*
+ * folding as described in Intel's "Fast CRC Computation for Generic Polynomials
+ * Using PCLMULQDQ Instruction", constants are for bit-reflected zlib polynomial;
+ * SIZE must be at least 64 and multiple of 16, CRC is not inverted here
+ */
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crcFold(uint32_t crc, const unsigned char *buffer, size_t size)
+{
+    static const uint64_t k1k2[] __attribute__((aligned(16))) = { 0x0154442bd4, 0x01c6e41596 };
+    static const uint64_t k3k4[] __attribute__((aligned(16))) = { 0x01751997d0, 0x00ccaa009e };
+    static const uint64_t k5k0[] __attribute__((aligned(16))) = { 0x0163cd6124, 0x0000000000 };
+    static const uint64_t poly[] __attribute__((aligned(16))) = { 0x01db710641, 0x01f7011641 };
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((__m128i*)(buffer + 0x00));
+    x2 = _mm_loadu_si128((__m128i*)(buffer + 0x10));
+    x3 = _mm_loadu_si128((__m128i*)(buffer + 0x20));
+    x4 = _mm_loadu_si128((__m128i*)(buffer + 0x30));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    x0 = _mm_load_si128((__m128i*)k1k2);
+    buffer += 64;
+    size -= 64;
+
+    //fold 4 x 128 bits in parallel
+    while(size >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        y5 = _mm_loadu_si128((__m128i*)(buffer + 0x00));
+        y6 = _mm_loadu_si128((__m128i*)(buffer + 0x10));
+        y7 = _mm_loadu_si128((__m128i*)(buffer + 0x20));
+        y8 = _mm_loadu_si128((__m128i*)(buffer + 0x30));
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+        buffer += 64;
+        size -= 64;
+    }
+
+    //fold into 128 bits
+    x0 = _mm_load_si128((__m128i*)k3k4);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    //remaining 16 byte blocks
+    while(size >= 16)
+    {
+        x2 = _mm_loadu_si128((__m128i*)buffer);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+        buffer += 16;
+        size -= 16;
+    }
+
+    //fold 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+    x0 = _mm_loadl_epi64((__m128i*)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    //Barrett reduction to 32 bits
+    x0 = _mm_load_si128((__m128i*)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return _mm_extract_epi32(x1, 1);
+}
+
+uLong crcPclmul(uLong crc, const unsigned char *buffer, size_t size)
+{
+    if(size >= 64)
+    {
+        size_t folded = size & ~(size_t)15;
+        crc = crcFold((uint32_t)crc ^ 0xffffffff, buffer, folded) ^ 0xffffffff;
+        buffer += folded;
+        size -= folded;
+    }
+    return crcZlib(crc, buffer, size);
+}
+
+#else
+
+void xorSse2(uint8_t factor, unsigned char *buffer, size_t size)
+{
+    xorScalar(factor, buffer, size);
+}
+
+void xorAvx2(uint8_t factor, unsigned char *buffer, size_t size)
+{
+    xorScalar(factor, buffer, size);
+}
+
+void xorAvx512(uint8_t factor, unsigned char *buffer, size_t size)
+{
+    xorScalar(factor, buffer, size);
+}
+
+uLong crcPclmul(uLong crc, const unsigned char *buffer, size_t size)
+{
+    return crcZlib(crc, buffer, size);
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <zlib.h>
+
+typedef enum
+{
+  KL_SCALAR = 0,	//plain C, runs everywhere
+  KL_SSE2,
+  KL_AVX2,
+  KL_AVX512
+} KernelLevel;
+
+/*
+ * XOR kernel selected by initKernels, xorBuffer goes through it
+ */
+extern void (*xorKernel)(uint8_t factor, unsigned char *buffer, size_t size);
+
+/*
+ * CRC32 kernel selected by initKernels, same semantics as zlib's crc32
+ */
+extern uLong (*crcKernel)(uLong crc, const unsigned char *buffer, size_t size);
+
+/*
+ * detect cpu features and select fastest kernels, called on first use of
+ * any kernel, but can be called at startup to keep detection out of hot loops
+ */
+void initKernels();
+
+/*
+ * return non-zero if xor kernel of LEVEL can run on this cpu
+ */
+int xorKernelSupported(KernelLevel level);
+
+/*
+ * return non-zero if carry-less multiplication crc kernel can run on this cpu
+ */
+int crcPclmulSupported();
+
+/*
+ * return name of kernels selected by initKernels, for verbose output
+ */
+const char *kernelName();
+
+/*
+ * xor every byte of BUFFER by FACTOR, reference and vectorized variants;
+ * variants not supported by cpu must not be called
+ */
+void xorScalar(uint8_t factor, unsigned char *buffer, size_t size);
+void xorSse2(uint8_t factor, unsigned char *buffer, size_t size);
+void xorAvx2(uint8_t factor, unsigned char *buffer, size_t size);
+void xorAvx512(uint8_t factor, unsigned char *buffer, size_t size);
+
+/*
+ * update CRC with SIZE bytes of BUFFER, bitwise reference for tests (zlib's
+ * crc32 is used where PCLMULQDQ is missing) and folding variant (needs
+ * crcPclmulSupported)
+ */
+uLong crcScalar(uLong crc, const unsigned char *buffer, size_t size);
+uLong crcPclmul(uLong crc, const unsigned char *buffer, size_t size);
+
+#endif
@@ -0,0 +1,125 @@
+#include "keyring.h"
+#include "xsdc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+/*
+ * store key string of LINE (terminated) into RING, counting it as rejected
+ * if it is not one
+ */
+static void addKey(Keyring *ring, char *line)
+{
+    //only the last field is key, the rest names container
+    char *edv = strrchr(line, '\t');
+    edv = edv != NULL ? edv + 1 : line;
+    while(*edv == ' ')
+        edv++;
+    size_t length = strlen(edv);
+    while(length > 0 && (edv[length - 1] == ' ' || edv[length - 1] == '\t'))
+        edv[--length] = '\0';
+
+    KeyringKey *key = &ring->keys[ring->count];
+    if(edvChecksum(edv, &key->checksum) != FUS_OK)
+    {
+        ring->rejected++;
+        return;
+    }
+    key->edv = edv;
+    ring->count++;
+}
+
+int loadKeyring(Keyring *ring, const char *path)
+{
+    memset(ring, 0, sizeof(Keyring));
+    FILE *file = fopen(path, "r");
+    if(file == NULL)
+        return errno;
+
+    struct stat st;
+    int result = 0;
+    if(fstat(fileno(file), &st) != 0)
+        result = errno;
+    else if((ring->text = (char*)malloc(st.st_size + 1)) == NULL)
+        result = ENOMEM;
+    else if(fread(ring->text, 1, st.st_size, file) != (size_t)st.st_size)
+        result = ferror(file) ? EIO : EINVAL;
+    fclose(file);
+    if(result != 0)
+    {
+        freeKeyring(ring);
+        return result;
+    }
+    ring->text[st.st_size] = '\0';
+
+    //every line may be a key
+    uint32_t lines = 1, i;
+    char *c;
+    for(c = ring->text; *c; c++)
+        lines += *c == '\n';
+    uint32_t buckets = 16;
+    while(buckets < lines)
+        buckets *= 2;
+    ring->keys = (KeyringKey*)malloc(sizeof(KeyringKey) * lines);
+    ring->buckets = (int32_t*)malloc(sizeof(int32_t) * buckets);
+    if(ring->keys == NULL || ring->buckets == NULL)
+    {
+        freeKeyring(ring);
+        return ENOMEM;
+    }
+    ring->mask = buckets - 1;
+    memset(ring->buckets, 0xff, sizeof(int32_t) * buckets);
+
+    char *line = ring->text;
+    while(line != NULL)
+    {
+        char *end = strchr(line, '\n');
+        if(end != NULL)
+            *end++ = '\0';
+        //strip the windows line ending too
+        size_t length = strlen(line);
+        if(length > 0 && line[length - 1] == '\r')
+            line[--length] = '\0';
+        if(length != 0 && line[0] != '#')
+            addKey(ring, line);
+        line = end;
+    }
+
+    //chained in reverse, so the first one of equal keys is found first
+    for(i = ring->count; i-- > 0;)
+    {
+        uint32_t bucket = ring->keys[i].checksum & ring->mask;
+        ring->keys[i].next = ring->buckets[bucket];
+        ring->buckets[bucket] = i;
+    }
+    return 0;
+}
+
+const char *findKey(const Keyring *ring, uint32_t checksum, uint32_t *matches)
+{
+    const char *edv = NULL;
+    uint32_t found = 0;
+    int32_t k;
+    for(k = ring->buckets[checksum & ring->mask]; k >= 0; k = ring->keys[k].next)
+    {
+        if(ring->keys[k].checksum != checksum)
+            continue;
+        if(found == 0)
+            edv = ring->keys[k].edv;
+        if(found == 0 || strcmp(edv, ring->keys[k].edv) != 0)
+            found++;
+    }
+    if(matches != NULL)
+        *matches = found;
+    return edv;
+}
+
+void freeKeyring(Keyring *ring)
+{
+    free(ring->text);
+    free(ring->keys);
+    free(ring->buckets);
+    memset(ring, 0, sizeof(Keyring));
+}
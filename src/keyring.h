@@ -0,0 +1,46 @@
+#ifndef KEYRING_H
+#define KEYRING_H
+
+#include <stdint.h>
+
+typedef struct keyringkey_t
+{
+  uint32_t      checksum;	//crc32 of data area the key belongs to
+  int32_t       next;	//next key in the same bucket, -1 ends chain
+  const char    *edv;	//key string in text of keyring
+} KeyringKey;
+
+/*
+ * key strings of many containers, found by checksum of their data area
+ */
+typedef struct keyring_t
+{
+  char          *text;	//whole keyring file, lines are terminated in place
+  KeyringKey    *keys;
+  uint32_t      count;
+  int32_t       *buckets;	//first key of every bucket, bucket is checksum & mask
+  uint32_t      mask;	//number of buckets - 1, number of buckets is power of 2
+  uint32_t      rejected;	//lines that are not key strings
+} Keyring;
+
+/*
+ * load keys from file at PATH into RING; every non-empty line is a key string
+ * (as in key file), optionally preceded by anything up to a tab (so manifest
+ * with keys is a keyring too), lines starting with # are skipped and lines
+ * that are not keys are only counted; returns 0 or errno
+ */
+int loadKeyring(Keyring *ring, const char *path);
+
+/*
+ * return first key string for data area with CHECKSUM from RING or NULL; number
+ * of different keys with that checksum (1 unless other ones differ from the first)
+ * is stored into MATCHES (may be NULL)
+ */
+const char *findKey(const Keyring *ring, uint32_t checksum, uint32_t *matches);
+
+/*
+ * free keys and text of RING
+ */
+void freeKeyring(Keyring *ring);
+
+#endif
@@ -0,0 +1,650 @@
+#include "libxsdm.h"
+#include "xsdc.h"
+#include "seekindex.h"
+
+//largest amount of output unpacked by one xsdmRead call
+#define READ_MAX 0x40000000
+
+//compressed chunk read at once when container is not in memory
+#define READ_CHUNK 0x4000
+
+typedef struct xsdmentry_t
+{
+  FileUnion     *file;	//entry in decrypted header
+  char          *name;	//inside decoded name table of header
+  off_t         offset;
+  uint64_t      compressedSize;
+  uint64_t      size;
+} XsdmEntry;
+
+typedef struct xsdmpoints_t
+{
+  Checkpoint    *points;	//sorted by output offset
+  uint32_t      count;
+  uint32_t      capacity;
+} XsdmPoints;
+
+struct xsdmarchive_t
+{
+  XsdmAllocator allocator;
+  SdcInput      in;
+  UnpackData    ud;
+  char          *key;	//copy of key string, ud points into it
+  Header        *header;
+  uint32_t      headerSize;
+  XsdmEntry     *entries;
+  uint32_t      count;
+  uint64_t      span;	//output between seek points, 0 records none
+  XsdmPoints    *points;	//seek points of every entry, allocated with first one
+  pthread_mutex_t lock;	//guards points, shared by readers
+};
+
+struct xsdmreader_t
+{
+  XsdmArchive   *archive;
+  XsdmEntry     *entry;
+  z_stream      stream;
+  uint8_t       *input;	//compressed chunk, used only when container is not in memory
+  off_t         inputPos;	//next compressed byte not handed to inflate
+  uint64_t      compressedRemaining;
+  uint64_t      remaining;	//bytes of entry not read yet
+  uint64_t      nextPoint;	//output offset from which next seek point is recorded
+  int           error;	//first failure, returned by every later read
+};
+
+static void *defaultAlloc(void *opaque, size_t size)
+{
+    return malloc(size);
+}
+
+static void defaultRelease(void *opaque, void *ptr)
+{
+    free(ptr);
+}
+
+static void *allocate(const XsdmAllocator *allocator, size_t size)
+{
+    return allocator->alloc(allocator->opaque, size);
+}
+
+static void release(const XsdmAllocator *allocator, void *ptr)
+{
+    if(ptr != NULL)
+        allocator->release(allocator->opaque, ptr);
+}
+
+static voidpf zlibAlloc(voidpf opaque, uInt items, uInt size)
+{
+    return allocate((XsdmAllocator*)opaque, (size_t)items * size);
+}
+
+static void zlibFree(voidpf opaque, voidpf ptr)
+{
+    release((XsdmAllocator*)opaque, ptr);
+}
+
+/*
+ * allocate archive with ALLOCATOR (NULL for malloc) whose input is yet to be opened
+ */
+static XsdmArchive *newArchive(const XsdmAllocator *allocator)
+{
+    XsdmAllocator fallback = {defaultAlloc, defaultRelease, NULL};
+    if(allocator == NULL)
+        allocator = &fallback;
+    XsdmArchive *ar = (XsdmArchive*)allocate(allocator, sizeof(XsdmArchive));
+    if(ar == NULL)
+        return NULL;
+    memset(ar, 0, sizeof(XsdmArchive));
+    ar->allocator = *allocator;
+    pthread_mutex_init(&ar->lock, NULL);
+    return ar;
+}
+
+/*
+ * fill entry table of AR from its decrypted header with decoded names,
+ * rejecting names that are outside of name table
+ */
+static int loadEntries(XsdmArchive *ar)
+{
+    Header *hdr = ar->header;
+    FileName *fn = (FileName*)&hdr->files[hdr->headerSize];
+    ar->count = hdr->headerSize;
+    ar->entries = (XsdmEntry*)allocate(&ar->allocator, sizeof(XsdmEntry) * (ar->count + 1));
+    if(ar->entries == NULL)
+        return ENOMEM;
+
+    off_t offset = (off_t)ar->headerSize + 4;
+    uint32_t i;
+    for(i = 0; i < ar->count; i++)
+    {
+        XsdmEntry *entry = &ar->entries[i];
+        uint32_t nameOffset;
+        entry->file = &hdr->files[i];
+        entry->offset = offset;
+        if(hdr->headerSignature == SIG_ELARGE)
+        {
+            nameOffset = entry->file->file4gb.fileNameOffset;
+            entry->compressedSize = entry->file->file4gb.compressedSize;
+            entry->size = entry->file->file4gb.fileSize;
+        }
+        else
+        {
+            nameOffset = entry->file->file.fileNameOffset;
+            entry->compressedSize = entry->file->file.compressedSize;
+            entry->size = entry->file->file.fileSize;
+        }
+        if(nameOffset >= fn->fileNameLength
+            || memchr(fn->fileName + nameOffset, '\0', fn->fileNameLength - nameOffset) == NULL)
+            return EBADMSG;
+        entry->name = (char*)fn->fileName + nameOffset;
+        dosPathToUnix(entry->name);
+        offset += entry->compressedSize;
+    }
+    return 0;
+}
+
+/*
+ * decrypt header of AR, whose input is open, with KEY and build its entry table
+ */
+static int loadArchive(XsdmArchive *ar, const char *key)
+{
+    size_t keyLength = strlen(key);
+    ar->key = (char*)allocate(&ar->allocator, keyLength + 1);
+    if(ar->key == NULL)
+        return ENOMEM;
+    memcpy(ar->key, key, keyLength + 1);
+    if(fillUnpackStruct(&ar->ud, ar->key) != FUS_OK)
+        return EINVAL;
+
+    //anything shorter is signature of unsupported format, not size
+    if(readInput(&ar->in, 0, &ar->headerSize, 4) != 4)
+        return EBADMSG;
+    if(ar->headerSize < 0xff || (off_t)ar->headerSize + 4 > ar->in.size)
+        return EBADMSG;
+    ar->header = (Header*)allocate(&ar->allocator, getDataOutputSize(ar->headerSize));
+    if(ar->header == NULL)
+        return ENOMEM;
+    if(loadHeader(&ar->in, ar->header, ar->headerSize, &ar->ud) != DD_OK)
+        return EIO;
+
+    //wrong key yields garbage, which hardly passes these
+    Header *hdr = ar->header;
+    if((hdr->headerSignature != SIG_ENCRYPTED && hdr->headerSignature != SIG_ELARGE)
+        || sizeof(Header) + (uint64_t)sizeof(FileUnion) * hdr->headerSize > ar->headerSize
+        || decodeFileNames(hdr, ar->headerSize, &ar->ud) != DD_OK)
+        return EBADMSG;
+    return loadEntries(ar);
+}
+
+/*
+ * finish opening AR whose input was opened with result ERROR, store it into ARCHIVE
+ */
+static int openArchive(XsdmArchive **archive, XsdmArchive *ar, int error, const char *key)
+{
+    if(error == 0)
+        error = loadArchive(ar, key);
+    if(error != 0)
+    {
+        xsdmClose(ar);
+        ar = NULL;
+    }
+    *archive = ar;
+    return error;
+}
+
+int xsdmOpenPath(XsdmArchive **archive, const char *path, const char *key, const XsdmAllocator *allocator)
+{
+    XsdmArchive *ar = newArchive(allocator);
+    *archive = NULL;
+    if(ar == NULL)
+        return ENOMEM;
+    return openArchive(archive, ar, openInput(&ar->in, path, 0), key);
+}
+
+int xsdmOpenFd(XsdmArchive **archive, int fd, const char *key, const XsdmAllocator *allocator)
+{
+    XsdmArchive *ar = newArchive(allocator);
+    *archive = NULL;
+    if(ar == NULL)
+        return ENOMEM;
+    return openArchive(archive, ar, openInputFd(&ar->in, fd, 0), key);
+}
+
+int xsdmOpenMemory(XsdmArchive **archive, const void *data, size_t size, const char *key,
+                   const XsdmAllocator *allocator)
+{
+    XsdmArchive *ar = newArchive(allocator);
+    *archive = NULL;
+    if(ar == NULL)
+        return ENOMEM;
+    openMemory(&ar->in, data, size);
+    return openArchive(archive, ar, 0, key);
+}
+
+void xsdmClose(XsdmArchive *ar)
+{
+    if(ar == NULL)
+        return;
+    if(ar->in.map != NULL || ar->in.file != NULL)
+        closeInput(&ar->in);
+    XsdmAllocator allocator = ar->allocator;
+    uint32_t i;
+    for(i = 0; ar->points != NULL && i < ar->count; i++)
+        release(&allocator, ar->points[i].points);
+    release(&allocator, ar->points);
+    pthread_mutex_destroy(&ar->lock);
+    release(&allocator, ar->entries);
+    release(&allocator, ar->header);
+    release(&allocator, ar->key);
+    release(&allocator, ar);
+}
+
+uint32_t xsdmEntryCount(const XsdmArchive *ar)
+{
+    return ar->count;
+}
+
+int xsdmEntryInfo(const XsdmArchive *ar, uint32_t index, XsdmEntryInfo *info)
+{
+    if(index >= ar->count)
+        return ERANGE;
+    const XsdmEntry *entry = &ar->entries[index];
+    info->name = entry->name;
+    info->size = entry->size;
+    info->compressedSize = entry->compressedSize;
+    info->offset = entry->offset;
+
+    //both variants share layout up to times
+    const File *file = &entry->file->file;
+    info->attributes = file->attributes;
+    info->creationTime = winTimeToUnix(file->creationTime);
+    info->accessTime = winTimeToUnix(file->accessTime);
+    info->modificationTime = winTimeToUnix(file->modificationTime);
+    return 0;
+}
+
+int xsdmFindEntry(const XsdmArchive *ar, const char *name, uint32_t *index)
+{
+    uint32_t i;
+    for(i = 0; i < ar->count; i++)
+    {
+        if(strcmp(ar->entries[i].name, name) == 0)
+        {
+            *index = i;
+            return 0;
+        }
+    }
+    return ENOENT;
+}
+
+int xsdmVerify(XsdmArchive *ar)
+{
+    uLong crc;
+    if(ar->in.map != NULL)
+        crc = countCrc(&ar->in, ar->headerSize);
+    else
+    {
+        //same as updateCrc, but buffer comes from allocator
+        uint8_t *buffer = (uint8_t*)allocate(&ar->allocator, 0x100000);
+        if(buffer == NULL)
+            return ENOMEM;
+        crc = crc32(0L, Z_NULL, 0);
+        off_t start = (off_t)ar->headerSize + 4;
+        size_t bytes;
+        while(start < ar->in.size
+              && (bytes = readInput(&ar->in, start, buffer, ar->in.size - start < 0x100000 ? ar->in.size - start : 0x100000)) != 0)
+        {
+            crc = crcKernel(crc, buffer, bytes);
+            start += bytes;
+        }
+        release(&ar->allocator, buffer);
+        if(start < ar->in.size)
+            return EIO;
+    }
+    return crc == ar->ud.checksum ? 0 : EBADMSG;
+}
+
+void xsdmSetSeekSpan(XsdmArchive *ar, uint64_t span)
+{
+    ar->span = span;
+}
+
+/*
+ * return free slot for seek point of entry INDEX of AR at OUTPUT, counted once it is
+ * filled; NULL if entry has one there or past it already or out of memory; called
+ * with lock held
+ */
+static Checkpoint *appendPoint(XsdmArchive *ar, uint32_t index, uint64_t output)
+{
+    if(ar->points == NULL)
+    {
+        ar->points = (XsdmPoints*)allocate(&ar->allocator, sizeof(XsdmPoints) * ar->count);
+        if(ar->points == NULL)
+            return NULL;
+        memset(ar->points, 0, sizeof(XsdmPoints) * ar->count);
+    }
+    XsdmPoints *list = &ar->points[index];
+    if(list->count != 0 && list->points[list->count - 1].output >= output)
+        return NULL;
+    if(list->count == list->capacity)
+    {
+        uint32_t capacity = list->capacity ? list->capacity * 2 : 16;
+        Checkpoint *points = (Checkpoint*)allocate(&ar->allocator, sizeof(Checkpoint) * capacity);
+        if(points == NULL)
+            return NULL;
+        if(list->count != 0)
+            memcpy(points, list->points, sizeof(Checkpoint) * list->count);
+        release(&ar->allocator, list->points);
+        list->points = points;
+        list->capacity = capacity;
+    }
+    return &list->points[list->count];
+}
+
+/*
+ * record position of reader RD, whose stream stopped at block boundary after OUTPUT
+ * bytes of entry, as seek point
+ */
+static void addPoint(XsdmReader *rd, uint64_t output)
+{
+    XsdmArchive *ar = rd->archive;
+    uint32_t index = rd->entry - ar->entries;
+    rd->nextPoint = output + ar->span;
+    pthread_mutex_lock(&ar->lock);
+    Checkpoint *point = appendPoint(ar, index, output);
+    z_stream *stream = &rd->stream;
+    uInt windowLength = RESUME_WINDOW;
+    if(point != NULL && inflateGetDictionary(stream, point->window, &windowLength) == Z_OK)
+    {
+        point->entry = index;
+        point->bits = stream->data_type & 7;
+        point->input = rd->inputPos - stream->avail_in;
+        point->output = output;
+        point->windowLength = windowLength;
+        ar->points[index].count++;
+    }
+    pthread_mutex_unlock(&ar->lock);
+}
+
+int xsdmLoadSeekPoints(XsdmArchive *ar, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return errno;
+
+    //index of xsdm knows identity of container file, here only its content is known
+    SeekIndexHeader sh;
+    struct stat st;
+    uint32_t check;
+    int error = EBADMSG;
+    if(read(fd, &sh, sizeof(sh)) != sizeof(sh)
+        || memcmp(sh.magic, SEEKINDEX_MAGIC, sizeof(sh.magic)) != 0
+        || sh.key.size != (uint64_t)ar->in.size
+        || sh.key.keyHash != hashKey(&ar->ud)
+        || fstat(fd, &st) != 0
+        || (uint64_t)st.st_size != sizeof(sh) + (uint64_t)sizeof(Checkpoint) * sh.count + sizeof(check))
+    {
+        close(fd);
+        return EBADMSG;
+    }
+
+    //points are counted only when the whole index turns out to be intact
+    uLong sum = crc32(0L, (Bytef*)&sh, sizeof(sh));
+    Checkpoint *scratch = (Checkpoint*)allocate(&ar->allocator, sizeof(Checkpoint));
+    uint32_t *added = (uint32_t*)allocate(&ar->allocator, sizeof(uint32_t) * (sh.count + 1));
+    uint32_t i, addedCount = 0;
+    pthread_mutex_lock(&ar->lock);
+    for(i = 0; scratch != NULL && added != NULL && i < sh.count; i++)
+    {
+        if(read(fd, scratch, sizeof(Checkpoint)) != sizeof(Checkpoint))
+            break;
+        sum = crc32(sum, (Bytef*)scratch, sizeof(Checkpoint));
+
+        //point outside of its entry is not used
+        XsdmEntry *entry = scratch->entry < ar->count ? &ar->entries[scratch->entry] : NULL;
+        if(entry == NULL || scratch->bits > 7 || scratch->windowLength > RESUME_WINDOW
+            || scratch->input <= (uint64_t)entry->offset || scratch->input > entry->offset + entry->compressedSize
+            || scratch->output >= entry->size)
+            continue;
+        Checkpoint *point = appendPoint(ar, scratch->entry, scratch->output);
+        if(point != NULL)
+        {
+            memcpy(point, scratch, sizeof(Checkpoint));
+            ar->points[scratch->entry].count++;
+            added[addedCount++] = scratch->entry;
+        }
+    }
+
+    if(added != NULL && i == sh.count && read(fd, &check, sizeof(check)) == sizeof(check) && check == sum)
+        error = 0;
+    else
+    {
+        //drop everything added from damaged index, in reverse order
+        while(addedCount != 0)
+            ar->points[added[--addedCount]].count--;
+        if(added == NULL || scratch == NULL)
+            error = ENOMEM;
+    }
+    pthread_mutex_unlock(&ar->lock);
+    release(&ar->allocator, scratch);
+    release(&ar->allocator, added);
+    close(fd);
+    return error;
+}
+
+int xsdmOpenEntry(XsdmArchive *ar, uint32_t index, XsdmReader **reader)
+{
+    *reader = NULL;
+    if(index >= ar->count)
+        return ERANGE;
+    XsdmReader *rd = (XsdmReader*)allocate(&ar->allocator, sizeof(XsdmReader));
+    if(rd == NULL)
+        return ENOMEM;
+    memset(rd, 0, sizeof(XsdmReader));
+    rd->archive = ar;
+    rd->entry = &ar->entries[index];
+    rd->inputPos = rd->entry->offset;
+    rd->compressedRemaining = rd->entry->compressedSize;
+    rd->remaining = rd->entry->size;
+    rd->nextPoint = ar->span;
+    if(ar->in.map == NULL && (rd->input = (uint8_t*)allocate(&ar->allocator, READ_CHUNK)) == NULL)
+    {
+        release(&ar->allocator, rd);
+        return ENOMEM;
+    }
+
+    //0xd1 has zlib header, others are raw deflate
+    rd->stream.zalloc = zlibAlloc;
+    rd->stream.zfree = zlibFree;
+    rd->stream.opaque = &ar->allocator;
+    int r = inflateInit2(&rd->stream, ar->header->headerSignature == SIG_ELARGE ? MAX_WBITS : -MAX_WBITS);
+    if(r != Z_OK)
+    {
+        release(&ar->allocator, rd->input);
+        release(&ar->allocator, rd);
+        return r == Z_MEM_ERROR ? ENOMEM : EINVAL;
+    }
+    *reader = rd;
+    return 0;
+}
+
+ssize_t xsdmRead(XsdmReader *rd, void *buffer, size_t length)
+{
+    if(rd->error != 0)
+        return -rd->error;
+    if(length > rd->remaining)
+        length = rd->remaining;
+    if(length > READ_MAX)
+        length = READ_MAX;
+
+    SdcInput *in = &rd->archive->in;
+    z_stream *stream = &rd->stream;
+    uint64_t position = rd->entry->size - rd->remaining;
+
+    //with seek points inflate stops at every block boundary
+    int flush = rd->archive->span != 0 ? Z_BLOCK : Z_NO_FLUSH;
+    stream->next_out = (Bytef*)buffer;
+    stream->avail_out = length;
+    while(stream->avail_out != 0)
+    {
+        if(stream->avail_in == 0)
+        {
+            size_t chunk;
+            if(rd->compressedRemaining == 0)
+            {
+                //entry ended before whole file was unpacked
+                rd->error = EBADMSG;
+                break;
+            }
+            if(in->map != NULL)
+            {
+                chunk = rd->compressedRemaining < READ_MAX ? rd->compressedRemaining : READ_MAX;
+                if(rd->inputPos + (off_t)chunk > in->size)
+                    chunk = rd->inputPos < in->size ? in->size - rd->inputPos : 0;
+                stream->next_in = in->map + rd->inputPos;
+            }
+            else
+            {
+                chunk = rd->compressedRemaining < READ_CHUNK ? rd->compressedRemaining : READ_CHUNK;
+                chunk = readInput(in, rd->inputPos, rd->input, chunk);
+                stream->next_in = rd->input;
+            }
+            if(chunk == 0)
+            {
+                rd->error = EIO;
+                break;
+            }
+            stream->avail_in = chunk;
+            rd->inputPos += chunk;
+            rd->compressedRemaining -= chunk;
+        }
+
+        int r = inflate(stream, flush);
+        if(r == Z_STREAM_END && stream->avail_out != 0)
+        {
+            rd->error = EBADMSG;
+            break;
+        }
+        if(r == Z_MEM_ERROR)
+        {
+            rd->error = ENOMEM;
+            break;
+        }
+        if(r != Z_OK && r != Z_STREAM_END)
+        {
+            rd->error = EBADMSG;
+            break;
+        }
+
+        uint64_t output = position + (length - stream->avail_out);
+        if(flush == Z_BLOCK && (stream->data_type & 0xc0) == 0x80 && output >= rd->nextPoint)
+            addPoint(rd, output);
+    }
+    if(rd->error != 0)
+        return -rd->error;
+
+    xorBuffer(rd->archive->ud.xorVal % 0x100, (unsigned char*)buffer, length);
+    rd->remaining -= length;
+    return length;
+}
+
+/*
+ * move reader RD to the beginning of its entry
+ */
+static int rewindReader(XsdmReader *rd)
+{
+    rd->inputPos = rd->entry->offset;
+    rd->compressedRemaining = rd->entry->compressedSize;
+    rd->remaining = rd->entry->size;
+    rd->nextPoint = rd->archive->span;
+    rd->stream.avail_in = 0;
+    int r = inflateReset2(&rd->stream, rd->archive->header->headerSignature == SIG_ELARGE ? MAX_WBITS : -MAX_WBITS);
+    return r == Z_OK ? 0 : EINVAL;
+}
+
+/*
+ * move reader RD to last seek point of its entry at or before OFFSET if it is
+ * past current position or if OFFSET is behind it; returns 0 or errno
+ */
+static int seekPoint(XsdmReader *rd, uint64_t offset)
+{
+    XsdmArchive *ar = rd->archive;
+    uint64_t position = rd->entry->size - rd->remaining;
+    uint32_t index = rd->entry - ar->entries;
+    pthread_mutex_lock(&ar->lock);
+    XsdmPoints *list = ar->points != NULL ? &ar->points[index] : NULL;
+    Checkpoint *point = NULL;
+    if(list != NULL && list->count != 0)
+    {
+        //binary search for last point not past OFFSET
+        uint32_t low = 0, high = list->count;
+        while(low < high)
+        {
+            uint32_t middle = (low + high) / 2;
+            if(list->points[middle].output <= offset)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+        if(low != 0)
+            point = &list->points[low - 1];
+    }
+    if(point == NULL || (point->output <= position && position <= offset))
+    {
+        pthread_mutex_unlock(&ar->lock);
+        return position <= offset ? 0 : rewindReader(rd);
+    }
+
+    uint8_t previous = 0;
+    int r = Z_OK;
+    if(point->bits != 0 && readInput(&ar->in, point->input - 1, &previous, 1) != 1)
+        r = Z_ERRNO;
+    if(r == Z_OK)
+        r = inflateAtPoint(&rd->stream, point->bits, previous, point->window, point->windowLength);
+    if(r == Z_OK)
+    {
+        rd->stream.avail_in = 0;
+        rd->inputPos = point->input;
+        rd->compressedRemaining = rd->entry->offset + rd->entry->compressedSize - point->input;
+        rd->remaining = rd->entry->size - point->output;
+        rd->nextPoint = point->output + ar->span;
+    }
+    pthread_mutex_unlock(&ar->lock);
+    return r == Z_OK ? 0 : r == Z_ERRNO ? EIO : EINVAL;
+}
+
+int xsdmSeek(XsdmReader *rd, uint64_t offset)
+{
+    if(offset > rd->entry->size)
+        return EINVAL;
+    int error = seekPoint(rd, offset);
+    if(error != 0)
+        return rd->error = error;
+    rd->error = 0;
+
+    //rest is inflated and thrown away
+    uint8_t skip[0x4000];
+    while(rd->entry->size - rd->remaining < offset)
+    {
+        uint64_t gap = offset - (rd->entry->size - rd->remaining);
+        ssize_t bytes = xsdmRead(rd, skip, gap < sizeof(skip) ? gap : sizeof(skip));
+        if(bytes <= 0)
+            return bytes < 0 ? -bytes : EBADMSG;
+    }
+    return 0;
+}
+
+uint64_t xsdmTell(const XsdmReader *rd)
+{
+    return rd->entry->size - rd->remaining;
+}
+
+void xsdmCloseEntry(XsdmReader *rd)
+{
+    if(rd == NULL)
+        return;
+    XsdmAllocator *allocator = &rd->archive->allocator;
+    inflateEnd(&rd->stream);
+    release(allocator, rd->input);
+    release(allocator, rd);
+}
@@ -0,0 +1,141 @@
+#ifndef LIBXSDM_H
+#define LIBXSDM_H
+
+/*
+ * embeddable reader of SDC containers: entries are decrypted, inflated and XORed
+ * straight into caller's buffers, nothing is written to disk
+ *
+ * every archive is independent and may be used on its own thread, entries of
+ * one archive may be read at once on different threads as long as each reader
+ * stays on one; functions returning int return 0 or errno
+ *
+ * library keeps two globals shared by all archives, not kept per archive: xor
+ * and crc32 kernels selected for the cpu once on first use, and stage counters
+ * of --stats, which are never enabled in the library; both are internal to it
+ * and separate from those of a program that links xsdm sources as well
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+//library is built with hidden visibility, only this API is exported
+#pragma GCC visibility push(default)
+
+typedef struct xsdmarchive_t XsdmArchive;
+typedef struct xsdmreader_t XsdmReader;
+
+typedef struct xsdmallocator_t
+{
+  void          *(*alloc)(void *opaque, size_t size);	//returns NULL when out of memory
+  void          (*release)(void *opaque, void *ptr);
+  void          *opaque;	//passed to both
+} XsdmAllocator;
+
+typedef struct xsdmentryinfo_t
+{
+  const char    *name;	//unix path inside container, valid until archive is closed
+  uint64_t      size;	//unpacked size
+  uint64_t      compressedSize;
+  uint64_t      offset;	//start of compressed data in container
+  uint32_t      attributes;	//windows file attributes
+  int64_t       creationTime;	//unix time
+  int64_t       accessTime;
+  int64_t       modificationTime;
+} XsdmEntryInfo;
+
+/*
+ * open container at PATH with KEY (content of its key file) into ARCHIVE;
+ * ALLOCATOR (copied, may be NULL for malloc) serves every allocation made for
+ * it and its readers; EINVAL for malformed key, EBADMSG when header does not
+ * decrypt with it
+ */
+int xsdmOpenPath(XsdmArchive **archive, const char *path, const char *key, const XsdmAllocator *allocator);
+
+/*
+ * same as xsdmOpenPath for container opened as seekable FD, it stays open and
+ * may be closed right after this call
+ */
+int xsdmOpenFd(XsdmArchive **archive, int fd, const char *key, const XsdmAllocator *allocator);
+
+/*
+ * same as xsdmOpenPath for container of SIZE bytes at DATA, it is read in place
+ * and has to stay there until ARCHIVE is closed
+ */
+int xsdmOpenMemory(XsdmArchive **archive, const void *data, size_t size, const char *key,
+                   const XsdmAllocator *allocator);
+
+/*
+ * free ARCHIVE, its readers have to be closed first
+ */
+void xsdmClose(XsdmArchive *archive);
+
+/*
+ * return number of entries of ARCHIVE
+ */
+uint32_t xsdmEntryCount(const XsdmArchive *archive);
+
+/*
+ * fill INFO with metadata of entry INDEX of ARCHIVE, ERANGE if there is none
+ */
+int xsdmEntryInfo(const XsdmArchive *archive, uint32_t index, XsdmEntryInfo *info);
+
+/*
+ * store index of entry of ARCHIVE named NAME (unix path) into INDEX, ENOENT if
+ * there is none
+ */
+int xsdmFindEntry(const XsdmArchive *archive, const char *name, uint32_t *index);
+
+/*
+ * count checksum of whole data area of ARCHIVE and compare it with the one of its
+ * key, EBADMSG if they differ; reading entries does not verify it
+ */
+int xsdmVerify(XsdmArchive *archive);
+
+/*
+ * make readers of ARCHIVE record seek point every SPAN bytes of entry they pass,
+ * so that xsdmSeek does not have to inflate from the beginning; every point
+ * takes 32 KiB, 0 (default) records none
+ */
+void xsdmSetSeekSpan(XsdmArchive *archive, uint64_t span);
+
+/*
+ * add seek points from index written by `xsdm --seek-points` at PATH to ARCHIVE,
+ * so that seeks are fast from the start; call it before reading; EBADMSG if index
+ * belongs to other container or key or is damaged
+ */
+int xsdmLoadSeekPoints(XsdmArchive *archive, const char *path);
+
+/*
+ * start reading entry INDEX of ARCHIVE from its beginning as READER
+ */
+int xsdmOpenEntry(XsdmArchive *archive, uint32_t index, XsdmReader **reader);
+
+/*
+ * unpack up to LENGTH next bytes of entry of READER into BUFFER; returns number of
+ * bytes stored (less than LENGTH only at the end of entry or above 1 GiB), 0 at
+ * its end or negative errno: EBADMSG when data is damaged or does not inflate to
+ * entry size, EIO when container ends early; error is repeated by later calls
+ */
+ssize_t xsdmRead(XsdmReader *reader, void *buffer, size_t length);
+
+/*
+ * move READER to OFFSET of its entry, going on from nearest seek point recorded
+ * before it (or from current position or the beginning) and inflating the rest;
+ * clears error of READER, EINVAL if OFFSET is past entry end
+ */
+int xsdmSeek(XsdmReader *reader, uint64_t offset);
+
+/*
+ * return offset in entry of READER the next read starts at
+ */
+uint64_t xsdmTell(const XsdmReader *reader);
+
+/*
+ * free READER
+ */
+void xsdmCloseEntry(XsdmReader *reader);
+
+#pragma GCC visibility pop
+
+#endif
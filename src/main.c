@@ -1,120 +1,118 @@
 #include "main.h"
 
-int main(int argc, char **argv)
-{
-    //TODO: get rid of mem leaks (valgrind)
-    uint8_t flags = 0;
-    const char *sdcFile = NULL;
-    FILE *hdrout = NULL;
-    int option;
-    while((option = getopt_long(argc, argv, "fvH:Vh", options, 0)) != -1)
-    {
-        switch(option)
-        {
-        case '?':
-            return EXIT_INVALIDOPT;
-        //force
-        case 'f':
-            flags |= F_FORCE;
-            break;
-        //verbose
-        case 'v':
-            flags |= F_VERBOSE;
-            break;
-        //header output
-        case 'H':
-            print_status("Opening header sink");
-            flags |= F_HEADEROUT;
-            hdrout = fopen(optarg, "w");
-            if(hdrout == NULL)
-            {
-                //error opening a file
-                print_fail();
-                perror(hdrout);
-                return errno;
-            }
-            print_ok();
-            break;
-        //version
-        case 'V':
-            print_version();
-            return EXIT_SUCCESS;
-        //help
-        case 'h':
-            print_help(PH_LONG,argv[0]);
-            return EXIT_SUCCESS;
-            break;
-        default:
-            print_help(PH_SHORT,argv[0]);
-            return EXIT_INVALIDOPT;
-        }
-    }
-    if((argc - optind) == 1)
-    {
-        //parsing argv successful
-        sdcFile = argv[optind];
-    }
-    else
-    {
-        print_help(PH_SHORT,argv[0]);
-        return EXIT_TOOLESS;
-    }
+static const char *progName = NULL;
 
-    print_status("Opening SDC file");
-    int result;
-    FILE *in = fopen(sdcFile,"r");
-    if(in == NULL)
+//what is done with entries, for status lines
+static const char *entryAction = "Unpacking";
+
+#define TIMESIZE	20
+
+/*
+ * print result of unpacking ENTRY, called by one thread at a time
+ */
+static void reportEntry(SdcEntry *entry)
+{
+    if(entry->status == EX_OK)
     {
-        //error opening a file
-        print_fail();
-        perror(sdcFile);
-        return errno;
+        print_status("%s '%s'", entryAction, entry->name);
+        print_ok();
+        return;
     }
-    print_ok();
 
-    //open key file
-    void *keyFileName = malloc(strlen(sdcFile)+5);
-    sprintf((char*)keyFileName,"%s.key",sdcFile);
-    FILE *key = fopen((char*)keyFileName,"r");
-    if(key == NULL)
+    print_status("%s '%s'", entryAction, entry->name);
+    print_fail();
+    switch(entry->status)
     {
-        //error opening a file
-        print_fail();
-        perror((char*)keyFileName);
-        return errno;
+    case EX_OPEN:
+        errno = entry->error;
+        perror(entry->outFile);
+        break;
+    case EX_INIT:
+        fprintf(stderr,"inflateInit failed with errorcode %d\n",entry->error);
+        break;
+    case EX_INFLATE:
+        fprintf(stderr,"inflate failed with errorcode %d (%s)\n",entry->error,zError(entry->error));
+        break;
+    case EX_WRITE:
+        fprintf(stderr,"%s: Writing '%s' failed: %s\n",progName,entry->outFile,strerror(entry->error));
+        break;
+    case EX_SIZE:
+        fprintf(stderr,"%s: '%s' inflates to more than %u bytes\n",progName,entry->name,entry->fileSize);
+        break;
+    default:
+        fprintf(stderr, "%s: Unexpected end of file!\n", progName);
+        break;
     }
+}
 
-    print_status("Verifying keyfile");
+/*
+ * report ENTRY queued by postEntry, called on reporter thread
+ */
+static void reportQueued(void *item)
+{
+    reportEntry((SdcEntry*)item);
+}
 
-    //load keyFileName
-    fseek(key,0,SEEK_END);
-    int unformattedLength = ftell(key);
-    fseek(key,0,SEEK_SET);
-    void *unformatted = malloc(unformattedLength+1);
-    fread(unformatted,1,unformattedLength,key);
-    ((unsigned char *)unformatted)[unformattedLength] = '\0';
-    fclose(key);
+/*
+ * pass finished ENTRY to reporter thread, so that workers print nothing
+ */
+static void postEntry(SdcEntry *entry)
+{
+    postProgress(entry);
+}
 
-    //fill unpack structure
-    UnpackData unpackData;
-    UnpackStatus us = fillUnpackStruct(&unpackData,unformatted);
-    switch(us)
+/*
+ * print size, compressed size, modification time, offset and name of COUNT ENTRIES
+ * to stdout at once, so listings of containers unpacked in parallel do not mix
+ */
+static void listEntries(const char *sdcFile, SdcEntry *entries, uint32_t count, uint32_t flags)
+{
+    uint32_t i;
+    flockfile(stdout);
+    if(flags & F_BATCH)
+        printf("%s:\n", sdcFile);
+    printf("%12s %12s %-19s %12s %s\n", "size", "compressed", "modified", "offset", "name");
+    for(i = 0; i < count; i++)
     {
-    case FUS_OK:
-        print_ok();
-        break;
-    default:
-        print_fail();
-        fprintf(stderr, "%s: Wrong format of a keyfile!\n", argv[0]);
-        return us;
+        SdcEntry *entry = &entries[i];
+        char mdtime[TIMESIZE];
+        unixTimeToStr(mdtime, TIMESIZE, winTimeToUnix(entry->file->file.modificationTime));
+        printf("%12u %12llu %-19s %12lld %s\n", entry->fileSize, (unsigned long long)entry->compressedSize,
+               mdtime, (long long)entry->offset, entry->name);
     }
+    if(flags & F_BATCH)
+        printf("\n");
+    fflush(stdout);
+    funlockfile(stdout);
+}
 
+/*
+ * save index of HDR of HDRSIZE bytes to PATH for KEY, failure only slows down
+ * next run so it is reported in verbose mode only
+ */
+static void storeIndex(const char *path, const IndexKey *key, const Header *hdr, uint32_t hdrSize,
+                       int crcKnown, uLong crc, uint32_t flags)
+{
+    int error = saveIndex(path, key, hdr, hdrSize, crcKnown, crc);
+    if(error != 0 && (flags & F_VERBOSE))
+        fprintf(stderr, "%s: Saving index '%s' failed: %s\n", progName, path, strerror(error));
+}
+
+/*
+ * load and decrypt header of container IN with keys of UD, its size is stored into
+ * HDRSIZE; returns header or NULL after printing why and storing exit status
+ * into RESULT
+ */
+static Header *readHeader(SdcInput *in, uint32_t flags, UnpackData *ud, uint32_t *hdrSize, int *result)
+{
     //load header size
-    uint8_t *hdrSizeBuff = (uint8_t*)malloc(4);
-    fread(hdrSizeBuff,1,4,in);
-    uint32_t headerSize = *(uint32_t*)hdrSizeBuff;
-    free(hdrSizeBuff);
-    hdrSizeBuff = NULL;
+    uint32_t headerSize = 0;
+    readInput(in, 0, &headerSize, 4);
+    *hdrSize = headerSize;
+
+    //everything past the header is checksummed as it streams by
+    if(flags & F_STREAM)
+        in->crcStart = (off_t)headerSize + 4;
 
     print_status("Validating SDC header");
 
@@ -125,74 +123,364 @@ int main(int argc, char **argv)
         print_fail();
         fprintf(stderr,
               "%s: Encountered unsupported format! Signature is probably "
-              "0x%02x\n", argv[0], headerSize);
-      return -1;
+              "0x%02x\n", progName, headerSize);
+      *result = -1;
+      return NULL;
     }
 
     //load and decode header
-    Header *header = (Header*)malloc(headerSize);
-    DecrError err = loadHeader(in, header, headerSize, &unpackData);
+    Header *header = (Header*)malloc(getDataOutputSize(headerSize));
+    DecrError err = loadHeader(in, header, headerSize, ud);
     if(err != DD_OK)
     {
         print_fail();
-        fprintf(stderr, "%s: Error when decrypting SDC header (errorcode: %d)\n", argv[0], err);
-        return err;
+        fprintf(stderr, "%s: Error when decrypting SDC header (errorcode: %d)\n", progName, err);
+        free(header);
+        *result = err;
+        return NULL;
     }
 
     //check if valid sdc file
-    fseeko(in,0,SEEK_END);
-    off_t sdcSize = ftello(in);//FIXME: check if still needed
     if((sizeof(Header) + (sizeof(File) * header->headerSize)) > headerSize)
     {
-        printf("[ FAIL ]\n");
-        fprintf(stderr, "%s: File given is not valid SDC file or decryption key wrong\n", argv[0]);
+        print_fail();
+        fprintf(stderr, "%s: File given is not valid SDC file or decryption key wrong\n", progName);
         if(! (flags & F_FORCE))
-            return -1;
+        {
+            free(header);
+            *result = -1;
+            return NULL;
+        }
     }
 
     print_ok();
+    return header;
+}
 
-    print_status("Checking file integrity");
+/*
+ * set up RS to resume unpacking COUNT entries of container IN at SDCFILE (with key
+ * of UD), taking checkpoint every INTERVAL of output, and load state of
+ * interrupted run if there is one; returns NULL if container cannot be resumed
+ */
+static ResumeState *openResume(ResumeState *rs, const char *sdcFile, SdcInput *in,
+                               const UnpackData *ud, uint32_t count, uint64_t interval, uint32_t flags)
+{
+    IndexKey key;
+    int error = indexKey(&key, fileno(in->file), ud);
+    if(error == 0)
+    {
+        char *path = (char*)malloc(strlen(sdcFile) + sizeof(RESUME_SUFFIX));
+        if(path == NULL)
+            error = ENOMEM;
+        else
+        {
+            sprintf(path, "%s%s", sdcFile, RESUME_SUFFIX);
+            error = initResume(rs, path, &key, count, interval);
+            free(path);
+            if(error != 0)
+                freeResume(rs);
+        }
+    }
+    if(error != 0)
+    {
+        fprintf(stderr, "%s: %s: Cannot resume: %s\n", progName, sdcFile, strerror(error));
+        return NULL;
+    }
 
-    //count crc32
-    uLong crc = countCrc(in, headerSize);
-    if(flags & F_VERBOSE)
-        fprintf(stderr, "%s: crc32: 0x%08lX; orig: 0x%08X\n", argv[0], crc, unpackData.checksum);
+    if(loadResume(rs) == 0 && (flags & F_VERBOSE))
+        fprintf(stderr, "%s: resuming from %s, %u entries in progress\n", progName, rs->path, rs->header.pointCount);
+    return rs;
+}
 
-    //check if crc is valid
-    if(crc != unpackData.checksum)
+/*
+ * set up SI with seek points of container IN at SDCFILE (with key of UD) saved by
+ * earlier run or, if there are none, to record them every SPAN of output; their
+ * file is stored into PATH; returns NULL if container cannot have them
+ */
+static SeekIndex *openSeekIndex(SeekIndex *si, char **path, const char *sdcFile, SdcInput *in,
+                                const UnpackData *ud, uint64_t span, uint32_t flags)
+{
+    IndexKey key;
+    if(indexKey(&key, fileno(in->file), ud) != 0)
+        return NULL;
+    *path = (char*)malloc(strlen(sdcFile) + sizeof(SEEKINDEX_SUFFIX));
+    sprintf(*path, "%s%s", sdcFile, SEEKINDEX_SUFFIX);
+    initSeekIndex(si, &key, span);
+    if(loadSeekIndex(si, *path, 1) == 0 && (flags & F_VERBOSE))
+        fprintf(stderr, "%s: %u seek points taken from %s\n", progName, si->header.count, *path);
+    return si;
+}
+
+/*
+ * return checksum of data area of IN after header of HDRSIZE bytes, counted on
+ * JOBS threads while status line LABEL shows progress
+ */
+static uLong countDataCrc(SdcInput *in, uint32_t hdrSize, int jobs, Settings *set, const char *label)
+{
+    //reporter redraws status line while slices are checksummed
+    if(!quietOutput && startProgress(set->progress, label, in->size - hdrSize - 4, NULL) == 0 && progressEnabled)
+        in->checked = progressCounter();
+    uLong crc = countCrcParallel(in, hdrSize, jobs, set->crcSlice);
+    in->checked = NULL;
+    if(!quietOutput)
+        stopProgress();
+    return crc;
+}
+
+/*
+ * checksum data area of container IN at SDCFILE and store copy of key with the
+ * same checksum from keyring of SET into EDV and the checksum into CRC; returns 0
+ * or exit status after printing why
+ */
+static int keyFromRing(SdcInput *in, const char *sdcFile, uint32_t flags, int jobs, Settings *set, uLong *crc,
+                       void **edv)
+{
+    print_status("Finding key in keyring");
+    if(flags & F_STREAM)
     {
+        //key decides how stream is read before its checksum is known
         print_fail();
-        fprintf(
-            stderr, "%s: CRC32 of sdc file did not match the one supplied in keyfile (0x%04X expected while have 0x%04lX)\n",
-            argv[0], unpackData.checksum, crc
-        );
-        if(! (flags & F_FORCE))
-            return crc;
+        fprintf(stderr, "%s: Key has to be given with --key when reading from stream\n", progName);
+        return EXIT_INVALIDOPT;
+    }
+    uint32_t headerSize = 0;
+    if(readInput(in, 0, &headerSize, 4) != 4 || (off_t)headerSize + 4 > in->size)
+    {
+        print_fail();
+        fprintf(stderr, "%s: %s: Unexpected end of file!\n", progName, sdcFile);
+        return -1;
+    }
+
+    *crc = countDataCrc(in, headerSize, jobs, set, "Finding key in keyring");
+    uint32_t matches = 0;
+    const char *key = findKey(set->keyring, *crc, &matches);
+    if(key == NULL)
+    {
+        print_fail();
+        fprintf(stderr, "%s: %s: No key in keyring matches checksum 0x%08lX\n", progName, sdcFile, *crc);
+        return ENOKEY;
+    }
+    print_ok();
+    if(matches > 1)
+        fprintf(stderr, "%s: %s: %u different keys match checksum 0x%08lX, using the first one\n", progName,
+                sdcFile, matches, *crc);
+    *edv = strdup(key);
+    return 0;
+}
+
+/*
+ * rename files of COUNT ENTRIES unpacked under PART_SUFFIX to their final names
+ * if KEEP, remove them otherwise; entries that were never started have none
+ */
+static void finishOutputs(SdcEntry *entries, uint32_t count, int keep)
+{
+    uint32_t i;
+    for(i = 0; i < count; i++)
+    {
+        int result = finishOutput(&entries[i], PART_SUFFIX, keep);
+        if(result != 0 && result != ENOENT && keep)
+            fprintf(stderr, "%s: %s: %s\n", progName, entries[i].outFile, strerror(result));
+    }
+}
+
+/*
+ * unpack opened container IN of SDCFILE with FLAGS and JOBS, see unpackSdc
+ */
+static int unpackInput(SdcInput *in, const char *sdcFile, uint32_t flags, int jobs, Settings *set)
+{
+    FILE *hdrout = set->hdrout;
+    const char *keyString = set->key;
+    int result;
+
+    //with keyring the key is found by checksum, which is verified by that
+    void *unformatted = NULL;
+    int keyCrcKnown = 0;
+    uLong keyCrc = 0;
+    if(keyString != NULL)
+    {
+        print_status("Verifying key");
+        unformatted = strdup(keyString);
+    }
+    else if(set->keyring != NULL)
+    {
+        if((result = keyFromRing(in, sdcFile, flags, jobs, set, &keyCrc, &unformatted)) != 0)
+            return result;
+        keyCrcKnown = 1;
+        print_status("Verifying key");
     }
     else
+    {
+        if(strcmp(sdcFile, "-") == 0)
+        {
+            //there is no key file next to stdin
+            print_fail();
+            fprintf(stderr, "%s: Key has to be given with --key when reading from stdin\n", progName);
+            return EXIT_INVALIDOPT;
+        }
+
+        //open key file
+        void *keyFileName = malloc(strlen(sdcFile)+5);
+        sprintf((char*)keyFileName,"%s.key",sdcFile);
+        FILE *key = fopen((char*)keyFileName,"r");
+        if(key == NULL)
+        {
+            //error opening a file
+            print_fail();
+            result = errno;
+            perror((char*)keyFileName);
+            free(keyFileName);
+            return result;
+        }
+        free(keyFileName);
+
+        print_status("Verifying keyfile");
+
+        //load keyFileName
+        fseek(key,0,SEEK_END);
+        int unformattedLength = ftell(key);
+        fseek(key,0,SEEK_SET);
+        unformatted = malloc(unformattedLength+1);
+        fread(unformatted,1,unformattedLength,key);
+        ((unsigned char *)unformatted)[unformattedLength] = '\0';
+        fclose(key);
+    }
+
+    //fill unpack structure
+    UnpackData unpackData;
+    UnpackStatus us = fillUnpackStruct(&unpackData,unformatted);
+    switch(us)
+    {
+    case FUS_OK:
         print_ok();
+        break;
+    default:
+        print_fail();
+        fprintf(stderr, "%s: Wrong format of a keyfile!\n", progName);
+        free(unformatted);
+        return us;
+    }
+
+    //header of container seen before is taken from its index, decrypted
+    IndexKey indexId;
+    char *indexFile = NULL;
+    Header *header = NULL;
+    uint32_t headerSize = 0;
+    int crcKnown = 0;
+    uLong crc = 0;
+    if((flags & F_INDEX) && ! (flags & F_STREAM) && indexKey(&indexId, fileno(in->file), &unpackData) == 0)
+    {
+        indexFile = indexPath(sdcFile, set->indexDir, &indexId);
+        header = loadIndex(indexFile, &indexId, &headerSize, &crcKnown, &crc);
+        if(header != NULL && (flags & F_VERBOSE))
+            fprintf(stderr, "%s: header taken from %s\n", progName, indexFile);
+    }
+    if(keyCrcKnown)
+    {
+        crcKnown = 1;
+        crc = keyCrc;
+    }
+    int indexed = header != NULL;
+    if(!indexed && (header = readHeader(in, flags, &unpackData, &headerSize, &result)) == NULL)
+    {
+        free(indexFile);
+        free(unpackData.unformatted);
+        return result;
+    }
+
+    //everything from here on is freed at out, batch calls this for every container
+    ResumeState resumeState, *resume = NULL;
+    SeekIndex seekIndex, *points = NULL;
+    char *pointsFile = NULL;
+    Header *pristine = NULL;
+    SdcEntry *entries = NULL;
+    DirTree tree;
+    memset(&tree, 0, sizeof(DirTree));
+    int status = 0, missing = 0;
+
+    //get sdc location, dirname may return static "." instead of its argument
+    char *sdcCopy = strdup(sdcFile);
+    const char *sdcDir = dirname(sdcCopy);
+
+    //earlier run left checksum and entries done behind
+    if(flags & F_RESUME)
+        resume = openResume(&resumeState, sdcFile, in, &unpackData, header->headerSize, set->checkpointInterval, flags);
+    if(flags & F_POINTS)
+        points = openSeekIndex(&seekIndex, &pointsFile, sdcFile, in, &unpackData, set->seekSpan, flags);
+    if(resume != NULL && resume->header.crcKnown && !crcKnown)
+    {
+        crcKnown = 1;
+        crc = resume->header.crc;
+    }
+
+    //known checksum is verified up front for free, no need for temporary files
+    int crcCounted = keyCrcKnown;
+    if(crcKnown)
+        flags &= ~F_ONEPASS;
+
+    //listing and selected entries need only header, not whole data area,
+    //unless its checksum is already known
+    if(crcKnown || ! (flags & (F_ONEPASS | F_LIST | F_SELECT)))
+    {
+        print_status("Checking file integrity");
+
+        //count crc32
+        if(!crcKnown)
+        {
+            crc = countDataCrc(in, headerSize, jobs, set, "Checking file integrity");
+            crcKnown = crcCounted = 1;
+        }
+        if(flags & F_VERBOSE)
+            fprintf(stderr, "%s: crc32: 0x%08lX; orig: 0x%08X\n", progName, crc, unpackData.checksum);
+
+        //check if crc is valid
+        if(crc != unpackData.checksum)
+        {
+            print_fail();
+            fprintf(
+                stderr, "%s: CRC32 of sdc file did not match the one supplied in keyfile (0x%04X expected while have 0x%04lX)\n",
+                progName, unpackData.checksum, crc
+            );
+            if(! (flags & F_FORCE))
+            {
+                result = EXIT_CHECKSUM;
+                goto out;
+            }
+        }
+        else
+            print_ok();
+    }
+    if(resume != NULL && crcCounted && crc == unpackData.checksum)
+        resumeCrc(resume, crc);
 
-    FileUnion *current = header->files;
-    off_t filestart = headerSize + 4;
     File *after = &header->files[header->headerSize].file;
     FileName *fn = (FileName*)after;
 
-    print_status("Decoding file name");
-
-    //decode data from header
-    uint32_t fnLength = fn->fileNameLength;
-    unsigned char *data = (unsigned char*)malloc(getDataOutputSize(fn->fileNameLength) + 1);
-    err = decryptData(&fn->fileName, &fnLength, data, unpackData.fileNameKey, 32);
-    if(err != DD_OK)
+    if(!indexed)
     {
-        print_fail();
-        fprintf(stderr, "%s: Error while decrypting file name (errorcode: %d)", argv[0], err);
-        return err;
+        print_status("Decoding file name");
+
+        //decode data from header
+        DecrError err = decodeFileNames(header, headerSize, &unpackData);
+        if(err != DD_OK)
+        {
+            print_fail();
+            fprintf(stderr, "%s: Error while decrypting file name (errorcode: %d)", progName, err);
+            result = err;
+            goto out;
+        }
+
+        print_ok();
     }
-    memcpy((void*)&fn->fileName,data, fnLength);
 
-    print_ok();
+    //names are turned into unix paths in place, keep them as decoded for index
+    //stored once single pass counts checksum
+    if(indexFile != NULL && (!indexed || crcCounted))
+        storeIndex(indexFile, &indexId, header, headerSize, crcKnown, crc, flags);
+    if(indexFile != NULL && (flags & F_ONEPASS) && ! (flags & F_STREAM))
+    {
+        pristine = (Header*)malloc(headerSize);
+        memcpy(pristine, header, headerSize);
+    }
 
     // write decrypted header to file
     if(flags & F_HEADEROUT && hdrout)
@@ -202,47 +490,101 @@ int main(int argc, char **argv)
         fclose(hdrout);
     }
 
-    // unpack files
-    int fileid;
-    for(fileid = 0; fileid < header->headerSize; fileid++)
-    {
-        char *filename = (char*)(&fn->fileName);
-        filename += current->file.fileNameOffset;
-        uint32_t fn_size = strlen(filename);
+    //compute offsets of all entries up front
+    entries = (SdcEntry*)malloc(sizeof(SdcEntry) * header->headerSize);
+    fillEntries(entries, header, headerSize, fn);
+    uint32_t count = header->headerSize;
 
-        if(flags & F_VERBOSE)
-            fprintf(stderr,"File path: %s\n",filename);
+    if(flags & F_LIST)
+    {
+        listEntries(sdcFile, entries, count, flags);
+        result = EXIT_SUCCESS;
+        goto out;
+    }
 
-        dosPathToUnix(filename);
+    //drop entries not matching any pattern, the rest is never read
+    if(flags & F_SELECT)
+    {
+        uint32_t *hits = (uint32_t*)malloc(sizeof(uint32_t) * set->patternCount);
+        count = selectEntries(entries, count, set->patterns, set->patternCount, hits);
+        uint32_t p;
+        for(p = 0; p < set->patternCount; p++)
+        {
+            if(hits[p] == 0)
+            {
+                fprintf(stderr, "%s: %s: No entry matches '%s'\n", progName, sdcFile, set->patterns[p]);
+                missing = 1;
+            }
+        }
+        free(hits);
+    }
 
-        void *dirName = malloc(fn_size + 1);
-        strcpy((char*)dirName,filename);
-        dirName = dirname((char*)dirName);
+    //every directory is created once and outputs are opened relative to it
+    if(! (flags & F_VERIFY))
+        print_status("Creating directory structure");
+    int onePass = (flags & F_ONEPASS) && ! (flags & F_VERIFY);
+    if((result = buildDirTree(&tree, sdcDir, entries, count, onePass ? PART_SUFFIX : NULL, ! (flags & F_VERIFY))) != 0)
+    {
+        print_fail();
+        fprintf(stderr, "%s: %s\n", progName, strerror(result));
+        goto out;
+    }
+    uint32_t d, failedDirs = 0;
+    for(d = 1; d < tree.count; d++)
+    {
+        TreeDir *dir = &tree.dirs[d];
+        if(dir->error == 0)
+            continue;
+        if(failedDirs++ == 0)
+            print_fail();
+        fprintf(stderr, "%s: Directory '%.*s' creation failed: %s\n", progName, (int)dir->length, dir->path,
+                strerror(dir->error));
+    }
+    if(! (flags & F_VERIFY) && failedDirs == 0)
+        print_ok();
 
-        char *baseName = basename(filename);
+    Extractor ex;
+    ex.in = in;
+    ex.signature = header->headerSignature;
+    ex.xorVal = unpackData.xorVal % 0x100;
+    ex.countCrc = (flags & F_ONEPASS) && ! (flags & F_STREAM);
+    ex.queueDepth = (flags & F_PIPELINE) ? set->queueDepth : 0;
+    ex.chunkSize = set->chunkSize;
+    ex.direct = (flags & F_DIRECT) != 0;
+    ex.discard = (flags & F_VERIFY) != 0;
+    ex.resume = resume;
+    ex.points = points;
 
-        //get sdc location
-        char *sdcDir = (char*)malloc(strlen(sdcFile)+1);
-        strcpy(sdcDir,sdcFile);
-        sdcDir = dirname(sdcDir);
+    //threads left over by entry workers unpack segments of their entries
+    ex.segments = jobs / (count != 0 && count < jobs ? count : jobs);
+    ExtractState st;
+    if(jobs == 1 && (result = initExtractState(&st, ex.signature)) != Z_OK)
+    {
+        fprintf(stderr,"inflateInit failed with errorcode %d (%s)\n",result,st.inflater.stream.msg);
+        goto out;
+    }
 
-        print_status("Creating directory structure at '%s'", dirName);
+    //entries are reported by reporter thread, workers only count bytes written
+    int fileid;
+    uint64_t unpackSize = 0;
+    for(fileid = 0; fileid < count; fileid++)
+        unpackSize += entries[fileid].fileSize;
+    void (*report)(SdcEntry*) = quietOutput ? reportEntry : postEntry;
+    if(!quietOutput)
+        startProgress(set->progress, entryAction, unpackSize, reportQueued);
 
-        //create directory according to header
-        char *outFile = (char*)malloc(strlen(sdcDir)+strlen((char*)dirName)+2);
-        sprintf(outFile,"%s/%s",sdcDir,(char*)dirName);
-        int ret = createDir(outFile);
-        if(ret != 0)
-        {
-            print_fail();
-            fprintf(stderr,"%s: Directory '%s' creation failed with errno: %d\n",argv[0], outFile,errno);
-        }
+    // unpack files
+    for(fileid = 0; fileid < count; fileid++)
+    {
+        SdcEntry *entry = &entries[fileid];
+        FileUnion *current = entry->file;
+        char *filename = entry->name;
 
-        print_ok();
+        if(flags & F_VERBOSE)
+            fprintf(stderr,"File path: %s\n",filename);
 
         if(flags & F_VERBOSE)
         {
-#define TIMESIZE	20
         char crtime[TIMESIZE];
         time_t creation = winTimeToUnix(current->file.creationTime);
         unixTimeToStr(crtime, TIMESIZE, creation);
@@ -256,157 +598,678 @@ int main(int argc, char **argv)
         unixTimeToStr(mdtime, TIMESIZE, modification);
 
         fprintf(stderr, "File has been originally created at %s, last accessed at %s and modified at %s\n", crtime, actime, mdtime);
-        }
 
-        print_status("Unpacking '%s'", baseName);
+        fprintf(stderr,"file size has been set as %u (0x%04X), signature: 0x%02X\n",entry->fileSize,entry->fileSize,header->headerSignature);
+        }
 
-        //open output file
-        outFile = (char*)realloc(outFile, strlen(sdcDir)+strlen((char*)dirName)+strlen(baseName)+3);
-        sprintf(outFile,"%s/%s/%s",sdcDir,(char*)dirName,baseName);
-        FILE *out = fopen(outFile,"w");
-        if(out == NULL)
+        if(jobs == 1)
         {
-            //error opening a file
-            print_fail();
-            perror(outFile);
-            return errno;
+            extractEntry(&ex, &st, entry);
+            report(entry);
+            if(entry->status != EX_OK && entry->status != EX_EOF)
+                break;
         }
+    }
+
+    //entries are ready, unpack them all at once
+    if(jobs == 1)
+        freeExtractState(&st);
+    else
+        extractParallel(&ex, entries, count, jobs, report);
+    if(!quietOutput)
+        stopProgress();
+
+    for(fileid = 0; fileid < count && statsEnabled; fileid++)
+    {
+        SdcEntry *entry = &entries[fileid];
+        statEntry(sdcFile, entry->name, entry->compressedSize, entry->fileSize, entry->status, &entry->stats);
+    }
 
-        //memory cleanup
-        free(outFile);
-        outFile = NULL;
-        //free(sdcDir);//FIXME: SIGABRT
-        sdcDir = NULL;
-        free(dirName);
-        dirName = NULL;
-
-        //ensure we are after header
-        int r;
-        if((r = fseek(in,filestart,SEEK_SET))!=0)
-            return r;
-
-        //create inflate struct
-        z_stream stream;
-        stream.next_in = Z_NULL;
-        stream.avail_in = 0;
-        stream.zalloc = Z_NULL;
-        stream.zfree = Z_NULL;
-        stream.opaque = Z_NULL;
-
-        //initialize stream
-        r = (int)-1;
-        if(header->headerSignature == SIG_ELARGE)
-            r = inflateInit(&stream);
+    //state is kept until every entry is unpacked
+    if(resume != NULL)
+    {
+        int complete = 1;
+        for(fileid = 0; fileid < count; fileid++)
+            complete &= entries[fileid].status == EX_OK;
+        if(complete)
+            unlink(resume->path);
         else
-            r = inflateInit2_(&stream,-15,ZLIB_VERSION,(int)sizeof(z_stream));
-        if(r != Z_OK)
+            saveResume(resume);
+        freeResume(resume);
+        resume = NULL;
+    }
+
+    //entries are handed out in order and stop at first failure, so everything
+    //before first failed entry was verified
+    for(fileid = 0; fileid < count && (flags & F_VERIFY); fileid++)
+    {
+        SdcEntry *entry = &entries[fileid];
+        if(entry->status != EX_OK)
         {
-            print_fail();
-            fprintf(stderr,"inflateInit failed with errorcode %d (%s)\n",r,stream.msg);
-            return r;
+            fprintf(stderr, "%s: %s: First failing entry is #%u '%s' at offset %lld (0x%llX)\n", progName,
+                    sdcFile, fileid, entry->name, (long long)entry->offset, (unsigned long long)entry->offset);
+            break;
         }
-        //read from file
-        unsigned int bytesToRead;
-        if(header->headerSignature == SIG_ELARGE)
+    }
+
+    //entries after fatal failure were never handed out, they are not counted as done
+    uint32_t pending = 0;
+    for(fileid = 0; fileid < count; fileid++)
+        pending += entries[fileid].status == EX_PENDING;
+    if(pending != 0)
+        fprintf(stderr, "%s: %s: %u entries not started after failure\n", progName, sdcFile, pending);
+
+    for(fileid = 0; fileid < count; fileid++)
+    {
+        SdcEntry *entry = &entries[fileid];
+        if(entry->status == EX_EOF)
+            status = 1;
+        else if(entry->status != EX_OK)
         {
-            bytesToRead = current->file4gb.compressedSize & 0x3fff;
+            //parts of other entries are not left behind, as with wrong checksum
+            if(onePass)
+                finishOutputs(entries, count, flags & F_FORCE);
+            //errors of entries are errno or zlib codes, none of them is exit status
+            result = EXIT_ENTRY;
+            goto out;
         }
+    }
+
+    if(flags & F_ONEPASS)
+    {
+        print_status("Checking file integrity");
+
+        //merge crc of every entry, reading only bytes no worker has read;
+        //stream was checksummed as read, only its tail is left
+        if(flags & F_STREAM)
+            crc = drainStream(in);
         else
+            crc = combineEntryCrc(in, entries, count, headerSize + 4);
+        if(pristine != NULL)
+            storeIndex(indexFile, &indexId, pristine, headerSize, 1, crc, flags);
+        if(flags & F_VERBOSE)
+            fprintf(stderr, "%s: crc32: 0x%08lX; orig: 0x%08X\n", progName, crc, unpackData.checksum);
+
+        int valid = (crc == unpackData.checksum);
+        if(valid)
         {
-            bytesToRead = current->file.compressedSize & 0x3fff;
+            print_ok();
         }
-        unsigned char *input = (unsigned char*)malloc(bytesToRead);
-        unsigned char *output = (unsigned char*)malloc(0x4000);
-        void *tmp = malloc(bytesToRead);
-
-        //determine file size
-        unsigned int bytesRemaining = 0;
-        if(header->headerSignature == SIG_ELARGE)
-            bytesRemaining = current->file4gb.fileSize;
         else
-            bytesRemaining = current->file.fileSize;
-        double fileSize = bytesRemaining, remaining;
-        uint8_t progress = 0;
+        {
+            print_fail();
+            fprintf(
+                stderr, "%s: CRC32 of sdc file did not match the one supplied in keyfile (0x%04X expected while have 0x%04lX)\n",
+                progName, unpackData.checksum, crc
+            );
+        }
 
-        if(flags & F_VERBOSE)
-            fprintf(stderr,"file size has been set as %u (0x%04X), signature: 0x%02X\n",bytesRemaining,bytesRemaining,header->headerSignature);
+        //publish unpacked files or throw them away
+        if(onePass)
+            finishOutputs(entries, count, valid || (flags & F_FORCE));
 
-        while(bytesRemaining != 0)
+        if(!valid && ! (flags & F_FORCE))
         {
-            // check progress
-            remaining = bytesRemaining;
-            if((((fileSize - remaining) / fileSize) * 6) > progress)
-            {
-                ++progress;
-                print_progress(progress);
-            }
+            result = EXIT_CHECKSUM;
+            goto out;
+        }
+    }
+
+    //directories are kept open, other containers of batch need descriptors
+    freeDirTree(&tree);
+
+    //points of verified container are kept for next runs
+    if(points != NULL)
+    {
+        int result = 0;
+        if(!points->loaded && points->header.count != 0 && status == 0)
+            result = saveSeekIndex(points, pointsFile);
+        if(result != 0)
+            fprintf(stderr, "%s: %s: %s\n", progName, pointsFile, strerror(result));
+        else if(!points->loaded && points->header.count != 0 && (flags & F_VERBOSE))
+            fprintf(stderr, "%s: %u seek points saved to %s\n", progName, points->header.count, pointsFile);
+        freeSeekIndex(points);
+        points = NULL;
+    }
+    result = status ? status : missing;
+
+out:
+    freeDirTree(&tree);
+    free(entries);
+    free(pristine);
+    if(points != NULL)
+        freeSeekIndex(points);
+    free(pointsFile);
+    if(resume != NULL)
+        freeResume(resume);
+    free(sdcCopy);
+    free(header);
+    free(indexFile);
+    free(unpackData.unformatted);
+    return result;
+}
+
+/*
+ * unpack container at SDCFILE next to it, using set->key or content of SDCFILE.key
+ * if it is NULL; returns exit status of unpacking
+ */
+static int unpackSdc(const char *sdcFile, Settings *set)
+{
+    uint32_t flags = set->flags;
+    int jobs = set->jobs;
+    if(flags & F_STREAM)
+    {
+        //stream cannot be read twice nor by several threads at once
+        flags |= F_ONEPASS;
+        jobs = 1;
+    }
+    else if(flags & F_SELECT)
+    {
+        //checksum covers whole data area, only stream reads it anyway
+        flags &= ~F_ONEPASS;
+    }
+    else if(flags & F_VERIFY)
+    {
+        //verified entries are checksummed as they are read, container is read once
+        flags |= F_ONEPASS;
+    }
+    if(flags & F_VERIFY)
+    {
+        //there is no write stage to overlap with
+        flags &= ~F_PIPELINE;
+    }
+    if(flags & (F_STREAM | F_VERIFY | F_LIST))
+    {
+        //stream cannot be read again from checkpoint, the others write nothing
+        flags &= ~F_RESUME;
+    }
+    else if(flags & F_RESUME)
+    {
+        //files are written under final names right away, checksum is counted first
+        flags &= ~F_ONEPASS;
+    }
+    if(flags & (F_STREAM | F_LIST))
+    {
+        //segments are read out of order, listing inflates nothing
+        flags &= ~F_POINTS;
+    }
+    if(flags & F_LIST)
+    {
+        //stdout carries listing only
+        quietOutput = 1;
+    }
+
+    print_status("Opening SDC file");
+    int result;
+    SdcInput in;
+    if(flags & F_STREAM)
+        result = openStream(&in, sdcFile);
+    else
+    {
+        //io_uring reads what is not mapped
+        result = openInput(&in, sdcFile, (flags & F_NOMMAP) || set->ioDepth != 0);
+        in.ioDepth = set->ioDepth;
+    }
+    if(result != 0)
+    {
+        //error opening a file
+        print_fail();
+        errno = result;
+        perror(sdcFile);
+        return result;
+    }
+    print_ok();
+
+    result = unpackInput(&in, sdcFile, flags, jobs, set);
+    closeInput(&in);
+    return result;
+}
+
+/*
+ * estimate memory needed while ITEM is unpacked with SET and store size of ITEM
+ */
+static size_t estimateMemory(BatchItem *item, Settings *set)
+{
+    //inflate window and state, input and write buffers, buffers of whole entries
+    size_t memory = 0x10000 + 0x4000 + OUTPUT_BUFFER + 2 * INFLATE_WHOLE_MAX;
+    if(set->flags & F_PIPELINE)
+        memory += 2 * (size_t)set->queueDepth * set->chunkSize;
+    memory += 2 * (size_t)set->ioDepth * IORING_BLOCK;
+
+    struct stat st;
+    if(stat(item->path, &st) != 0 || !S_ISREG(st.st_mode))
+        return memory;
+    item->size = st.st_size;
+
+    //decrypted header and entries built from it
+    uint32_t headerSize = 0;
+    FILE *sdc = fopen(item->path, "r");
+    if(sdc != NULL)
+    {
+        if(fread(&headerSize, 4, 1, sdc) == 1)
+            memory += 3 * (size_t)headerSize;
+        fclose(sdc);
+    }
+    return memory;
+}
+
+/*
+ * unpack one container of batch, called on worker thread
+ */
+static int unpackItem(BatchItem *item, void *arg)
+{
+    Settings set = *(Settings*)arg;
+    if(item->key != NULL)
+        set.key = item->key;
+
+    //status lines of several workers would mix up
+    quietOutput = (set.flags & F_QUIET) != 0;
+    return unpackSdc(item->path, &set);
+}
+
+/*
+ * print result of unpacking ITEM, called by one thread at a time
+ */
+static void reportItem(BatchItem *item)
+{
+    if(item->status == 0)
+        printf(" [  OK  ] %s\n", item->path);
+    else
+        printf(" [ FAIL ] %s (exit status %d)\n", item->path, item->status);
+    fflush(stdout);
+}
+
+/*
+ * unpack COUNT ITEMS on WORKERS threads keeping their estimated memory under
+ * BUDGET bytes (0 for no limit), returns EXIT_BATCH if any of them failed
+ */
+static int unpackBatch(BatchItem *items, uint32_t count, int workers, size_t budget, Settings *set)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    //containers are the unit of work, their entries are unpacked serially
+    Settings batch = *set;
+    batch.jobs = 1;
+    batch.flags |= F_BATCH;
+    if(workers > 1 && count > 1)
+        batch.flags |= F_QUIET;
+    uint32_t i;
+    off_t total = 0;
+    for(i = 0; i < count; i++)
+    {
+        items[i].memory = estimateMemory(&items[i], &batch);
+        total += items[i].size;
+    }
+
+    uint32_t failed = runBatch(items, count, workers, budget, unpackItem, &batch, reportItem);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%u containers: %u unpacked, %u failed, %.1f MiB in %.2f s (%.1f MiB/s)\n",
+           count, count - failed, failed, total / 1048576.0, seconds,
+           seconds > 0 ? total / 1048576.0 / seconds : 0.0);
+    return failed ? EXIT_BATCH : EXIT_SUCCESS;
+}
+
+/*
+ * write collected counters in FORMAT to file at PATH (stderr if NULL), run started at START
+ */
+static void writeStats(StatFormat format, const char *path, const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) / 1e9;
+    FILE *out = path ? fopen(path, "w") : stderr;
+    if(out == NULL)
+    {
+        perror(path);
+        return;
+    }
+    printStats(out, format, seconds);
+    if(out != stderr)
+        fclose(out);
+}
 
-            result = fread(input+stream.avail_in,1,bytesToRead-stream.avail_in,in);
-            if(result == 0 && stream.avail_in == 0)	//stop only if stream iflated whole previous buffer
-                return 1;				//still have bytes remaining but container end reached
-
-            //decode
-            stream.next_in = (Bytef*)input;
-            stream.avail_in += result;
-            stream.next_out = (Bytef*)output;
-            stream.avail_out = 0x4000;
-            stream.total_in = 0;
-            stream.total_out = 0;
-            r = inflate(&stream,0);
-            if(r < Z_OK)
+int main(int argc, char **argv)
+{
+    //TODO: get rid of mem leaks (valgrind)
+    uint32_t flags = 0;
+    int jobs = 1;
+    size_t crcSlice = CRC_SLICE;
+    uint32_t queueDepth = PIPELINE_DEPTH;
+    size_t chunkSize = PIPELINE_CHUNK;
+    size_t memoryBudget = 0;
+    progName = argv[0];
+    initKernels();
+    const char *sdcFile = NULL;
+    const char *keyString = NULL;
+    const char *keyringFile = NULL;
+    const char *manifest = NULL;
+    char **patterns = NULL;
+    uint32_t patternCount = 0;
+    const char *indexDir = NULL;
+    uint64_t checkpointInterval = RESUME_INTERVAL;
+    uint64_t seekSpan = SEEKINDEX_SPAN;
+    uint32_t ioDepth = 0;
+    int progress = progressMode("auto");
+    FILE *hdrout = NULL;
+    StatFormat statFormat = SF_TEXT;
+    const char *statFile = NULL;
+    struct timespec startTime;
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    int option;
+    while((option = getopt_long(argc, argv, "fvH:1Mj:S:pQ:C:sk:K:m:B:Dlx:tI::Z:rR:P::U::G:T::O:Vh", options, 0)) != -1)
+    {
+        switch(option)
+        {
+        case '?':
+            return EXIT_INVALIDOPT;
+        //force
+        case 'f':
+            flags |= F_FORCE;
+            break;
+        //verbose
+        case 'v':
+            flags |= F_VERBOSE;
+            break;
+        //header output
+        case 'H':
+            print_status("Opening header sink");
+            flags |= F_HEADEROUT;
+            hdrout = fopen(optarg, "w");
+            if(hdrout == NULL)
             {
+                //error opening a file
                 print_fail();
-                fprintf(stderr,"inflate failed with errorcode %d (%s)\n",r,stream.msg);
-                return r;
+                perror(hdrout);
+                return errno;
             }
-
-            //XOR
-            xorBuffer(unpackData.xorVal % 0x100, output, stream.total_out);
-
-            //write to file
-            fwrite(output,1,stream.total_out,out);
-            bytesRemaining -= stream.total_out;
-
-            /*
-            * tricky part: input buffer hadn't been fully decompressed
-            * so we need to copy the rest to TMP and then at the beginning
-            * of input buffer so it can be inflated, but before that we need to
-            * read the rest of a chunk so its size would be COMPRESSEDSIZE
-            */
-            memcpy(tmp,stream.next_in,stream.avail_in);
-            memcpy(input,tmp,stream.avail_in);
+            print_ok();
+            break;
+        //single pass
+        case '1':
+            flags |= F_ONEPASS;
+            break;
+        //number of worker threads
+        case 'j':
+            jobs = atoi(optarg);
+            if(jobs < 1)
+            {
+                print_help(PH_SHORT,argv[0]);
+                return EXIT_INVALIDOPT;
+            }
+            break;
+        //size of crc slice in MiB
+        case 'S':
+            crcSlice = (size_t)atoi(optarg) << 20;
+            if(crcSlice == 0)
+            {
+                print_help(PH_SHORT,argv[0]);
+                return EXIT_INVALIDOPT;
+            }
+            break;
+        //pipelined unpacking
+        case 'p':
+            flags |= F_PIPELINE;
+            break;
+        case 'Q':
+            queueDepth = atoi(optarg);
+            if(queueDepth == 0)
+            {
+                print_help(PH_SHORT,argv[0]);
+                return EXIT_INVALIDOPT;
+            }
+            break;
+        case 'C':
+            chunkSize = (size_t)atoi(optarg) << 10;
+            if(chunkSize == 0)
+            {
+                print_help(PH_SHORT,argv[0]);
+                return EXIT_INVALIDOPT;
+            }
+            break;
+        //sequential reading from pipe or stdin
+        case 's':
+            flags |= F_STREAM;
+            break;
+        //key given on command line instead of key file
+        case 'k':
+            keyString = optarg;
+            break;
+        //keys of many containers, found by checksum
+        case 'K':
+            keyringFile = optarg;
+            break;
+        //list of containers to unpack
+        case 'm':
+            manifest = optarg;
+            break;
+        //memory all containers of batch may use at once, in MiB
+        case 'B':
+            memoryBudget = (size_t)atoi(optarg) << 20;
+            if(memoryBudget == 0)
+            {
+                print_help(PH_SHORT,argv[0]);
+                return EXIT_INVALIDOPT;
+            }
+            break;
+        //print entries instead of unpacking them
+        case 'l':
+            flags |= F_LIST;
+            break;
+        //unpack only entries matching glob, may be given many times
+        case 'x':
+            flags |= F_SELECT;
+            patterns = (char**)realloc(patterns, sizeof(char*) * (patternCount + 1));
+            patterns[patternCount++] = optarg;
+            break;
+        //decompressor used for whole entries
+        case 'Z':
+            if(selectInflateBackend(optarg) != 0)
+            {
+                fprintf(stderr, "%s: Unknown inflate backend '%s', available:", argv[0], optarg);
+                int i;
+                for(i = 0; inflateBackendAt(i) != NULL; i++)
+                    fprintf(stderr, " %s", inflateBackendAt(i));
+                fprintf(stderr, "\n");
+                return EXIT_INVALIDOPT;
+            }
+            break;
+        //verify without writing anything
+        case 't':
+            flags |= F_VERIFY;
+            entryAction = "Testing";
+            break;
+        //cache of decrypted headers and checksums
+        case 'I':
+            flags |= F_INDEX;
+            indexDir = optarg;
+            break;
+        //continue interrupted unpacking
+        case 'r':
+            flags |= F_RESUME;
+            break;
+        //output between checkpoints in MiB
+        case 'R':
+            checkpointInterval = (uint64_t)atoi(optarg) << 20;
+            if(checkpointInterval == 0)
+            {
+                print_help(PH_SHORT,argv[0]);
+                return EXIT_INVALIDOPT;
+            }
+            break;
+        //seek points, optionally every MiB
+        case 'P':
+            flags |= F_POINTS;
+            if(optarg != NULL && (seekSpan = (uint64_t)atoi(optarg) << 20) == 0)
+            {
+                print_help(PH_SHORT,argv[0]);
+                return EXIT_INVALIDOPT;
+            }
+            break;
+        case 'U':
+            ioDepth = optarg != NULL ? atoi(optarg) : IORING_DEPTH;
+            if(ioDepth == 0 || ioDepth > 1024)
+            {
+                print_help(PH_SHORT,argv[0]);
+                return EXIT_INVALIDOPT;
+            }
+            break;
+        //progress shown while checksumming and unpacking
+        case 'G':
+            if((progress = progressMode(optarg)) < 0)
+            {
+                print_help(PH_SHORT,argv[0]);
+                return EXIT_INVALIDOPT;
+            }
+            break;
+        //performance counters
+        case 'T':
+            if(optarg == NULL || strcmp(optarg, "text") == 0)
+                statFormat = SF_TEXT;
+            else if(strcmp(optarg, "json") == 0)
+                statFormat = SF_JSON;
+            else
+            {
+                print_help(PH_SHORT,argv[0]);
+                return EXIT_INVALIDOPT;
+            }
+            enableStats();
+            break;
+        case 'O':
+            statFile = optarg;
+            break;
+        //bypass page cache when writing
+        case 'D':
+            flags |= F_DIRECT;
+            break;
+        //stdio instead of mmap
+        case 'M':
+            flags |= F_NOMMAP;
+            break;
+        //version
+        case 'V':
+            print_version();
+            return EXIT_SUCCESS;
+        //help
+        case 'h':
+            print_help(PH_LONG,argv[0]);
+            return EXIT_SUCCESS;
+            break;
+        default:
+            print_help(PH_SHORT,argv[0]);
+            return EXIT_INVALIDOPT;
         }
+    }
+    if(flags & F_VERBOSE)
+        fprintf(stderr, "%s: using %s kernels, %s inflate\n", argv[0], kernelName(), inflateBackendName());
 
-        if(bytesRemaining != 0)
+    //kernel may lack io_uring or forbid it, then blocking I/O is used
+    IoRing probe;
+    int ringError = 0;
+    if(ioDepth != 0 && (ringError = initRing(&probe, 1)) != 0)
+    {
+        fprintf(stderr, "%s: io_uring not available (%s), using blocking I/O\n", argv[0], strerror(ringError));
+        ioDepth = 0;
+    }
+    else if(ioDepth != 0)
+    {
+        if(flags & F_VERBOSE)
+            fprintf(stderr, "%s: io_uring with %u reads and writes queued, %sregistered buffers\n", argv[0], ioDepth,
+                    probe.registered ? "" : "no ");
+        freeRing(&probe);
+    }
+
+    Keyring keyring;
+    if(keyringFile != NULL)
+    {
+        int error = loadKeyring(&keyring, keyringFile);
+        if(error != 0)
         {
-            print_fail();
-            fprintf(stderr, "%s: Unexpected end of file!\n", argv[0]);
+            errno = error;
+            perror(keyringFile);
+            return error;
         }
-        else
-            print_ok();
-
-        fclose(out);
-        free(tmp);
-        tmp = NULL;
-        free(input);
-        input = NULL;
-        free(output);
-        output = NULL;
-
-        if(header->headerSignature == SIG_ELARGE)
-            filestart += current->file4gb.compressedSize;
-        else
-            filestart += current->file.compressedSize;
-        current++;
+        if(keyring.rejected != 0)
+            fprintf(stderr, "%s: %s: skipped %u lines that are not keys\n", argv[0], keyringFile, keyring.rejected);
+        if(flags & F_VERBOSE)
+            fprintf(stderr, "%s: %u keys taken from %s\n", argv[0], keyring.count, keyringFile);
     }
 
-    free(unpackData.unformatted);
-    unpackData.unformatted = NULL;
-    unpackData.fileNameKey = NULL;
-    unpackData.headerKey = NULL;
+    Settings set;
+    set.flags = flags;
+    set.jobs = jobs;
+    set.crcSlice = crcSlice;
+    set.queueDepth = queueDepth;
+    set.chunkSize = chunkSize;
+    set.hdrout = hdrout;
+    set.key = keyString;
+    set.patterns = patterns;
+    set.patternCount = patternCount;
+    set.indexDir = indexDir;
+    set.checkpointInterval = checkpointInterval;
+    set.seekSpan = seekSpan;
+    set.ioDepth = ioDepth;
+    set.progress = (ProgressMode)progress;
+    set.keyring = keyringFile != NULL ? &keyring : NULL;
 
-    free(header);
+    if(manifest != NULL || (argc - optind) > 1)
+    {
+        //many containers, each one is unpacked by one of JOBS workers
+        BatchItem *items = NULL;
+        uint32_t count = 0;
+        for(; optind < argc; optind++)
+            addBatchItem(&items, &count, argv[optind], NULL);
+        int result;
+        if(manifest != NULL && (result = loadManifest(&items, &count, manifest)) != 0)
+        {
+            errno = result;
+            perror(manifest);
+            freeBatchItems(items, count);
+            return result;
+        }
+        if(count == 0 || (flags & F_HEADEROUT))
+        {
+            //there is only one header sink
+            freeBatchItems(items, count);
+            print_help(PH_SHORT,argv[0]);
+            return EXIT_INVALIDOPT;
+        }
+        result = unpackBatch(items, count, jobs, memoryBudget, &set);
+        freeBatchItems(items, count);
+        free(patterns);
+        if(keyringFile != NULL)
+            freeKeyring(&keyring);
+        if(statsEnabled)
+            writeStats(statFormat, statFile, &startTime);
+        return result;
+    }
 
-    fclose(in);
-    return 0;
+    if((argc - optind) == 1)
+    {
+        //parsing argv successful
+        sdcFile = argv[optind];
+        if(strcmp(sdcFile, "-") == 0)
+            flags |= F_STREAM;
+    }
+    else if((argc - optind) == 0 && (flags & F_STREAM))
+    {
+        //stream from stdin
+        sdcFile = "-";
+    }
+    else
+    {
+        print_help(PH_SHORT,argv[0]);
+        return EXIT_TOOLESS;
+    }
+
+    set.flags = flags;
+    int result = unpackSdc(sdcFile, &set);
+    free(patterns);
+    if(keyringFile != NULL)
+        freeKeyring(&keyring);
+    if(statsEnabled)
+        writeStats(statFormat, statFile, &startTime);
+    return result;
 }
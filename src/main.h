@@ -1,12 +1,18 @@
-#define _FILE_OFFSET_BITS 64
-
 #include "xsdc.h"
+#include "extract.h"
+#include "pipeline.h"
+#include "batch.h"
+#include "index.h"
+#include "resume.h"
+#include "dirtree.h"
+#include "keyring.h"
 
 #include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <getopt.h>
+#include <unistd.h>
 #include <errno.h>
 #include <libgen.h>
 #include <sys/stat.h>
@@ -17,17 +23,80 @@
 #define F_VERBOSE   0x01
 #define F_FORCE     0x02
 #define F_HEADEROUT 0x04
+#define F_ONEPASS   0x08
+#define F_NOMMAP    0x10
+#define F_PIPELINE  0x20
+#define F_STREAM    0x40
+#define F_QUIET     0x80
+#define F_DIRECT    0x100
+#define F_LIST      0x200
+#define F_SELECT    0x400	//unpack only entries matching patterns
+#define F_BATCH     0x800	//container is one of many
+#define F_INDEX     0x1000	//reuse and update index of container
+#define F_VERIFY    0x2000	//verify entries without writing them
+#define F_RESUME    0x4000	//continue unpacking interrupted earlier, take checkpoints
+#define F_POINTS    0x8000	//record seek points of large entries or unpack them in segments
+
+//suffix of files unpacked in single-pass mode until checksum is verified
+#define PART_SUFFIX ".part"
 
 //return values
 #define EXIT_SUCCESS    0
 #define EXIT_INVALIDOPT 1
 #define EXIT_TOOLESS    2
+#define EXIT_BATCH      3	//some containers of batch failed
+#define EXIT_CHECKSUM   4	//checksum of data area does not match the key
+#define EXIT_ENTRY      5	//entry could not be unpacked (damaged data, write failed)
+
+typedef struct settings_t
+{
+  uint32_t      flags;	//F_* flags
+  int           jobs;	//threads unpacking one container
+  size_t        crcSlice;
+  uint32_t      queueDepth;
+  size_t        chunkSize;
+  FILE          *hdrout;	//sink of decrypted header, NULL for none
+  const char    *key;	//key string, NULL to read it from container's key file
+  char          **patterns;	//globs selecting entries to unpack
+  uint32_t      patternCount;
+  const char    *indexDir;	//directory of indexes, NULL to keep them next to containers
+  uint64_t      checkpointInterval;	//output between resume checkpoints
+  uint64_t      seekSpan;	//output between seek points
+  uint32_t      ioDepth;	//reads and writes queued on io_uring, 0 for blocking I/O
+  ProgressMode  progress;	//how progress of checksum and unpacking is shown
+  const Keyring *keyring;	//keys found by checksum of data area, NULL for key files
+} Settings;
 
 static struct option options [] =
 {
   {"force",   no_argument,       NULL, 'f'},
   {"verbose", no_argument,       NULL, 'v'},
   {"header",  required_argument, NULL, 'H'},
+  {"single-pass", no_argument,   NULL, '1'},
+  {"no-mmap", no_argument,       NULL, 'M'},
+  {"jobs",    required_argument, NULL, 'j'},
+  {"crc-slice", required_argument, NULL, 'S'},
+  {"pipeline", no_argument,      NULL, 'p'},
+  {"queue-depth", required_argument, NULL, 'Q'},
+  {"chunk-size", required_argument, NULL, 'C'},
+  {"stream",  no_argument,       NULL, 's'},
+  {"key",     required_argument, NULL, 'k'},
+  {"keyring", required_argument, NULL, 'K'},
+  {"manifest", required_argument, NULL, 'm'},
+  {"memory-budget", required_argument, NULL, 'B'},
+  {"direct",  no_argument,       NULL, 'D'},
+  {"list",    no_argument,       NULL, 'l'},
+  {"extract", required_argument, NULL, 'x'},
+  {"test",    no_argument,       NULL, 't'},
+  {"index",   optional_argument, NULL, 'I'},
+  {"inflate", required_argument, NULL, 'Z'},
+  {"resume",  no_argument,       NULL, 'r'},
+  {"checkpoint", required_argument, NULL, 'R'},
+  {"seek-points", optional_argument, NULL, 'P'},
+  {"io-uring", optional_argument, NULL, 'U'},
+  {"progress", required_argument, NULL, 'G'},
+  {"stats",   optional_argument, NULL, 'T'},
+  {"stats-file", required_argument, NULL, 'O'},
   {"version", no_argument,       NULL, 'V'},
   {"help",    no_argument,       NULL, 'h'},
   {0, 0, 0, 0}
@@ -0,0 +1,423 @@
+#define FUSE_USE_VERSION 31
+
+#include <fuse.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "libxsdm.h"
+#include "blockcache.h"
+
+//defaults of --cache and --span, MiB
+#define MOUNT_CACHE 64
+#define MOUNT_SPAN 8
+
+typedef struct mountnode_t
+{
+  char          *name;	//last component of path, points into its entry name
+  int64_t       entry;	//index in container, -1 for directory
+  struct mountnode_t *children;	//first of them, directories only
+  struct mountnode_t *next;	//sibling
+} MountNode;
+
+typedef struct mountstate_t
+{
+  XsdmArchive   *archive;
+  MountNode     root;
+  char          **paths;	//copy of every entry name, nodes are cut out of them
+  XsdmReader    **readers;	//of every entry, open while it is
+  uint32_t      *opens;	//open handles of every entry
+  BlockCache    cache;
+  time_t        mountTime;	//of directories, container has no entries for them
+  pthread_mutex_t lock;	//one at a time decompresses or touches cache
+} MountState;
+
+typedef struct mountoptions_t
+{
+  char          *key;
+  unsigned      cache;
+  unsigned      span;
+  int           help;
+  char          *sdcFile;
+} MountOptions;
+
+enum
+{
+  MO_HELP = 0
+};
+
+static const struct fuse_opt mountOptions[] =
+{
+  {"-k %s",     offsetof(MountOptions, key), 0},
+  {"--key=%s",  offsetof(MountOptions, key), 0},
+  {"--cache=%u", offsetof(MountOptions, cache), 0},
+  {"--span=%u", offsetof(MountOptions, span), 0},
+  FUSE_OPT_KEY("-h", MO_HELP),
+  FUSE_OPT_KEY("--help", MO_HELP),
+  FUSE_OPT_END
+};
+
+static void printMountHelp(const char *name)
+{
+    printf(
+        "Usage: %s [OPTIONS] SDC-FILE MOUNTPOINT\n"
+        "Mount SDC-FILE read-only at MOUNTPOINT, unpacking entries as they are read\n"
+        "OPTIONS can be one or more of the following\n"
+        "\t-k, --key=KEY\t\tkey string instead of content of SDC-FILE.key\n"
+        "\t--cache=MIB\t\tmemory for unpacked blocks (default: %u)\n"
+        "\t--span=MIB\t\tseek point every MIB of entry (default: %u, 0 for none)\n"
+        "\t-h, --help\t\tdisplay this help and exit\n\n",
+        name, MOUNT_CACHE, MOUNT_SPAN);
+}
+
+static int parseOption(void *data, const char *arg, int key, struct fuse_args *outargs)
+{
+    MountOptions *mo = (MountOptions*)data;
+    if(key == MO_HELP)
+    {
+        mo->help = 1;
+        return 0;
+    }
+
+    //first non-option is container, mountpoint goes to fuse
+    if(key == FUSE_OPT_KEY_NONOPT && mo->sdcFile == NULL)
+    {
+        mo->sdcFile = strdup(arg);
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * return content of key file of SDCFILE or NULL
+ */
+static char *readKeyFile(const char *sdcFile)
+{
+    char *keyFileName = (char*)malloc(strlen(sdcFile) + 5);
+    sprintf(keyFileName, "%s.key", sdcFile);
+    FILE *f = fopen(keyFileName, "r");
+    if(f == NULL)
+    {
+        perror(keyFileName);
+        free(keyFileName);
+        return NULL;
+    }
+    free(keyFileName);
+
+    fseek(f, 0, SEEK_END);
+    long length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    char *key = (char*)malloc(length + 1);
+    if(key != NULL)
+        key[fread(key, 1, length, f)] = '\0';
+    fclose(f);
+    return key;
+}
+
+/*
+ * return child of DIR named NAME (LENGTH bytes) or NULL
+ */
+static MountNode *findChild(MountNode *dir, const char *name, size_t length)
+{
+    MountNode *n;
+    for(n = dir->children; n != NULL; n = n->next)
+    {
+        if(strncmp(n->name, name, length) == 0 && n->name[length] == '\0')
+            return n;
+    }
+    return NULL;
+}
+
+/*
+ * add entry INDEX named PATH (modified) to tree of MS, creating its directories;
+ * returns 0 or errno
+ */
+static int addNode(MountState *ms, uint32_t index, char *path)
+{
+    MountNode *dir = &ms->root;
+    char *name = path;
+    while(1)
+    {
+        while(*name == '/')
+            name++;
+        char *end = strchr(name, '/');
+        if(end == NULL && *name == '\0')
+            return EINVAL;
+
+        MountNode *n = findChild(dir, name, end ? (size_t)(end - name) : strlen(name));
+        if(n != NULL && (end == NULL || n->entry >= 0))
+        {
+            //same name twice or file where directory is, first one wins
+            fprintf(stderr, "Entry %u duplicates path of another one, ignored\n", index);
+            return 0;
+        }
+        if(n == NULL)
+        {
+            n = (MountNode*)calloc(1, sizeof(MountNode));
+            if(n == NULL)
+                return ENOMEM;
+            n->name = name;
+            n->entry = end ? -1 : index;
+            n->next = dir->children;
+            dir->children = n;
+        }
+        if(end == NULL)
+            return 0;
+        *end = '\0';
+        dir = n;
+        name = end + 1;
+    }
+}
+
+static void freeNodes(MountNode *n)
+{
+    while(n != NULL)
+    {
+        MountNode *next = n->next;
+        freeNodes(n->children);
+        free(n);
+        n = next;
+    }
+}
+
+static MountNode *findNode(MountState *ms, const char *path)
+{
+    MountNode *n = &ms->root;
+    while(n != NULL)
+    {
+        while(*path == '/')
+            path++;
+        if(*path == '\0')
+            return n;
+        const char *end = strchr(path, '/');
+        size_t length = end ? (size_t)(end - path) : strlen(path);
+        n = n->entry < 0 ? findChild(n, path, length) : NULL;
+        path += length;
+    }
+    return NULL;
+}
+
+static MountState *mountState()
+{
+    return (MountState*)fuse_get_context()->private_data;
+}
+
+static void *mountInit(struct fuse_conn_info *conn, struct fuse_config *cfg)
+{
+    //container is read-only, so are pages of its files
+    cfg->kernel_cache = 1;
+    return mountState();
+}
+
+static int mountGetattr(const char *path, struct stat *st, struct fuse_file_info *fi)
+{
+    MountState *ms = mountState();
+    MountNode *n = findNode(ms, path);
+    if(n == NULL)
+        return -ENOENT;
+
+    memset(st, 0, sizeof(struct stat));
+    if(n->entry < 0)
+    {
+        st->st_mode = S_IFDIR | 0555;
+        st->st_nlink = 2;
+        st->st_atime = st->st_mtime = st->st_ctime = ms->mountTime;
+        return 0;
+    }
+
+    XsdmEntryInfo info;
+    xsdmEntryInfo(ms->archive, n->entry, &info);
+    st->st_mode = S_IFREG | 0444;
+    st->st_nlink = 1;
+    st->st_size = info.size;
+    st->st_blocks = (info.size + 511) / 512;
+    st->st_atime = info.accessTime;
+    st->st_mtime = info.modificationTime;
+    st->st_ctime = info.creationTime;
+    return 0;
+}
+
+static int mountReaddir(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset,
+                        struct fuse_file_info *fi, enum fuse_readdir_flags flags)
+{
+    MountNode *n = findNode(mountState(), path);
+    if(n == NULL)
+        return -ENOENT;
+    if(n->entry >= 0)
+        return -ENOTDIR;
+
+    filler(buf, ".", NULL, 0, 0);
+    filler(buf, "..", NULL, 0, 0);
+    for(n = n->children; n != NULL; n = n->next)
+        filler(buf, n->name, NULL, 0, 0);
+    return 0;
+}
+
+static int mountOpen(const char *path, struct fuse_file_info *fi)
+{
+    MountState *ms = mountState();
+    MountNode *n = findNode(ms, path);
+    if(n == NULL)
+        return -ENOENT;
+    if(n->entry < 0)
+        return -EISDIR;
+    if((fi->flags & O_ACCMODE) != O_RDONLY)
+        return -EROFS;
+
+    //reader is opened lazily and shared by all handles of entry
+    int error = 0;
+    pthread_mutex_lock(&ms->lock);
+    if(ms->readers[n->entry] == NULL)
+        error = xsdmOpenEntry(ms->archive, n->entry, &ms->readers[n->entry]);
+    if(error == 0)
+        ms->opens[n->entry]++;
+    pthread_mutex_unlock(&ms->lock);
+    fi->fh = n->entry;
+    fi->keep_cache = 1;
+    return -error;
+}
+
+static int mountRead(const char *path, char *buf, size_t size, off_t offset, struct fuse_file_info *fi)
+{
+    MountState *ms = mountState();
+    XsdmEntryInfo info;
+    xsdmEntryInfo(ms->archive, fi->fh, &info);
+
+    pthread_mutex_lock(&ms->lock);
+    ssize_t bytes = readRange(&ms->cache, ms->readers[fi->fh], fi->fh, info.size, buf, size, offset);
+    pthread_mutex_unlock(&ms->lock);
+    return bytes;
+}
+
+static int mountRelease(const char *path, struct fuse_file_info *fi)
+{
+    MountState *ms = mountState();
+    pthread_mutex_lock(&ms->lock);
+    if(--ms->opens[fi->fh] == 0)
+    {
+        //cached blocks stay, seek points of entry stay with archive
+        xsdmCloseEntry(ms->readers[fi->fh]);
+        ms->readers[fi->fh] = NULL;
+    }
+    pthread_mutex_unlock(&ms->lock);
+    return 0;
+}
+
+static const struct fuse_operations mountOperations =
+{
+    .init       = mountInit,
+    .getattr    = mountGetattr,
+    .readdir    = mountReaddir,
+    .open       = mountOpen,
+    .read       = mountRead,
+    .release    = mountRelease,
+};
+
+/*
+ * open container of MO into MS and build its directory tree, returns 0 or errno
+ */
+static int loadMount(MountState *ms, MountOptions *mo)
+{
+    char *key = mo->key ? strdup(mo->key) : readKeyFile(mo->sdcFile);
+    if(key == NULL)
+        return ENOENT;
+    int error = xsdmOpenPath(&ms->archive, mo->sdcFile, key, NULL);
+    free(key);
+    if(error != 0)
+    {
+        fprintf(stderr, "%s: %s\n", mo->sdcFile, error == EINVAL ? "Wrong format of a keyfile!" : strerror(error));
+        return error;
+    }
+    xsdmSetSeekSpan(ms->archive, (uint64_t)mo->span << 20);
+
+    uint32_t count = xsdmEntryCount(ms->archive);
+    ms->paths = (char**)calloc(count + 1, sizeof(char*));
+    ms->readers = (XsdmReader**)calloc(count + 1, sizeof(XsdmReader*));
+    ms->opens = (uint32_t*)calloc(count + 1, sizeof(uint32_t));
+    if(ms->paths == NULL || ms->readers == NULL || ms->opens == NULL)
+        return ENOMEM;
+    if((error = initBlockCache(&ms->cache, BLOCK_SIZE, (uint64_t)mo->cache << 20)) != 0)
+        return error;
+
+    ms->root.entry = -1;
+    uint32_t i;
+    for(i = 0; i < count; i++)
+    {
+        XsdmEntryInfo info;
+        xsdmEntryInfo(ms->archive, i, &info);
+        if((ms->paths[i] = strdup(info.name)) == NULL)
+            return ENOMEM;
+        if((error = addNode(ms, i, ms->paths[i])) != 0)
+            return error;
+    }
+    ms->mountTime = time(NULL);
+    pthread_mutex_init(&ms->lock, NULL);
+    return 0;
+}
+
+static void freeMount(MountState *ms)
+{
+    uint32_t i, count = ms->archive ? xsdmEntryCount(ms->archive) : 0;
+    for(i = 0; i < count; i++)
+    {
+        if(ms->readers != NULL && ms->readers[i] != NULL)
+            xsdmCloseEntry(ms->readers[i]);
+        if(ms->paths != NULL)
+            free(ms->paths[i]);
+    }
+    freeNodes(ms->root.children);
+    free(ms->paths);
+    free(ms->readers);
+    free(ms->opens);
+    if(ms->cache.buckets != NULL)
+        freeBlockCache(&ms->cache);
+    xsdmClose(ms->archive);
+}
+
+int main(int argc, char *argv[])
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    MountOptions mo;
+    memset(&mo, 0, sizeof(MountOptions));
+    mo.cache = MOUNT_CACHE;
+    mo.span = MOUNT_SPAN;
+    if(fuse_opt_parse(&args, &mo, mountOptions, parseOption) != 0)
+        return 1;
+
+    if(mo.help || mo.sdcFile == NULL)
+    {
+        //fuse lists its own options after ours
+        printMountHelp(argv[0]);
+        fuse_opt_add_arg(&args, "--help");
+        args.argv[0][0] = '\0';
+        int r = fuse_main(args.argc, args.argv, &mountOperations, NULL);
+        fuse_opt_free_args(&args);
+        return mo.help ? r : 1;
+    }
+
+    MountState ms;
+    memset(&ms, 0, sizeof(MountState));
+    int error = loadMount(&ms, &mo);
+    if(error != 0)
+    {
+        freeMount(&ms);
+        fuse_opt_free_args(&args);
+        return error;
+    }
+
+    //read-only even for root
+    fuse_opt_add_arg(&args, "-oro");
+    int r = fuse_main(args.argc, args.argv, &mountOperations, &ms);
+    freeMount(&ms);
+    fuse_opt_free_args(&args);
+    free(mo.sdcFile);
+    free(mo.key);
+    return r;
+}
@@ -0,0 +1,267 @@
+#define _GNU_SOURCE
+#include "output.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+uint8_t *allocOutputBuffer(size_t capacity)
+{
+    void *buffer = NULL;
+    if(posix_memalign(&buffer, OUTPUT_ALIGN, capacity) != 0)
+        return NULL;
+    return (uint8_t*)buffer;
+}
+
+int openOutput(Output *out, const char *path, off_t size, uint8_t *buffer, size_t capacity, int direct)
+{
+    return openOutputAt(out, AT_FDCWD, path, size, buffer, capacity, direct);
+}
+
+int openOutputAt(Output *out, int dir, const char *path, off_t size, uint8_t *buffer, size_t capacity, int direct)
+{
+    out->buffer = buffer;
+    out->capacity = buffer ? capacity & ~((size_t)OUTPUT_ALIGN - 1) : 0;
+    out->fill = 0;
+    out->pos = 0;
+    out->size = 0;
+    out->direct = 0;
+    out->fd = -1;
+    out->stats = NULL;
+    out->progress = NULL;
+    out->ring = NULL;
+    if(path == NULL)
+        return 0;
+
+#ifdef O_DIRECT
+    if(direct)
+    {
+        //not every filesystem can do it (tmpfs), then page cache is used
+        out->fd = openat(dir, path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0666);
+        out->direct = out->fd != -1;
+    }
+#endif
+    if(out->fd == -1)
+        out->fd = openat(dir, path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if(out->fd == -1)
+        return errno;
+
+#ifdef HAVE_FALLOCATE
+    //reserve whole file at once so it is not fragmented, failure is harmless
+    if(size > 0 && fallocate(out->fd, 0, 0, size) == 0)
+        out->size = size;
+#endif
+    return 0;
+}
+
+int reopenOutput(Output *out, int dir, const char *path, off_t pos, uint8_t *buffer, size_t capacity)
+{
+    int result = openOutput(out, NULL, 0, buffer, capacity, 0);
+    out->fd = openat(dir, path, O_WRONLY);
+    if(out->fd == -1)
+        return errno;
+
+    //data past POS may be incomplete, it is written again
+    struct stat st;
+    if(fstat(out->fd, &st) != 0)
+        result = errno;
+    else if(st.st_size < pos)
+        result = EINVAL;
+    else if(ftruncate(out->fd, pos) != 0)
+        result = errno;
+    if(result != 0)
+    {
+        close(out->fd);
+        out->fd = -1;
+        return result;
+    }
+    out->pos = pos;
+    out->size = pos;
+    return result;
+}
+
+void shareOutput(Output *out, const Output *file, off_t pos, uint8_t *buffer, size_t capacity)
+{
+    openOutput(out, NULL, 0, buffer, capacity, 0);
+    out->fd = file->fd;
+    out->pos = pos;
+    out->size = file->size;
+}
+
+/*
+ * write LENGTH bytes of DATA at current end of OUT
+ */
+static int writeBlock(Output *out, const uint8_t *data, size_t length)
+{
+    if(out->fd == -1)
+    {
+        //discard sink
+        out->pos += length;
+        progressAdd(out->progress, length);
+        return 0;
+    }
+#ifdef O_DIRECT
+    if(out->direct && (((uintptr_t)data | length | (size_t)out->pos) & (OUTPUT_ALIGN - 1)) != 0)
+    {
+        //unaligned block (usually the last one) goes through page cache
+        int flags = fcntl(out->fd, F_GETFL);
+        if(flags != -1)
+            fcntl(out->fd, F_SETFL, flags & ~O_DIRECT);
+        out->direct = 0;
+    }
+#endif
+    StatMark mark;
+    statBegin(STS_WRITE, &mark);
+    uint64_t calls = 0, written = 0;
+    int result = 0;
+    while(length > 0)
+    {
+        ssize_t bytes = pwrite(out->fd, data, length, out->pos);
+        calls++;
+        if(bytes < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            result = errno;
+            break;
+        }
+        if(bytes == 0)
+        {
+            result = EIO;
+            break;
+        }
+        data += bytes;
+        length -= bytes;
+        out->pos += bytes;
+        written += bytes;
+    }
+    statEnd(STS_WRITE, &mark, written, written, calls, out->stats);
+    progressAdd(out->progress, written);
+    return result;
+}
+
+/*
+ * queue full buffer of OUT on its ring and take another one
+ */
+static int queueBlock(Output *out)
+{
+    StatMark mark;
+    statBegin(STS_WRITE, &mark);
+    uint64_t enters = out->ring->enters;
+    size_t length = out->fill;
+    ringWrite(out->ring, out->buffer, out->fd, out->pos, length);
+    out->pos += length;
+    out->fill = 0;
+
+    //waits only when every buffer is queued
+    out->buffer = ringWriteBuffer(out->ring);
+    statEnd(STS_WRITE, &mark, length, length, out->ring->enters - enters, out->stats);
+    progressAdd(out->progress, length);
+    return out->ring->writeError;
+}
+
+int flushOutput(Output *out)
+{
+    int result = 0;
+    if(out->ring != NULL)
+    {
+        StatMark mark;
+        statBegin(STS_WRITE, &mark);
+        uint64_t enters = out->ring->enters;
+        result = ringDrain(out->ring);
+        statEnd(STS_WRITE, &mark, 0, 0, out->ring->enters - enters, out->stats);
+    }
+    if(out->fill == 0)
+        return result;
+    int written = writeBlock(out, out->buffer, out->fill);
+    out->fill = 0;
+    return result != 0 ? result : written;
+}
+
+void ringOutput(Output *out, IoRing *ring)
+{
+    if(out->fd == -1 || out->fill != 0)
+        return;
+    uint8_t *buffer = ringWriteBuffer(ring);
+    if(buffer == NULL)
+        return;
+    out->ring = ring;
+    out->buffer = buffer;
+    out->capacity = IORING_BLOCK;
+}
+
+uint8_t *outputSpace(Output *out, size_t *avail)
+{
+    if(out->buffer == NULL)
+    {
+        *avail = 0;
+        return NULL;
+    }
+    *avail = out->capacity - out->fill;
+    return out->buffer + out->fill;
+}
+
+int commitOutput(Output *out, size_t length)
+{
+    out->fill += length;
+    if(out->fill == out->capacity)
+        return out->ring != NULL ? queueBlock(out) : flushOutput(out);
+    return 0;
+}
+
+int writeOutput(Output *out, const void *data, size_t length)
+{
+    const uint8_t *bytes = (const uint8_t*)data;
+    if(out->buffer == NULL)
+        return writeBlock(out, bytes, length);
+
+    while(length > 0)
+    {
+        //whole buffers are written straight from DATA, unless it would break O_DIRECT
+        if(out->fill == 0 && length >= out->capacity &&
+           (!out->direct || ((uintptr_t)bytes & (OUTPUT_ALIGN - 1)) == 0))
+        {
+            size_t direct = length - length % out->capacity;
+            int result = writeBlock(out, bytes, direct);
+            if(result != 0)
+                return result;
+            bytes += direct;
+            length -= direct;
+            continue;
+        }
+        size_t part = out->capacity - out->fill;
+        if(part > length)
+            part = length;
+        memcpy(out->buffer + out->fill, bytes, part);
+        bytes += part;
+        length -= part;
+        int result = commitOutput(out, part);
+        if(result != 0)
+            return result;
+    }
+    return 0;
+}
+
+int closeOutput(Output *out)
+{
+    int result = flushOutput(out);
+    if(out->ring != NULL)
+    {
+        ringRelease(out->ring, out->buffer);
+        out->ring = NULL;
+        out->buffer = NULL;
+    }
+    if(out->fd == -1)
+        return result;
+
+    //preallocated space past written data would read as zeros
+    if(out->size != out->pos && ftruncate(out->fd, out->pos) != 0 && result == 0)
+        result = errno;
+    if(close(out->fd) != 0 && result == 0)
+        result = errno;
+    out->fd = -1;
+    return result;
+}
@@ -0,0 +1,101 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "stats.h"
+#include "ioring.h"
+#include "progress.h"
+
+//alignment of write buffers, file offsets and lengths for O_DIRECT
+#define OUTPUT_ALIGN 0x1000
+
+//default size of buffer coalescing decompressed data into one write
+#define OUTPUT_BUFFER 0x100000
+
+typedef struct output_t
+{
+  int           fd;	//-1 for discard sink
+  uint8_t       *buffer;	//OUTPUT_ALIGN aligned, NULL to write every block as is
+  size_t        capacity;	//size of buffer, multiple of OUTPUT_ALIGN
+  size_t        fill;	//bytes waiting in buffer
+  off_t         pos;	//bytes written to file so far
+  off_t         size;	//size file was preallocated to
+  int           direct;	//file is opened with O_DIRECT
+  EntryStats    *stats;	//entry write time is added to, may be NULL
+  ProgressSlot  *progress;	//bytes written are counted to it and to total, may be NULL
+  IoRing        *ring;	//full buffers are queued on it, NULL writes them at once
+} Output;
+
+/*
+ * allocate write buffer of CAPACITY bytes usable with openOutput, free() it when done;
+ * returns NULL when out of memory
+ */
+uint8_t *allocOutputBuffer(size_t capacity);
+
+/*
+ * create (truncate) file at PATH as OUT and preallocate SIZE bytes for it; writes are
+ * collected in BUFFER of CAPACITY bytes (from allocOutputBuffer) or passed through
+ * if it is NULL; DIRECT requests O_DIRECT, it is silently dropped where not
+ * supported or once a write is not aligned; NULL PATH opens sink that only
+ * counts bytes written to it; returns 0 or errno
+ */
+int openOutput(Output *out, const char *path, off_t size, uint8_t *buffer, size_t capacity, int direct);
+
+/*
+ * same as openOutput for PATH relative to directory open as DIR (or AT_FDCWD)
+ */
+int openOutputAt(Output *out, int dir, const char *path, off_t size, uint8_t *buffer, size_t capacity, int direct);
+
+/*
+ * open existing file at PATH relative to DIR (or AT_FDCWD) as OUT to go on writing at
+ * POS, dropping everything after it; BUFFER and CAPACITY are used as by openOutput,
+ * O_DIRECT is not; returns 0 or errno, EINVAL if file is shorter than POS
+ */
+int reopenOutput(Output *out, int dir, const char *path, off_t pos, uint8_t *buffer, size_t capacity);
+
+/*
+ * make OUT write into file already open as FILE from POS on, so that parts of one
+ * file are written by several threads; BUFFER and CAPACITY are used as by openOutput;
+ * OUT is finished with flushOutput, FILE alone is closed
+ */
+void shareOutput(Output *out, const Output *file, off_t pos, uint8_t *buffer, size_t capacity);
+
+/*
+ * make empty OUT queue every full buffer on RING and go on filling another one
+ * instead of waiting for it to be written; buffer of OUT is replaced by those of
+ * RING until closeOutput, discard sink stays as it is
+ */
+void ringOutput(Output *out, IoRing *ring);
+
+/*
+ * return free space at the end of buffer of OUT and store its size into AVAIL,
+ * bytes placed there are added to file by commitOutput; NULL if OUT has no buffer
+ */
+uint8_t *outputSpace(Output *out, size_t *avail);
+
+/*
+ * append LENGTH bytes already placed at outputSpace to OUT, returns 0 or errno
+ */
+int commitOutput(Output *out, size_t length);
+
+/*
+ * append LENGTH bytes of DATA to OUT, returns 0 or errno
+ */
+int writeOutput(Output *out, const void *data, size_t length);
+
+/*
+ * write data collected in buffer of OUT and wait for queued writes, so out->pos covers
+ * all of it; returns 0 or errno
+ */
+int flushOutput(Output *out);
+
+/*
+ * write buffered data of OUT, cut file to bytes actually written (dropping unused
+ * preallocation) and close it; returns 0 or errno of first failure
+ */
+int closeOutput(Output *out);
+
+#endif
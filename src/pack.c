@@ -0,0 +1,238 @@
+#include "pack.h"
+
+//size of blocks taken from source and of compressed output buffer
+#define PACK_BLOCK 0x100000
+
+static const char keyChars[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+/*
+ * xorshift64*, good enough for keys and synthetic data
+ */
+static uint64_t nextRandom(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+void initPackOptions(PackOptions *opt, uint64_t seed)
+{
+    uint64_t state = seed ^ 0x9E3779B97F4A7C15ULL;
+    int i;
+    opt->signature = SIG_ENCRYPTED;
+    opt->level = Z_DEFAULT_COMPRESSION;
+    opt->gap = 0;
+    opt->trail = 0;
+    for(i = 0; i < PACK_KEYLENGTH; i++)
+    {
+        opt->fileNameKey[i] = keyChars[nextRandom(&state) % (sizeof(keyChars) - 1)];
+        opt->headerKey[i] = keyChars[nextRandom(&state) % (sizeof(keyChars) - 1)];
+    }
+    opt->fileNameKey[PACK_KEYLENGTH] = '\0';
+    opt->headerKey[PACK_KEYLENGTH] = '\0';
+    opt->xorVal = 1 + nextRandom(&state) % 0xff;
+}
+
+void formatKey(char *key, const PackOptions *opt, uLong crc)
+{
+    sprintf(key, "%lu^^%s%s%u", crc, opt->fileNameKey, opt->headerKey, opt->xorVal);
+}
+
+/*
+ * inverse of winTimeToUnix
+ */
+static uint64_t unixTimeToWin(time_t time)
+{
+    return ((uint64_t)time + 11644473600ULL + 5040) * 10000000ULL;
+}
+
+/*
+ * write LENGTH bytes of DATA to OUT and add them to CRC
+ */
+static int writeData(FILE *out, const void *data, size_t length, uLong *crc)
+{
+    if(length == 0)
+        return 0;
+    if(fwrite(data, 1, length, out) != length)
+        return errno ? errno : EIO;
+    *crc = crc32(*crc, (const Bytef*)data, length);
+    return 0;
+}
+
+/*
+ * write LENGTH filler bytes to OUT, they belong to no entry
+ */
+static int writeFiller(FILE *out, uint32_t length, uLong *crc)
+{
+    uint8_t filler[0x1000];
+    memset(filler, 0xa5, sizeof(filler));
+    while(length > 0)
+    {
+        uint32_t part = length < sizeof(filler) ? length : sizeof(filler);
+        int result = writeData(out, filler, part, crc);
+        if(result != 0)
+            return result;
+        length -= part;
+    }
+    return 0;
+}
+
+/*
+ * deflate SIZE bytes of entry INDEX from SOURCE to OUT, applying XOR first;
+ * number of bytes written is stored into COMPRESSED
+ */
+static int packEntry(FILE *out, z_stream *stream, uint8_t xorVal, uint32_t index, uint64_t size,
+                     PackSource source, void *arg, uint8_t *input, uint8_t *output,
+                     uint64_t *compressed, uLong *crc)
+{
+    int result = deflateReset(stream);
+    if(result != Z_OK)
+        return EINVAL;
+    *compressed = 0;
+    uint64_t remaining = size;
+    int flush = Z_NO_FLUSH;
+    do
+    {
+        size_t length = remaining < PACK_BLOCK ? remaining : PACK_BLOCK;
+        if(length > 0 && (length = source(arg, index, input, length)) == 0)
+            return EIO;
+        remaining -= length;
+        xorBuffer(xorVal, input, length);
+        flush = remaining == 0 ? Z_FINISH : Z_NO_FLUSH;
+        stream->next_in = input;
+        stream->avail_in = length;
+        do
+        {
+            stream->next_out = output;
+            stream->avail_out = PACK_BLOCK;
+            result = deflate(stream, flush);
+            if(result == Z_STREAM_ERROR)
+                return EINVAL;
+            size_t produced = PACK_BLOCK - stream->avail_out;
+            if((result = writeData(out, output, produced, crc)) != 0)
+                return result;
+            *compressed += produced;
+        } while(stream->avail_out == 0);
+    } while(flush != Z_FINISH);
+    return 0;
+}
+
+int packContainer(const char *path, const PackOptions *opt, const PackEntry *entries, uint32_t count,
+                  PackSource source, void *arg, uLong *crc)
+{
+    //header: fixed part, entries, name table; reader refuses headers under 0xff bytes
+    uint64_t namesLength = 0;
+    uint32_t i;
+    for(i = 0; i < count; i++)
+    {
+        if(entries[i].size > UINT32_MAX)
+            return EFBIG;
+        namesLength += strlen(entries[i].name) + 1;
+    }
+    uint64_t headerSize = sizeof(Header) + (uint64_t)sizeof(FileUnion) * count + sizeof(FileName)
+                          + getDataOutputSize(namesLength);
+    headerSize = getDataOutputSize(headerSize);
+    if(headerSize < 0x100)
+        headerSize = 0x100;
+    if(headerSize > UINT32_MAX || namesLength > UINT32_MAX)
+        return EFBIG;
+
+    Header *header = (Header*)calloc(1, headerSize);
+    header->headerSignature = opt->signature;
+    header->headerSize = count;
+    FileName *fn = (FileName*)&header->files[count];
+    fn->fileNameLength = namesLength;
+    char *name = (char*)fn->fileName;
+    for(i = 0; i < count; i++)
+    {
+        FileUnion *file = &header->files[i];
+        uint64_t time = unixTimeToWin(entries[i].mtime);
+        if(opt->signature == SIG_ELARGE)
+        {
+            file->file4gb.fileNameOffset = name - (char*)fn->fileName;
+            file->file4gb.fileSize = entries[i].size;
+            file->file4gb.creationTime = file->file4gb.accessTime = file->file4gb.modificationTime = time;
+            file->file4gb.isInflated = 1;
+        }
+        else
+        {
+            file->file.fileNameOffset = name - (char*)fn->fileName;
+            file->file.fileSize = entries[i].size;
+            file->file.creationTime = file->file.accessTime = file->file.modificationTime = time;
+            file->file.isInflated = 1;
+        }
+
+        //container stores dos paths
+        strcpy(name, entries[i].name);
+        char *slash;
+        while((slash = strchr(name, '/')) != NULL)
+            *slash = '\\';
+        name += strlen(name) + 1;
+    }
+
+    FILE *out = fopen(path, "wb");
+    if(out == NULL)
+    {
+        free(header);
+        return errno;
+    }
+
+    //header is written once compressed sizes are known
+    uint32_t size32 = headerSize;
+    int result = 0;
+    if(fwrite(&size32, 4, 1, out) != 1 || fwrite(header, headerSize, 1, out) != 1)
+        result = errno ? errno : EIO;
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if(opt->signature == SIG_ELARGE)
+        deflateInit(&stream, opt->level);
+    else
+        deflateInit2(&stream, opt->level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    uint8_t *input = (uint8_t*)malloc(PACK_BLOCK);
+    uint8_t *output = (uint8_t*)malloc(PACK_BLOCK);
+    *crc = crc32(0L, Z_NULL, 0);
+
+    for(i = 0; i < count && result == 0; i++)
+    {
+        uint64_t compressed;
+        result = packEntry(out, &stream, opt->xorVal % 0x100, i, entries[i].size, source, arg,
+                           input, output, &compressed, crc);
+        if(result != 0)
+            break;
+
+        //filler is counted into entry, offsets of next entries follow compressedSize
+        uint32_t filler = (i + 1 < count) ? opt->gap : opt->trail;
+        if(i + 1 < count)
+            compressed += filler;
+        if(opt->signature == SIG_ELARGE)
+            header->files[i].file4gb.compressedSize = compressed;
+        else if(compressed > UINT32_MAX)
+            result = EFBIG;
+        else
+            header->files[i].file.compressedSize = compressed;
+        if(result == 0)
+            result = writeFiller(out, filler, crc);
+    }
+    deflateEnd(&stream);
+    free(input);
+    free(output);
+
+    if(result == 0)
+    {
+        BlowfishKey bf;
+        blowfishInit(&bf, opt->fileNameKey, PACK_KEYLENGTH);
+        blowfishEncrypt(&bf, fn->fileName, getDataOutputSize(namesLength));
+        blowfishInit(&bf, opt->headerKey, PACK_KEYLENGTH);
+        blowfishEncrypt(&bf, header, headerSize);
+        if(fseeko(out, 4, SEEK_SET) != 0 || fwrite(header, headerSize, 1, out) != 1)
+            result = errno ? errno : EIO;
+    }
+    if(fclose(out) != 0 && result == 0)
+        result = errno;
+    if(result != 0)
+        unlink(path);
+    free(header);
+    return result;
+}
@@ -0,0 +1,53 @@
+#ifndef PACK_H
+#define PACK_H
+
+#include "xsdc.h"
+
+//size of a key as stored in key file
+#define PACK_KEYLENGTH 32
+
+typedef struct packentry_t
+{
+  char          *name;	//path inside container, '/' or '\' separated
+  uint64_t      size;	//uncompressed size
+  time_t        mtime;	//stored as creation, access and modification time
+} PackEntry;
+
+typedef struct packoptions_t
+{
+  uint32_t      signature;	//SIG_ENCRYPTED or SIG_ELARGE
+  uint32_t      xorVal;	//only low byte is applied to data
+  int           level;	//deflate compression level
+  uint32_t      gap;	//filler bytes after every entry but the last one
+  uint32_t      trail;	//filler bytes after the last entry
+  char          fileNameKey[PACK_KEYLENGTH + 1];
+  char          headerKey[PACK_KEYLENGTH + 1];
+} PackOptions;
+
+/*
+ * supply up to LENGTH next bytes of entry INDEX into BUFFER, entries are read
+ * in order and each one exactly up to its size; returns number of bytes supplied
+ */
+typedef size_t (*PackSource)(void *arg, uint32_t index, uint8_t *buffer, size_t length);
+
+/*
+ * fill OPT with defaults (0xb5, deflate level 6, no filler) and keys and xor
+ * value derived from SEED
+ */
+void initPackOptions(PackOptions *opt, uint64_t seed);
+
+/*
+ * write container of COUNT ENTRIES read from SOURCE to PATH as described by OPT
+ * and store crc of its data area into CRC; returns 0 or errno (EFBIG when entry
+ * does not fit the variant, EIO when SOURCE ends early)
+ */
+int packContainer(const char *path, const PackOptions *opt, const PackEntry *entries, uint32_t count,
+                  PackSource source, void *arg, uLong *crc);
+
+/*
+ * format key of container packed with OPT whose data area has CRC into KEY
+ * of at least 96 bytes, as it is stored in key file
+ */
+void formatKey(char *key, const PackOptions *opt, uLong crc);
+
+#endif
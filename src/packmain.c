@@ -0,0 +1,441 @@
+#include "pack.h"
+
+#include <getopt.h>
+
+//return values
+#define EXIT_INVALIDOPT 1
+#define EXIT_TOOLESS    2
+
+typedef enum
+{
+  CS_NONE = 0,	//pack files given on command line
+  CS_HUGE,	//one huge entry
+  CS_TINY,	//thousands of tiny entries
+  CS_TREE,	//entries scattered over deep directory tree
+  CS_FLAT	//some medium entries in one directory
+} CorpusShape;
+
+typedef enum
+{
+  CD_TEXT = 0,	//highly compressible
+  CD_RANDOM,	//incompressible
+  CD_ZERO	//compresses to almost nothing
+} CorpusData;
+
+typedef struct filesource_t
+{
+  char          **paths;	//file on disk of every entry
+  uint32_t      current;	//entry whose file is open
+  FILE          *file;
+} FileSource;
+
+typedef struct synthsource_t
+{
+  CorpusData    data;
+  uint64_t      seed;
+  uint32_t      current;	//entry state belongs to
+  uint64_t      state;
+} SynthSource;
+
+static struct option options [] =
+{
+  {"signature", required_argument, NULL, 's'},
+  {"xor",     required_argument, NULL, 'x'},
+  {"level",   required_argument, NULL, 'l'},
+  {"gap",     required_argument, NULL, 'g'},
+  {"trail",   required_argument, NULL, 't'},
+  {"corpus",  required_argument, NULL, 'c'},
+  {"count",   required_argument, NULL, 'n'},
+  {"size",    required_argument, NULL, 'z'},
+  {"depth",   required_argument, NULL, 'd'},
+  {"data",    required_argument, NULL, 'k'},
+  {"seed",    required_argument, NULL, 'r'},
+  {"version", no_argument,       NULL, 'V'},
+  {"help",    no_argument,       NULL, 'h'},
+  {0, 0, 0, 0}
+};
+
+static const char *words[] =
+{
+  "lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+  "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et"
+};
+
+static void printPackHelp(Shortness Short, char *name)
+{
+    if(Short == PH_SHORT)
+        fprintf(stderr,"Usage: %s [-s SIG] [-c SHAPE] [OPTIONS] SDC-FILE [FILE...]\n", name);
+    else
+        fprintf(
+            stdout,
+            "Usage: %s [OPTIONS] SDC-FILE [FILE...]\n"
+            "Pack FILEs (directories recursively) or generated corpus into SDC-FILE\n"
+            "and write its key to SDC-FILE.key\n"
+            "OPTIONS can be one or more of the following\n"
+            "\t-s, --signature SIG\tvariant of container, 0xb5 (default) or 0xd1\n"
+            "\t-x, --xor N\t\tvalue data is XORed with (default: from seed)\n"
+            "\t-l, --level N\t\tdeflate compression level (default: 6)\n"
+            "\t-g, --gap N\t\tN filler bytes after every entry\n"
+            "\t-t, --trail N\t\tN filler bytes after the last entry\n"
+            "\t-c, --corpus SHAPE\tgenerate entries instead of packing FILEs,\n"
+            "\t\t\t\tSHAPE is huge (1 entry of 1 GiB), tiny\n"
+            "\t\t\t\t(10000 of 64 B), tree (1000 of 4 KiB in\n"
+            "\t\t\t\tdirectories 8 levels deep) or flat (16 of 1 MiB)\n"
+            "\t-n, --count N\t\tgenerate N entries\n"
+            "\t-z, --size SIZE\t\tgenerate entries of SIZE bytes (K, M, G suffix)\n"
+            "\t-d, --depth N\t\tdepth of directory tree\n"
+            "\t-k, --data KIND\t\tcontent of generated entries: text (default),\n"
+            "\t\t\t\trandom (incompressible) or zero\n"
+            "\t-r, --seed N\t\tseed of keys and generated data (default: 1)\n"
+            "\t-h, --help\t\tprint this help and exit\n"
+            "\t-V, --version\t\toutput version information and exit\n"
+            ,name
+        );
+}
+
+static uint64_t parseSize(const char *text)
+{
+    char *end = NULL;
+    uint64_t size = strtoull(text, &end, 0);
+    switch(*end)
+    {
+    case 'G': case 'g':
+        size <<= 10;
+        //fall through
+    case 'M': case 'm':
+        size <<= 10;
+        //fall through
+    case 'K': case 'k':
+        size <<= 10;
+    }
+    return size;
+}
+
+static size_t readFileSource(void *arg, uint32_t index, uint8_t *buffer, size_t length)
+{
+    FileSource *fs = (FileSource*)arg;
+    if(fs->file == NULL || fs->current != index)
+    {
+        if(fs->file != NULL)
+            fclose(fs->file);
+        fs->current = index;
+        fs->file = fopen(fs->paths[index], "rb");
+        if(fs->file == NULL)
+        {
+            perror(fs->paths[index]);
+            return 0;
+        }
+    }
+    return fread(buffer, 1, length, fs->file);
+}
+
+static size_t readSynthSource(void *arg, uint32_t index, uint8_t *buffer, size_t length)
+{
+    SynthSource *ss = (SynthSource*)arg;
+    if(ss->current != index || ss->state == 0)
+    {
+        //every entry has its own stream, so content does not depend on block size
+        ss->current = index;
+        ss->state = (ss->seed + 1) * 0x9E3779B97F4A7C15ULL ^ ((uint64_t)index << 32 | index);
+        if(ss->state == 0)
+            ss->state = 1;
+    }
+
+    size_t i = 0;
+    uint64_t r;
+    switch(ss->data)
+    {
+    case CD_ZERO:
+        memset(buffer, 0, length);
+        break;
+    case CD_RANDOM:
+        while(i < length)
+        {
+            ss->state ^= ss->state >> 12;
+            ss->state ^= ss->state << 25;
+            ss->state ^= ss->state >> 27;
+            r = ss->state * 0x2545F4914F6CDD1DULL;
+            size_t part = length - i < 8 ? length - i : 8;
+            memcpy(buffer + i, &r, part);
+            i += part;
+        }
+        break;
+    default:
+        while(i < length)
+        {
+            ss->state ^= ss->state >> 12;
+            ss->state ^= ss->state << 25;
+            ss->state ^= ss->state >> 27;
+            r = ss->state * 0x2545F4914F6CDD1DULL;
+            const char *word = words[r % (sizeof(words) / sizeof(words[0]))];
+            size_t part = strlen(word);
+            if(part > length - i)
+                part = length - i;
+            memcpy(buffer + i, word, part);
+            i += part;
+            if(i < length)
+                buffer[i++] = (r >> 32) % 12 == 0 ? '\n' : ' ';
+        }
+        break;
+    }
+    return length;
+}
+
+/*
+ * add file at PATH to ENTRIES, directories recursively
+ */
+static int addPath(PackEntry **entries, char ***paths, uint32_t *count, const char *path)
+{
+    struct stat st;
+    if(stat(path, &st) != 0)
+    {
+        perror(path);
+        return errno;
+    }
+    if(S_ISDIR(st.st_mode))
+    {
+        DIR *dir = opendir(path);
+        if(dir == NULL)
+        {
+            perror(path);
+            return errno;
+        }
+        struct dirent *de;
+        int result = 0;
+        while(result == 0 && (de = readdir(dir)) != NULL)
+        {
+            if(strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+                continue;
+            char *child = (char*)malloc(strlen(path) + strlen(de->d_name) + 2);
+            sprintf(child, "%s/%s", path, de->d_name);
+            result = addPath(entries, paths, count, child);
+            free(child);
+        }
+        closedir(dir);
+        return result;
+    }
+
+    *entries = (PackEntry*)realloc(*entries, sizeof(PackEntry) * (*count + 1));
+    *paths = (char**)realloc(*paths, sizeof(char*) * (*count + 1));
+    PackEntry *entry = &(*entries)[*count];
+    (*paths)[*count] = strdup(path);
+
+    //stored name is relative
+    while(path[0] == '/' || (path[0] == '.' && path[1] == '/'))
+        path += path[0] == '/' ? 1 : 2;
+    entry->name = strdup(path);
+    entry->size = st.st_size;
+    entry->mtime = st.st_mtime;
+    (*count)++;
+    return 0;
+}
+
+/*
+ * fill COUNT generated entries of SIZE bytes for SHAPE
+ */
+static PackEntry *generateEntries(CorpusShape shape, uint32_t count, uint64_t size, uint32_t depth)
+{
+    PackEntry *entries = (PackEntry*)calloc(count ? count : 1, sizeof(PackEntry));
+    time_t now = time(NULL);
+    uint32_t i, level;
+    char name[4096];
+    for(i = 0; i < count; i++)
+    {
+        switch(shape)
+        {
+        case CS_HUGE:
+            snprintf(name, sizeof(name), "huge%u.bin", i);
+            break;
+        case CS_TINY:
+            snprintf(name, sizeof(name), "tiny/%05u.bin", i);
+            break;
+        case CS_TREE:
+        {
+            //entry I goes (I % DEPTH) + 1 levels deep, three subdirectories per level
+            size_t length = 0;
+            uint32_t path = i;
+            for(level = 0; level <= i % depth && length < sizeof(name) - 32; level++)
+            {
+                length += snprintf(name + length, sizeof(name) - length, "d%u/", path % 3);
+                path /= 3;
+            }
+            snprintf(name + length, sizeof(name) - length, "f%05u.txt", i);
+            break;
+        }
+        default:
+            snprintf(name, sizeof(name), "flat/%05u.bin", i);
+            break;
+        }
+        entries[i].name = strdup(name);
+        entries[i].size = size;
+        entries[i].mtime = now;
+    }
+    return entries;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t seed = 1;
+    int64_t xorVal = -1;
+    PackOptions opt;
+    initPackOptions(&opt, seed);
+    CorpusShape shape = CS_NONE;
+    CorpusData data = CD_TEXT;
+    int64_t count = -1, size = -1, depth = -1;
+    int option;
+    while((option = getopt_long(argc, argv, "s:x:l:g:t:c:n:z:d:k:r:Vh", options, 0)) != -1)
+    {
+        switch(option)
+        {
+        case 's':
+            opt.signature = strtoul(optarg, NULL, 0);
+            if(opt.signature != SIG_ENCRYPTED && opt.signature != SIG_ELARGE)
+            {
+                fprintf(stderr, "%s: Only variants 0xb5 and 0xd1 can be packed\n", argv[0]);
+                return EXIT_INVALIDOPT;
+            }
+            break;
+        case 'x':
+            xorVal = strtoul(optarg, NULL, 0);
+            break;
+        case 'l':
+            opt.level = atoi(optarg);
+            break;
+        case 'g':
+            opt.gap = strtoul(optarg, NULL, 0);
+            break;
+        case 't':
+            opt.trail = strtoul(optarg, NULL, 0);
+            break;
+        case 'c':
+            if(strcmp(optarg, "huge") == 0)
+                shape = CS_HUGE;
+            else if(strcmp(optarg, "tiny") == 0)
+                shape = CS_TINY;
+            else if(strcmp(optarg, "tree") == 0)
+                shape = CS_TREE;
+            else if(strcmp(optarg, "flat") == 0)
+                shape = CS_FLAT;
+            else
+            {
+                printPackHelp(PH_SHORT, argv[0]);
+                return EXIT_INVALIDOPT;
+            }
+            break;
+        case 'n':
+            count = strtoul(optarg, NULL, 0);
+            break;
+        case 'z':
+            size = parseSize(optarg);
+            break;
+        case 'd':
+            depth = strtoul(optarg, NULL, 0);
+            if(depth < 1)
+            {
+                printPackHelp(PH_SHORT, argv[0]);
+                return EXIT_INVALIDOPT;
+            }
+            break;
+        case 'k':
+            if(strcmp(optarg, "text") == 0)
+                data = CD_TEXT;
+            else if(strcmp(optarg, "random") == 0)
+                data = CD_RANDOM;
+            else if(strcmp(optarg, "zero") == 0)
+                data = CD_ZERO;
+            else
+            {
+                printPackHelp(PH_SHORT, argv[0]);
+                return EXIT_INVALIDOPT;
+            }
+            break;
+        case 'r':
+        {
+            //keys follow seed, other options are kept
+            PackOptions seeded;
+            seed = strtoull(optarg, NULL, 0);
+            initPackOptions(&seeded, seed);
+            memcpy(opt.fileNameKey, seeded.fileNameKey, sizeof(opt.fileNameKey));
+            memcpy(opt.headerKey, seeded.headerKey, sizeof(opt.headerKey));
+            opt.xorVal = seeded.xorVal;
+            break;
+        }
+        case 'V':
+            print_version();
+            return EXIT_SUCCESS;
+        case 'h':
+            printPackHelp(PH_LONG, argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            printPackHelp(PH_SHORT, argv[0]);
+            return EXIT_INVALIDOPT;
+        }
+    }
+    if(xorVal >= 0)
+        opt.xorVal = xorVal;
+    if((argc - optind) < 1 || (shape == CS_NONE && (argc - optind) < 2) || (shape != CS_NONE && (argc - optind) > 1))
+    {
+        printPackHelp(PH_SHORT, argv[0]);
+        return EXIT_TOOLESS;
+    }
+    const char *sdcFile = argv[optind++];
+
+    PackEntry *entries = NULL;
+    uint32_t entryCount = 0, i;
+    int result = 0;
+    uLong crc;
+    if(shape == CS_NONE)
+    {
+        FileSource fs;
+        fs.paths = NULL;
+        fs.file = NULL;
+        for(; optind < argc && result == 0; optind++)
+            result = addPath(&entries, &fs.paths, &entryCount, argv[optind]);
+        if(result == 0)
+            result = packContainer(sdcFile, &opt, entries, entryCount, readFileSource, &fs, &crc);
+        if(fs.file != NULL)
+            fclose(fs.file);
+        for(i = 0; i < entryCount; i++)
+            free(fs.paths[i]);
+        free(fs.paths);
+    }
+    else
+    {
+        //defaults of every shape
+        static const uint32_t defaultCount[] = {0, 1, 10000, 1000, 16};
+        static const uint64_t defaultSize[] = {0, 0x40000000, 64, 0x1000, 0x100000};
+        entryCount = count >= 0 ? count : defaultCount[shape];
+        SynthSource ss;
+        ss.data = data;
+        ss.seed = seed;
+        ss.current = 0;
+        ss.state = 0;
+        entries = generateEntries(shape, entryCount, size >= 0 ? size : defaultSize[shape], depth > 0 ? depth : 8);
+        result = packContainer(sdcFile, &opt, entries, entryCount, readSynthSource, &ss, &crc);
+    }
+
+    if(result == 0)
+    {
+        char key[96];
+        formatKey(key, &opt, crc);
+        char *keyFileName = (char*)malloc(strlen(sdcFile) + 5);
+        sprintf(keyFileName, "%s.key", sdcFile);
+        FILE *keyFile = fopen(keyFileName, "w");
+        if(keyFile == NULL || fputs(key, keyFile) == EOF || fclose(keyFile) != 0)
+        {
+            result = errno;
+            perror(keyFileName);
+        }
+        free(keyFileName);
+    }
+    else
+    {
+        errno = result;
+        perror(sdcFile);
+    }
+
+    for(i = 0; i < entryCount; i++)
+        free(entries[i].name);
+    free(entries);
+    return result;
+}
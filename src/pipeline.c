@@ -0,0 +1,300 @@
+#include "pipeline.h"
+
+typedef struct chunk_t
+{
+  uint8_t       *data;	//valid bytes, points into buffer or into mapped container
+  size_t        length;
+  uint8_t       *buffer;
+} Chunk;
+
+typedef struct stages_t
+{
+  Extractor     *ex;
+  SdcEntry      *entry;
+  Output        out;
+  size_t        chunkSize;
+  Ring          inFull;	//reader -> inflater
+  Ring          inFree;	//inflater -> reader
+  Ring          outFull;	//inflater -> writer
+  Ring          outFree;	//writer -> inflater
+  _Atomic int   abort;
+  int           writeError;
+} Stages;
+
+//queued after last chunk of a stage
+static Chunk endMark;
+
+/*
+ * make every stage of SG give up, also those sleeping on a ring
+ */
+static void abortStages(Stages *sg)
+{
+    atomic_store(&sg->abort, 1);
+    ringWake(&sg->inFull);
+    ringWake(&sg->inFree);
+    ringWake(&sg->outFull);
+    ringWake(&sg->outFree);
+}
+
+static void *readStage(void *arg)
+{
+    Stages *sg = (Stages*)arg;
+    SdcInput *in = sg->ex->in;
+    SdcEntry *entry = sg->entry;
+    off_t pos = entry->offset;
+    uint64_t remaining = entry->compressedSize;
+    long page = sysconf(_SC_PAGESIZE);
+
+    while(remaining > 0)
+    {
+        Chunk *chunk = (Chunk*)ringPop(&sg->inFree);
+        if(chunk == NULL)
+            return NULL;
+        size_t length = remaining < sg->chunkSize ? remaining : sg->chunkSize;
+        if(in->map != NULL)
+        {
+            //fault pages in here, so that inflater does not wait for disk
+            chunk->data = in->map + pos;
+            volatile uint8_t touch = 0;
+            size_t i;
+            for(i = 0; i < length; i += page)
+                touch ^= chunk->data[i];
+            (void)touch;
+        }
+        else
+        {
+            chunk->data = chunk->buffer;
+            length = readInput(in, pos, chunk->buffer, length);
+        }
+        if(sg->ex->countCrc)
+        {
+            StatMark mark;
+            statBegin(STS_CRC, &mark);
+            entry->crc = crcKernel(entry->crc, chunk->data, length);
+            entry->crcLength += length;
+            statEnd(STS_CRC, &mark, length, 0, 0, &entry->stats);
+        }
+        chunk->length = length;
+        if(length == 0)
+        {
+            //container ended early, chunk is freed with the rest
+            break;
+        }
+        if(!ringPush(&sg->inFull, chunk))
+            return NULL;
+        pos += length;
+        remaining -= length;
+    }
+    ringPush(&sg->inFull, &endMark);
+    return NULL;
+}
+
+static void *writeStage(void *arg)
+{
+    Stages *sg = (Stages*)arg;
+    while(1)
+    {
+        Chunk *chunk = (Chunk*)ringPop(&sg->outFull);
+        if(chunk == NULL || chunk == &endMark)
+            break;
+        int result = writeOutput(&sg->out, chunk->data, chunk->length);
+        if(result != 0)
+        {
+            sg->writeError = result;
+            abortStages(sg);
+            break;
+        }
+        if(!ringPush(&sg->outFree, chunk))
+            break;
+    }
+    return NULL;
+}
+
+/*
+ * free rings of SG and COUNT CHUNKS (may be NULL) with their buffers
+ */
+static void freeStages(Stages *sg, Chunk *chunks, uint32_t count)
+{
+    uint32_t i;
+    for(i = 0; chunks != NULL && i < count; i++)
+        free(chunks[i].buffer);
+    free(chunks);
+    ringFree(&sg->inFull);
+    ringFree(&sg->inFree);
+    ringFree(&sg->outFull);
+    ringFree(&sg->outFree);
+}
+
+/*
+ * unpack ENTRY without pipeline, when it cannot be set up
+ */
+static ExtractStatus extractSerially(Extractor *ex, ExtractState *st, SdcEntry *entry)
+{
+    Extractor serial = *ex;
+    serial.queueDepth = 0;
+    return extractEntry(&serial, st, entry);
+}
+
+ExtractStatus extractEntryPipelined(Extractor *ex, ExtractState *st, SdcEntry *entry)
+{
+    z_stream *stream = &st->inflater.stream;
+    int r = inflateReset(stream);
+    if(r != Z_OK)
+    {
+        entry->error = r;
+        return entry->status = EX_INIT;
+    }
+    entry->crc = crc32(0L, Z_NULL, 0);
+    entry->crcLength = 0;
+
+    Stages sg;
+    sg.ex = ex;
+    sg.entry = entry;
+    sg.chunkSize = ex->chunkSize ? ex->chunkSize : PIPELINE_CHUNK;
+    sg.writeError = 0;
+    atomic_init(&sg.abort, 0);
+    uint32_t depth = ex->queueDepth ? ex->queueDepth : PIPELINE_DEPTH;
+
+    //every chunk fits into any ring, so stages never block on their own returns
+    int ready = ringInit(&sg.inFull, depth + 1, &sg.abort) == 0;
+    ready &= ringInit(&sg.inFree, depth + 1, &sg.abort) == 0;
+    ready &= ringInit(&sg.outFull, depth + 1, &sg.abort) == 0;
+    ready &= ringInit(&sg.outFree, depth + 1, &sg.abort) == 0;
+    Chunk *chunks = (Chunk*)calloc(depth * 2, sizeof(Chunk));
+    uint32_t i;
+    for(i = 0; ready && chunks != NULL && i < depth * 2; i++)
+    {
+        //input chunks need no buffer when container is mapped
+        if(i >= depth || ex->in->map == NULL)
+        {
+            chunks[i].buffer = allocOutputBuffer(sg.chunkSize);
+            ready = chunks[i].buffer != NULL;
+        }
+        chunks[i].data = chunks[i].buffer;
+        ringTryPush(i < depth ? &sg.inFree : &sg.outFree, &chunks[i]);
+    }
+
+    //out of memory, unpack the usual way
+    if(!ready || chunks == NULL)
+    {
+        freeStages(&sg, chunks, depth * 2);
+        return extractSerially(ex, st, entry);
+    }
+
+    //chunks are large already, they are written without copying
+    r = openOutputAt(&sg.out, entry->dirFd, ex->discard ? NULL : entryOutput(entry), entry->fileSize, NULL, 0, ex->direct);
+    if(r != 0)
+    {
+        freeStages(&sg, chunks, depth * 2);
+        entry->error = r;
+        return entry->status = EX_OPEN;
+    }
+    sg.out.stats = &entry->stats;
+    sg.out.progress = entry->progress;
+
+    pthread_t reader, writer;
+    int haveReader = pthread_create(&reader, NULL, readStage, &sg) == 0;
+    int haveWriter = haveReader && pthread_create(&writer, NULL, writeStage, &sg) == 0;
+    ExtractStatus status = EX_OK;
+    uint64_t bytesRemaining = entry->fileSize;
+    int done = 0;
+
+    if(!haveWriter)
+    {
+        //threads not available, unpack the usual way
+        abortStages(&sg);
+        if(haveReader)
+            pthread_join(reader, NULL);
+        haveReader = 0;
+        closeOutput(&sg.out);
+        status = EX_INIT;
+    }
+
+    Chunk *out = haveWriter ? (Chunk*)ringPop(&sg.outFree) : NULL;
+    if(out != NULL)
+        out->length = 0;
+    while(out != NULL)
+    {
+        Chunk *in = (Chunk*)ringPop(&sg.inFull);
+        if(in == NULL || in == &endMark)
+            break;
+
+        //after stream end remaining chunks are only drained
+        stream->next_in = in->data;
+        stream->avail_in = in->length;
+        while(!done && stream->avail_in > 0)
+        {
+            stream->next_out = out->buffer + out->length;
+            stream->avail_out = sg.chunkSize - out->length;
+            uInt availIn = stream->avail_in;
+            StatMark mark;
+            statBegin(STS_INFLATE, &mark);
+            r = inflate(stream, Z_NO_FLUSH);
+            statEnd(STS_INFLATE, &mark, availIn - stream->avail_in,
+                    (sg.chunkSize - out->length) - stream->avail_out, 0, &entry->stats);
+            if(r < Z_OK && r != Z_BUF_ERROR)
+            {
+                entry->error = r;
+                status = EX_INFLATE;
+                done = 1;
+                break;
+            }
+            size_t produced = (sg.chunkSize - out->length) - stream->avail_out;
+            statBegin(STS_XOR, &mark);
+            xorKernel(ex->xorVal, out->buffer + out->length, produced);
+            statEnd(STS_XOR, &mark, produced, produced, 0, &entry->stats);
+            out->length += produced;
+            bytesRemaining -= produced < bytesRemaining ? produced : bytesRemaining;
+            if(r == Z_STREAM_END || bytesRemaining == 0)
+                done = 1;
+            else if(produced == 0 && availIn == stream->avail_in)
+                break;
+
+            //full chunk goes to writer, next one is taken from free ones
+            if(out->length == sg.chunkSize)
+            {
+                out->data = out->buffer;
+                if(!ringPush(&sg.outFull, out) || (out = (Chunk*)ringPop(&sg.outFree)) == NULL)
+                {
+                    out = NULL;
+                    break;
+                }
+                out->length = 0;
+            }
+        }
+        if(!ringPush(&sg.inFree, in) || out == NULL || status != EX_OK)
+            break;
+    }
+
+    if(haveWriter)
+    {
+        if(status != EX_OK || out == NULL)
+            abortStages(&sg);
+        else
+        {
+            if(out->length > 0)
+            {
+                out->data = out->buffer;
+                ringPush(&sg.outFull, out);
+            }
+            ringPush(&sg.outFull, &endMark);
+        }
+        pthread_join(reader, NULL);
+        pthread_join(writer, NULL);
+        int result = closeOutput(&sg.out);
+        if(sg.writeError == 0)
+            sg.writeError = result;
+        if(sg.writeError != 0 && status == EX_OK)
+        {
+            entry->error = sg.writeError;
+            status = EX_WRITE;
+        }
+        else if(status == EX_OK && bytesRemaining != 0)
+            status = EX_EOF;
+    }
+
+    freeStages(&sg, chunks, depth * 2);
+    if(status == EX_INIT)
+        return extractSerially(ex, st, entry);
+    return entry->status = status;
+}
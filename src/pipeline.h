@@ -0,0 +1,22 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "extract.h"
+#include "ring.h"
+
+//default number of chunks in flight between two stages
+#define PIPELINE_DEPTH 8
+
+//default size of compressed and decompressed chunks
+#define PIPELINE_CHUNK 0x40000
+
+/*
+ * unpack ENTRY with three stages running at once: reader thread filling
+ * compressed chunks, inflate and XOR on calling thread (using stream of ST)
+ * and writer thread; stages are connected with rings of ex->queueDepth
+ * chunks of ex->chunkSize bytes, so memory used is bounded by them;
+ * result is also stored in ENTRY
+ */
+ExtractStatus extractEntryPipelined(Extractor *ex, ExtractState *st, SdcEntry *entry);
+
+#endif
@@ -0,0 +1,428 @@
+#include "progress.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+
+//rates are smoothed over about this time (ms)
+#define PROGRESS_SMOOTH_MS 2000
+
+//longest status line drawn
+#define PROGRESS_LINE 512
+
+typedef struct sample_t
+{
+  uint64_t      done;	//bytes at previous sample
+  double        rate;	//smoothed bytes per second, 0 until first sample
+  uint32_t      serial;	//entry of slot the sample belongs to
+} Sample;
+
+typedef struct shown_t
+{
+  const char    *name;
+  uint64_t      total;
+  uint64_t      done;
+  Sample        *sample;
+} Shown;
+
+int progressEnabled = 0;
+
+static ProgressMode mode = PM_OFF;
+static const char *label = NULL;
+static uint64_t total = 0;
+static _Atomic uint64_t done;
+static void (*report)(void*) = NULL;
+static ProgressSlot slots[PROGRESS_SLOTS];
+
+//guards slots (but not their counters), queue and stopping
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake;
+static void **queue = NULL, **spare = NULL;	//spare is reported from while queue fills
+static uint32_t queued = 0, queueCapacity = 0, spareCapacity = 0;
+static int stopping = 0, running = 0;
+static pthread_t reporter;
+
+static uint64_t nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/*
+ * move SAMPLE to DONE bytes measured SECONDS after previous one, smoothing
+ * its rate by ALPHA
+ */
+static void updateSample(Sample *sample, uint64_t done, double seconds, double alpha)
+{
+    //too short to tell, final sample is usually taken right after previous one
+    if(seconds * 1000 < PROGRESS_BAR_MS / 2)
+    {
+        sample->done = done;
+        return;
+    }
+    double instant = (done - sample->done) / seconds;
+    sample->rate = sample->rate == 0 ? instant : sample->rate + (instant - sample->rate) * alpha;
+    sample->done = done;
+}
+
+/*
+ * return seconds left to do TOTAL at RATE after DONE bytes, -1 when unknown
+ */
+static int64_t etaSeconds(uint64_t done, uint64_t total, double rate)
+{
+    if(done >= total)
+        return 0;
+    if(rate < 1)
+        return -1;
+    return (int64_t)((total - done) / rate + 0.5);
+}
+
+/*
+ * print SECONDS as [h:]mm:ss into BUFFER of SIZE bytes
+ */
+static const char *formatEta(char *buffer, size_t size, int64_t seconds)
+{
+    if(seconds < 0)
+        snprintf(buffer, size, "--:--");
+    else if(seconds >= 3600)
+        snprintf(buffer, size, "%u:%02u:%02u", (unsigned)(seconds / 3600), (unsigned)(seconds / 60 % 60),
+                 (unsigned)(seconds % 60));
+    else
+        snprintf(buffer, size, "%u:%02u", (unsigned)(seconds / 60), (unsigned)(seconds % 60));
+    return buffer;
+}
+
+static unsigned percent(uint64_t done, uint64_t total)
+{
+    if(total == 0 || done >= total)
+        return 100;
+    return (unsigned)(done * 100 / total);
+}
+
+/*
+ * copy entries in progress into SHOWN, sampling their counters when SECONDS
+ * passed since previous sample; returns their number
+ */
+static uint32_t takeEntries(Shown *shown, Sample *samples, double seconds, double alpha)
+{
+    uint32_t i, count = 0;
+    pthread_mutex_lock(&lock);
+    for(i = 0; i < PROGRESS_SLOTS; i++)
+    {
+        ProgressSlot *slot = &slots[i];
+        Sample *sample = &samples[i];
+        if(!(slot->serial & 1))
+            continue;
+        uint64_t now = atomic_load_explicit(&slot->done, memory_order_relaxed);
+        if(sample->serial != slot->serial)
+        {
+            sample->serial = slot->serial;
+            sample->done = 0;
+            sample->rate = 0;
+        }
+        if(seconds > 0)
+            updateSample(sample, now, seconds, alpha);
+        shown[count].name = slot->name;
+        shown[count].total = slot->total;
+        shown[count].done = now;
+        shown[count].sample = sample;
+        count++;
+    }
+    pthread_mutex_unlock(&lock);
+    return count;
+}
+
+/*
+ * redraw status line with total rate of ALL and COUNT entries of SHOWN
+ */
+static void drawBar(const Sample *all, const Shown *shown, uint32_t count)
+{
+    char line[PROGRESS_LINE], eta[16];
+    uint64_t now = atomic_load_explicit(&done, memory_order_relaxed);
+    int length = snprintf(line, sizeof(line), " [%3u%%  ] %s", percent(now, total), label);
+    if(report != NULL && count > 0)
+    {
+        //entry with most left to do decides when it is over
+        const Shown *longest = &shown[0];
+        uint32_t i;
+        for(i = 1; i < count; i++)
+        {
+            if(shown[i].total - shown[i].done > longest->total - longest->done)
+                longest = &shown[i];
+        }
+        length += snprintf(line + length, sizeof(line) - length, " '%s' %u%% %.1f MiB/s ETA %s", longest->name,
+                           percent(longest->done, longest->total), longest->sample->rate / 0x100000,
+                           formatEta(eta, sizeof(eta), etaSeconds(longest->done, longest->total, longest->sample->rate)));
+        if(length < (int)sizeof(line) && count > 1)
+            length += snprintf(line + length, sizeof(line) - length, " | %u files", count);
+        else if(length < (int)sizeof(line))
+            length += snprintf(line + length, sizeof(line) - length, " | all");
+    }
+    if(length < (int)sizeof(line))
+        length += snprintf(line + length, sizeof(line) - length, " %.1f MiB/s ETA %s", all->rate / 0x100000,
+                           formatEta(eta, sizeof(eta), etaSeconds(now, total, all->rate)));
+    if(length >= (int)sizeof(line))
+        length = sizeof(line) - 1;
+
+    //line that wraps could not be redrawn in place
+    struct winsize ws;
+    if(ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 1 && length >= ws.ws_col)
+        length = ws.ws_col - 1;
+    printf("\r%.*s\033[K", length, line);
+    fflush(stdout);
+}
+
+/*
+ * print STRING quoted to OUT, with quotes and backslashes escaped
+ */
+static void printQuoted(FILE *out, const char *string)
+{
+    fputc('"', out);
+    for(; *string; string++)
+    {
+        if(*string == '"' || *string == '\\')
+            fputc('\\', out);
+        fputc(*string, out);
+    }
+    fputc('"', out);
+}
+
+/*
+ * print line for ALL bytes done and for every one of COUNT entries of SHOWN to stderr
+ */
+static void printLines(const Sample *all, const Shown *shown, uint32_t count)
+{
+    uint32_t i;
+    flockfile(stderr);
+    fprintf(stderr, "progress task=");
+    printQuoted(stderr, label);
+    fprintf(stderr, " done=%llu total=%llu rate=%.0f eta=%lld\n", (unsigned long long)all->done,
+            (unsigned long long)total, all->rate, (long long)etaSeconds(all->done, total, all->rate));
+    for(i = 0; i < count; i++)
+    {
+        fprintf(stderr, "progress entry=");
+        printQuoted(stderr, shown[i].name);
+        fprintf(stderr, " done=%llu total=%llu rate=%.0f eta=%lld\n", (unsigned long long)shown[i].done,
+                (unsigned long long)shown[i].total, shown[i].sample->rate,
+                (long long)etaSeconds(shown[i].done, shown[i].total, shown[i].sample->rate));
+    }
+    fflush(stderr);
+    funlockfile(stderr);
+}
+
+static void *reporterThread(void *arg)
+{
+    Sample all, samples[PROGRESS_SLOTS];
+    Shown shown[PROGRESS_SLOTS];
+    memset(&all, 0, sizeof(all));
+    memset(samples, 0, sizeof(samples));
+    uint64_t interval = mode == PM_LINES ? PROGRESS_LINES_MS : PROGRESS_BAR_MS;
+    double alpha = interval >= PROGRESS_SMOOTH_MS ? 1 : (double)interval / PROGRESS_SMOOTH_MS;
+    uint64_t last = nowMs(), next = last + interval, tick = last;
+    int drawn = 0;
+
+    pthread_mutex_lock(&lock);
+    while(1)
+    {
+        //queued items are taken every PROGRESS_BAR_MS, posting them wakes nobody
+        tick += PROGRESS_BAR_MS;
+        struct timespec deadline;
+        deadline.tv_sec = tick / 1000;
+        deadline.tv_nsec = tick % 1000 * 1000000;
+        while(!stopping && pthread_cond_timedwait(&wake, &lock, &deadline) != ETIMEDOUT)
+            ;
+        void **items = queue;
+        uint32_t i, count = queued, capacity = queueCapacity;
+        queue = spare;
+        queueCapacity = spareCapacity;
+        spare = items;
+        spareCapacity = capacity;
+        queued = 0;
+        int stop = stopping;
+        pthread_mutex_unlock(&lock);
+
+        //finished items are printed over status line, it is drawn again below
+        if(count > 0 && drawn)
+        {
+            printf("\r\033[K");
+            drawn = 0;
+        }
+        for(i = 0; i < count; i++)
+            report(items[i]);
+
+        uint64_t now = nowMs();
+        if(mode != PM_OFF && (now >= next || stop))
+        {
+            double seconds = (now - last) / 1000.0;
+            updateSample(&all, atomic_load_explicit(&done, memory_order_relaxed), seconds, alpha);
+            uint32_t entries = takeEntries(shown, samples, seconds, alpha);
+            last = now;
+            next = now + interval;
+            if(mode == PM_LINES)
+                printLines(&all, shown, entries);
+            else if(!stop)
+            {
+                drawBar(&all, shown, entries);
+                drawn = 1;
+            }
+        }
+        if(now > tick)
+            tick = now;
+
+        pthread_mutex_lock(&lock);
+        if(stop && queued == 0)
+            break;
+    }
+    pthread_mutex_unlock(&lock);
+
+    //leave the line as it was before the task
+    if(mode == PM_BAR && report == NULL)
+        printf("\r [      ] %s\033[K\r", label);
+    else if(mode == PM_BAR && drawn)
+        printf("\r\033[K");
+    fflush(stdout);
+    return NULL;
+}
+
+int startProgress(ProgressMode newMode, const char *newLabel, uint64_t newTotal, void (*newReport)(void*))
+{
+    mode = newMode;
+    label = newLabel;
+    total = newTotal;
+    report = newReport;
+    atomic_store(&done, 0);
+    memset(slots, 0, sizeof(slots));
+    queued = 0;
+    stopping = 0;
+    running = 0;
+    if(mode == PM_OFF && report == NULL)
+        return 0;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&wake, &attr);
+    pthread_condattr_destroy(&attr);
+    progressEnabled = mode != PM_OFF;
+    int result = pthread_create(&reporter, NULL, reporterThread, NULL);
+    if(result != 0)
+    {
+        //items are reported by whoever posts them
+        progressEnabled = 0;
+        pthread_cond_destroy(&wake);
+        return result;
+    }
+    running = 1;
+    return 0;
+}
+
+void stopProgress()
+{
+    if(running)
+    {
+        pthread_mutex_lock(&lock);
+        stopping = 1;
+        pthread_cond_signal(&wake);
+        pthread_mutex_unlock(&lock);
+        pthread_join(reporter, NULL);
+        pthread_cond_destroy(&wake);
+        running = 0;
+    }
+    progressEnabled = 0;
+    free(queue);
+    free(spare);
+    queue = spare = NULL;
+    queueCapacity = spareCapacity = 0;
+    report = NULL;
+}
+
+_Atomic uint64_t *progressCounter()
+{
+    return &done;
+}
+
+ProgressSlot *progressEntry(const char *name, uint64_t total)
+{
+    if(!progressEnabled)
+        return NULL;
+    ProgressSlot *slot = NULL;
+    uint32_t i;
+    pthread_mutex_lock(&lock);
+    for(i = 0; i < PROGRESS_SLOTS && slot == NULL; i++)
+    {
+        if(!(slots[i].serial & 1))
+            slot = &slots[i];
+    }
+    if(slot != NULL)
+    {
+        slot->name = name;
+        slot->total = total;
+        atomic_store_explicit(&slot->done, 0, memory_order_relaxed);
+        slot->serial++;
+    }
+    pthread_mutex_unlock(&lock);
+    return slot;
+}
+
+void progressEntryDone(ProgressSlot *slot)
+{
+    if(slot == NULL)
+        return;
+    pthread_mutex_lock(&lock);
+    slot->serial++;
+    pthread_mutex_unlock(&lock);
+}
+
+void progressCount(ProgressSlot *slot, uint64_t bytes)
+{
+    atomic_fetch_add_explicit(&done, bytes, memory_order_relaxed);
+    if(slot != NULL)
+        atomic_fetch_add_explicit(&slot->done, bytes, memory_order_relaxed);
+}
+
+void postProgress(void *item)
+{
+    pthread_mutex_lock(&lock);
+    if(!running)
+    {
+        pthread_mutex_unlock(&lock);
+        if(report != NULL)
+            report(item);
+        return;
+    }
+    if(queued == queueCapacity)
+    {
+        uint32_t capacity = queueCapacity ? queueCapacity * 2 : 64;
+        void **grown = (void**)realloc(queue, sizeof(void*) * capacity);
+        if(grown == NULL)
+        {
+            //out of memory, report it here rather than lose it
+            pthread_mutex_unlock(&lock);
+            report(item);
+            return;
+        }
+        queue = grown;
+        queueCapacity = capacity;
+    }
+    queue[queued++] = item;
+    pthread_mutex_unlock(&lock);
+}
+
+int progressMode(const char *name)
+{
+    if(strcmp(name, "auto") == 0)
+        return isatty(STDOUT_FILENO) ? PM_BAR : PM_OFF;
+    if(strcmp(name, "bar") == 0)
+        return PM_BAR;
+    if(strcmp(name, "lines") == 0)
+        return PM_LINES;
+    if(strcmp(name, "off") == 0)
+        return PM_OFF;
+    return -1;
+}
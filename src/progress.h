@@ -0,0 +1,91 @@
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+//entries shown at once, bytes of others count to total only
+#define PROGRESS_SLOTS 64
+
+//time between redraws of status line (and takes of queued items), between
+//machine-readable lines (ms)
+#define PROGRESS_BAR_MS 100
+#define PROGRESS_LINES_MS 1000
+
+typedef enum
+{
+  PM_OFF = 0,	//nothing is drawn, finished items are still reported
+  PM_BAR,	//status line redrawn with percentage, rate and ETA (terminal)
+  PM_LINES	//machine-readable line for total and every entry on stderr
+} ProgressMode;
+
+/*
+ * entry in progress; name and total are set under lock when it is taken,
+ * workers only add to done
+ */
+typedef struct progressslot_t
+{
+  const char    *name;
+  uint64_t      total;
+  _Atomic uint64_t done;
+  uint32_t      serial;	//odd while taken, changes with every entry
+} ProgressSlot;
+
+/*
+ * set while reporter samples counters, disabled probes cost a branch
+ */
+extern int progressEnabled;
+
+/*
+ * start reporter thread showing progress of TOTAL bytes of task LABEL in MODE;
+ * with REPORT it is a task of entries (LABEL is their action), items given to
+ * postProgress are passed to REPORT on reporter thread, so workers do no console
+ * output; without it nothing is started in PM_OFF; returns 0 or errno
+ */
+int startProgress(ProgressMode mode, const char *label, uint64_t total, void (*report)(void*));
+
+/*
+ * report items still queued, stop reporter and leave status line of task as it was
+ * before (plain label, or nothing for entries)
+ */
+void stopProgress();
+
+/*
+ * counter of total bytes done, for code that cannot take a slot (checksum)
+ */
+_Atomic uint64_t *progressCounter();
+
+/*
+ * take slot for entry NAME of TOTAL bytes; returns NULL when not enabled or all
+ * slots are taken
+ */
+ProgressSlot *progressEntry(const char *name, uint64_t total);
+
+/*
+ * give SLOT (may be NULL) back once its entry is done
+ */
+void progressEntryDone(ProgressSlot *slot);
+
+/*
+ * add BYTES to total and to SLOT (may be NULL), used by progressAdd
+ */
+void progressCount(ProgressSlot *slot, uint64_t bytes);
+
+static inline void progressAdd(ProgressSlot *slot, uint64_t bytes)
+{
+    if(progressEnabled)
+        progressCount(slot, bytes);
+}
+
+/*
+ * queue ITEM to be passed to report function of running task
+ */
+void postProgress(void *item);
+
+/*
+ * return mode named NAME (auto, bar, lines, off), auto is bar when stdout is
+ * a terminal and off otherwise; -1 for unknown name
+ */
+int progressMode(const char *name);
+
+#endif
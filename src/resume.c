@@ -0,0 +1,290 @@
+#define _GNU_SOURCE
+#include "resume.h"
+
+int initResume(ResumeState *rs, const char *path, const IndexKey *key, uint32_t count, uint64_t interval)
+{
+    memset(rs, 0, sizeof(ResumeState));
+    memcpy(rs->header.magic, RESUME_MAGIC, sizeof(rs->header.magic));
+    rs->header.key = *key;
+    rs->header.count = count;
+    rs->interval = interval ? interval : RESUME_INTERVAL;
+    rs->path = strdup(path);
+    rs->done = (uint8_t*)calloc(1, count / 8 + 1);
+    pthread_mutex_init(&rs->lock, NULL);
+    pthread_mutex_init(&rs->saveLock, NULL);
+    return rs->path == NULL || rs->done == NULL ? ENOMEM : 0;
+}
+
+void freeResume(ResumeState *rs)
+{
+    free(rs->path);
+    rs->path = NULL;
+    free(rs->done);
+    rs->done = NULL;
+    free(rs->points);
+    rs->points = NULL;
+    rs->header.pointCount = 0;
+    pthread_mutex_destroy(&rs->lock);
+    pthread_mutex_destroy(&rs->saveLock);
+}
+
+/*
+ * remove temporary files (PATH.XXXXXX) left behind by saves that were interrupted
+ */
+static void removeStale(const char *path)
+{
+    char *dirPath = strdup(path);
+    if(dirPath == NULL)
+        return;
+    char *slash = strrchr(dirPath, '/');
+    const char *base = slash != NULL ? slash + 1 : path;
+    DIR *dir = opendir(slash == dirPath ? "/" : slash != NULL ? (*slash = 0, dirPath) : ".");
+    if(dir == NULL)
+    {
+        free(dirPath);
+        return;
+    }
+    size_t baseLength = strlen(base);
+    struct dirent *de;
+    while((de = readdir(dir)) != NULL)
+    {
+        if(strlen(de->d_name) == baseLength + 7 && strncmp(de->d_name, base, baseLength) == 0
+            && de->d_name[baseLength] == '.')
+            unlinkat(dirfd(dir), de->d_name, 0);
+    }
+    closedir(dir);
+    free(dirPath);
+}
+
+int loadResume(ResumeState *rs)
+{
+    removeStale(rs->path);
+    FILE *f = fopen(rs->path, "r");
+    if(f == NULL)
+        return ENOENT;
+
+    ResumeHeader rh;
+    size_t doneSize = rs->header.count / 8 + 1;
+    uint8_t *done = (uint8_t*)malloc(doneSize);
+    Checkpoint *points = NULL;
+    uint32_t check;
+    int error = ENOENT;
+    if(done == NULL
+        || fread(&rh, sizeof(rh), 1, f) != 1
+        || memcmp(rh.magic, RESUME_MAGIC, sizeof(rh.magic)) != 0
+        || memcmp(&rh.key, &rs->header.key, sizeof(IndexKey)) != 0
+        || rh.count != rs->header.count
+        || rh.pointCount > rh.count
+        || fread(done, doneSize, 1, f) != 1)
+        goto out;
+
+    //at most one checkpoint per worker, so they are few
+    points = (Checkpoint*)malloc(sizeof(Checkpoint) * (rh.pointCount + 1));
+    if(points == NULL
+        || (rh.pointCount != 0 && fread(points, sizeof(Checkpoint), rh.pointCount, f) != rh.pointCount)
+        || fread(&check, sizeof(check), 1, f) != 1
+        || fgetc(f) != EOF)
+        goto out;
+
+    uLong sum = crc32(0L, (Bytef*)&rh, sizeof(rh));
+    sum = crc32(sum, done, doneSize);
+    sum = crc32(sum, (Bytef*)points, sizeof(Checkpoint) * rh.pointCount);
+    if(sum != check)
+        goto out;
+
+    uint32_t i;
+    for(i = 0; i < rh.pointCount; i++)
+    {
+        if(points[i].entry >= rh.count || points[i].bits > 7 || points[i].windowLength > RESUME_WINDOW)
+            goto out;
+    }
+
+    rs->header = rh;
+    free(rs->done);
+    rs->done = done;
+    free(rs->points);
+    rs->points = points;
+    done = NULL;
+    points = NULL;
+    error = 0;
+out:
+    fclose(f);
+    free(done);
+    free(points);
+    return error;
+}
+
+/*
+ * copy RS as it is to be written into SNAP, called with lock held;
+ * returns 0 or errno
+ */
+static int snapResume(ResumeState *rs, ResumeSnap *snap)
+{
+    size_t doneSize = rs->header.count / 8 + 1;
+    size_t pointsSize = sizeof(Checkpoint) * rs->header.pointCount;
+    snap->size = sizeof(ResumeHeader) + doneSize + pointsSize + sizeof(uint32_t);
+    snap->data = (uint8_t*)malloc(snap->size);
+    if(snap->data == NULL)
+        return ENOMEM;
+    memcpy(snap->data, &rs->header, sizeof(ResumeHeader));
+    memcpy(snap->data + sizeof(ResumeHeader), rs->done, doneSize);
+    if(pointsSize != 0)
+        memcpy(snap->data + sizeof(ResumeHeader) + doneSize, rs->points, pointsSize);
+    uint32_t check = crc32(0L, snap->data, snap->size - sizeof(check));
+    memcpy(snap->data + snap->size - sizeof(check), &check, sizeof(check));
+    snap->sequence = ++rs->taken;
+    rs->pending = 0;
+    return 0;
+}
+
+/*
+ * atomically replace file of RS with SNAP (freed), called without lock so that
+ * workers go on meanwhile; snapshot older than one already written is dropped
+ */
+static int storeResume(ResumeState *rs, ResumeSnap *snap)
+{
+    pthread_mutex_lock(&rs->saveLock);
+    int error = 0;
+    char *tmpPath = NULL;
+    if(snap->sequence <= rs->stored)
+        goto out;
+
+    //same as index, readers see either whole old state or whole new one
+    tmpPath = (char*)malloc(strlen(rs->path) + 8);
+    if(tmpPath == NULL)
+    {
+        error = ENOMEM;
+        goto out;
+    }
+    sprintf(tmpPath, "%s.XXXXXX", rs->path);
+    int fd = mkstemp(tmpPath);
+    if(fd < 0)
+    {
+        error = errno;
+        goto out;
+    }
+
+    size_t written = 0;
+    while(written < snap->size)
+    {
+        ssize_t bytes = write(fd, snap->data + written, snap->size - written);
+        if(bytes < 0 && errno == EINTR)
+            continue;
+        if(bytes <= 0)
+        {
+            error = bytes < 0 ? errno : EIO;
+            break;
+        }
+        written += bytes;
+    }
+    if(error == 0 && fdatasync(fd) != 0)
+        error = errno;
+    if(close(fd) != 0 && error == 0)
+        error = errno;
+    if(error == 0 && rename(tmpPath, rs->path) != 0)
+        error = errno;
+    if(error != 0)
+        unlink(tmpPath);
+    else
+        rs->stored = snap->sequence;
+out:
+    pthread_mutex_unlock(&rs->saveLock);
+    free(tmpPath);
+    free(snap->data);
+    snap->data = NULL;
+    return error;
+}
+
+int saveResume(ResumeState *rs)
+{
+    ResumeSnap snap;
+    pthread_mutex_lock(&rs->lock);
+    int error = snapResume(rs, &snap);
+    pthread_mutex_unlock(&rs->lock);
+    return error != 0 ? error : storeResume(rs, &snap);
+}
+
+void resumeCrc(ResumeState *rs, uLong crc)
+{
+    pthread_mutex_lock(&rs->lock);
+    rs->header.crcKnown = 1;
+    rs->header.crc = crc;
+    ResumeSnap snap;
+    int error = snapResume(rs, &snap);
+    pthread_mutex_unlock(&rs->lock);
+    if(error == 0)
+        storeResume(rs, &snap);
+}
+
+int resumeDone(ResumeState *rs, uint32_t index)
+{
+    pthread_mutex_lock(&rs->lock);
+    int done = index < rs->header.count && (rs->done[index / 8] & (1 << (index % 8))) != 0;
+    pthread_mutex_unlock(&rs->lock);
+    return done;
+}
+
+/*
+ * return checkpoint of entry INDEX or NULL, called with lock held
+ */
+static Checkpoint *findPoint(ResumeState *rs, uint32_t index)
+{
+    uint32_t i;
+    for(i = 0; i < rs->header.pointCount; i++)
+    {
+        if(rs->points[i].entry == index)
+            return &rs->points[i];
+    }
+    return NULL;
+}
+
+void resumeFinish(ResumeState *rs, uint32_t index, uint64_t size)
+{
+    if(index >= rs->header.count)
+        return;
+    pthread_mutex_lock(&rs->lock);
+    rs->done[index / 8] |= 1 << (index % 8);
+    Checkpoint *point = findPoint(rs, index);
+    if(point != NULL)
+        *point = rs->points[--rs->header.pointCount];
+
+    //many small entries are recorded together, saving syncs state file
+    ResumeSnap snap;
+    rs->pending += size;
+    int save = rs->pending >= rs->interval && snapResume(rs, &snap) == 0;
+    pthread_mutex_unlock(&rs->lock);
+    if(save)
+        storeResume(rs, &snap);
+}
+
+int resumePoint(ResumeState *rs, uint32_t index, Checkpoint *point)
+{
+    pthread_mutex_lock(&rs->lock);
+    Checkpoint *found = findPoint(rs, index);
+    if(found != NULL)
+        *point = *found;
+    pthread_mutex_unlock(&rs->lock);
+    return found != NULL;
+}
+
+int resumeCheckpoint(ResumeState *rs, const Checkpoint *point)
+{
+    pthread_mutex_lock(&rs->lock);
+    Checkpoint *slot = findPoint(rs, point->entry);
+    if(slot == NULL)
+    {
+        Checkpoint *points = (Checkpoint*)realloc(rs->points, sizeof(Checkpoint) * (rs->header.pointCount + 1));
+        if(points == NULL)
+        {
+            pthread_mutex_unlock(&rs->lock);
+            return ENOMEM;
+        }
+        rs->points = points;
+        slot = &rs->points[rs->header.pointCount++];
+    }
+    *slot = *point;
+    ResumeSnap snap;
+    int error = snapResume(rs, &snap);
+    pthread_mutex_unlock(&rs->lock);
+    return error != 0 ? error : storeResume(rs, &snap);
+}
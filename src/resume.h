@@ -0,0 +1,111 @@
+#ifndef RESUME_H
+#define RESUME_H
+
+#include "index.h"
+
+//name of resume state stored next to container, appended to its path
+#define RESUME_SUFFIX ".xsdm-resume"
+
+#define RESUME_MAGIC "XSDMRSM1"
+
+//inflate dictionary, last 32 KiB of output
+#define RESUME_WINDOW 0x8000
+
+//default amount of output between two checkpoints
+#define RESUME_INTERVAL 0x10000000
+
+typedef struct __attribute__ ((__packed__))
+{
+  uint32_t      entry;	//index of entry in header
+  uint32_t      bits;	//bits of byte before input still to be inflated (0-7)
+  uint64_t      input;	//container offset of first compressed byte not consumed
+  uint64_t      output;	//bytes of entry already durable in its file
+  uint32_t      windowLength;	//valid bytes of window, less only at start of entry
+  uint8_t       window[RESUME_WINDOW];	//output preceding checkpoint, not XORed
+} Checkpoint;
+
+typedef struct __attribute__ ((__packed__))
+{
+  char          magic[8];	//RESUME_MAGIC
+  IndexKey      key;	//state of other container or key is ignored
+  uint32_t      crcKnown;	//crc of data area was counted
+  uint32_t      crc;
+  uint32_t      count;	//entries of container
+  uint32_t      pointCount;
+} ResumeHeader;
+//   uint8_t       done[(count + 7) / 8];	bitmap of entries unpacked completely
+//   Checkpoint    points[pointCount];	entries unpacked partially
+//   uint32_t      check;	crc32 of everything above
+
+typedef struct resumestate_t
+{
+  char          *path;
+  ResumeHeader  header;
+  uint8_t       *done;
+  Checkpoint    *points;
+  uint64_t      interval;	//output between checkpoints
+  uint64_t      pending;	//output of entries done since last save
+  uint64_t      taken;	//snapshots of state taken so far
+  uint64_t      stored;	//sequence of snapshot in file, guarded by saveLock
+  pthread_mutex_t lock;	//guards state, not held while file is written
+  pthread_mutex_t saveLock;	//serializes writing of file
+} ResumeState;
+
+typedef struct resumesnap_t
+{
+  uint8_t       *data;	//file contents, check included
+  size_t        size;
+  uint64_t      sequence;	//newer snapshots have higher one
+} ResumeSnap;
+
+/*
+ * initialize empty state RS of container with KEY and COUNT entries, saved to
+ * PATH (copied) every INTERVAL bytes of output; returns 0 or errno
+ */
+int initResume(ResumeState *rs, const char *path, const IndexKey *key, uint32_t count, uint64_t interval);
+
+/*
+ * free everything allocated for RS
+ */
+void freeResume(ResumeState *rs);
+
+/*
+ * load state saved at rs->path if it was made for the same container and key and
+ * remove temporary files of interrupted saves; returns 0 or ENOENT if there is
+ * none (or it is stale or damaged)
+ */
+int loadResume(ResumeState *rs);
+
+/*
+ * atomically replace saved state with RS, returns 0 or errno
+ */
+int saveResume(ResumeState *rs);
+
+/*
+ * remember that crc of data area is CRC and save RS
+ */
+void resumeCrc(ResumeState *rs, uLong crc);
+
+/*
+ * return non-zero if entry INDEX was unpacked completely
+ */
+int resumeDone(ResumeState *rs, uint32_t index);
+
+/*
+ * mark entry INDEX of SIZE bytes unpacked and drop its checkpoint, state is saved
+ * once interval of output is collected; its file has to be durable already
+ */
+void resumeFinish(ResumeState *rs, uint32_t index, uint64_t size);
+
+/*
+ * copy checkpoint of entry INDEX into POINT, returns 0 if it has none
+ */
+int resumePoint(ResumeState *rs, uint32_t index, Checkpoint *point);
+
+/*
+ * replace checkpoint of POINT's entry with POINT and save RS, output up to it has to be
+ * durable already; returns 0 or errno
+ */
+int resumeCheckpoint(ResumeState *rs, const Checkpoint *point);
+
+#endif
@@ -0,0 +1,126 @@
+#include "ring.h"
+
+#include <stdlib.h>
+#include <sched.h>
+
+//polls before yielding the cpu, then before sleeping while waiting
+#define RING_SPIN 64
+#define RING_YIELD 16
+
+int ringInit(Ring *ring, uint32_t depth, _Atomic int *abort)
+{
+    uint32_t size = 1;
+    while(size < depth)
+        size <<= 1;
+    ring->mask = size - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->waiting, 0);
+    ring->abort = abort;
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->wake, NULL);
+    ring->slots = (void**)calloc(size, sizeof(void*));
+    return ring->slots == NULL ? -1 : 0;
+}
+
+void ringFree(Ring *ring)
+{
+    free(ring->slots);
+    ring->slots = NULL;
+    pthread_cond_destroy(&ring->wake);
+    pthread_mutex_destroy(&ring->lock);
+}
+
+void ringWake(Ring *ring)
+{
+    pthread_mutex_lock(&ring->lock);
+    pthread_cond_broadcast(&ring->wake);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+/*
+ * wake other side of RING if it sleeps, called after head or tail moved
+ */
+static void notify(Ring *ring)
+{
+    //pairs with fence in park: either waiter sees the move or it is seen waiting
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load_explicit(&ring->waiting, memory_order_relaxed))
+        ringWake(ring);
+}
+
+int ringTryPush(Ring *ring, void *item)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if(head - tail > ring->mask)
+        return 0;
+    ring->slots[head & ring->mask] = item;
+    //publish the slot before moving head
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    notify(ring);
+    return 1;
+}
+
+void *ringTryPop(Ring *ring)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if(head == tail)
+        return NULL;
+    void *item = ring->slots[tail & ring->mask];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    notify(ring);
+    return item;
+}
+
+/*
+ * wait for other side of RING to move, SPIN counts polls so far; busy polling
+ * first, as stages usually catch up quickly, then yielding and then sleeping
+ */
+static void park(Ring *ring, int *spin, int pushing)
+{
+    if(++*spin <= RING_SPIN)
+        return;
+    if(*spin <= RING_SPIN + RING_YIELD)
+    {
+        sched_yield();
+        return;
+    }
+
+    pthread_mutex_lock(&ring->lock);
+    atomic_store_explicit(&ring->waiting, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    int blocked = pushing ? head - tail > ring->mask : head == tail;
+    if(blocked && !atomic_load_explicit(ring->abort, memory_order_relaxed))
+        pthread_cond_wait(&ring->wake, &ring->lock);
+    atomic_store_explicit(&ring->waiting, 0, memory_order_relaxed);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+int ringPush(Ring *ring, void *item)
+{
+    int spin = 0;
+    while(!ringTryPush(ring, item))
+    {
+        if(atomic_load_explicit(ring->abort, memory_order_relaxed))
+            return 0;
+        park(ring, &spin, 1);
+    }
+    return 1;
+}
+
+void *ringPop(Ring *ring)
+{
+    int spin = 0;
+    void *item;
+    while((item = ringTryPop(ring)) == NULL)
+    {
+        if(atomic_load_explicit(ring->abort, memory_order_relaxed))
+            return NULL;
+        park(ring, &spin, 0);
+    }
+    return item;
+}
@@ -0,0 +1,61 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+/*
+ * bounded lock-free queue of pointers for exactly one producer and one consumer
+ */
+typedef struct ring_t
+{
+  void          **slots;
+  uint32_t      mask;	//number of slots - 1, number of slots is power of 2
+  _Atomic uint32_t head;	//next slot to be written, advanced by producer only
+  _Atomic uint32_t tail;	//next slot to be read, advanced by consumer only
+  _Atomic int   *abort;	//when set, blocking calls give up
+  _Atomic int   waiting;	//blocking calls parked on wake, the other side signals it
+  pthread_mutex_t lock;	//guards parking only, queue itself is lock-free
+  pthread_cond_t wake;
+} Ring;
+
+/*
+ * initialize RING for at least DEPTH items, blocking calls return
+ * early when *ABORT becomes non-zero; returns 0 on success
+ */
+int ringInit(Ring *ring, uint32_t depth, _Atomic int *abort);
+
+/*
+ * free slots of RING, items still queued are not touched
+ */
+void ringFree(Ring *ring);
+
+/*
+ * wake calls blocked on RING, so that they see abort set
+ */
+void ringWake(Ring *ring);
+
+/*
+ * queue ITEM, returns 0 if RING is full
+ */
+int ringTryPush(Ring *ring, void *item);
+
+/*
+ * take oldest item, returns NULL if RING is empty
+ */
+void *ringTryPop(Ring *ring);
+
+/*
+ * queue ITEM, wait while RING is full (spinning briefly, then sleeping);
+ * returns 0 if aborted
+ */
+int ringPush(Ring *ring, void *item);
+
+/*
+ * take oldest item, wait while RING is empty (spinning briefly, then sleeping);
+ * returns NULL if aborted
+ */
+void *ringPop(Ring *ring);
+
+#endif
@@ -0,0 +1,172 @@
+#include "seekindex.h"
+
+void initSeekIndex(SeekIndex *si, const IndexKey *key, uint64_t span)
+{
+    memset(si, 0, sizeof(SeekIndex));
+    memcpy(si->header.magic, SEEKINDEX_MAGIC, sizeof(si->header.magic));
+    si->header.key = *key;
+    si->header.span = span ? span : SEEKINDEX_SPAN;
+    pthread_mutex_init(&si->lock, NULL);
+}
+
+void freeSeekIndex(SeekIndex *si)
+{
+    free(si->points);
+    si->points = NULL;
+    si->header.count = 0;
+    si->capacity = 0;
+    pthread_mutex_destroy(&si->lock);
+}
+
+int loadSeekIndex(SeekIndex *si, const char *path, int exact)
+{
+    FILE *f = fopen(path, "r");
+    if(f == NULL)
+        return ENOENT;
+
+    SeekIndexHeader sh;
+    Checkpoint *points = NULL;
+    uint32_t check;
+    int error = ENOENT;
+    if(fread(&sh, sizeof(sh), 1, f) != 1
+        || memcmp(sh.magic, SEEKINDEX_MAGIC, sizeof(sh.magic)) != 0
+        || (exact && memcmp(&sh.key, &si->header.key, sizeof(IndexKey)) != 0)
+        || sh.key.size != si->header.key.size
+        || sh.key.keyHash != si->header.key.keyHash)
+        goto out;
+
+    //size is checked against file before anything is allocated for it
+    struct stat st;
+    if(fstat(fileno(f), &st) != 0
+        || (uint64_t)st.st_size != sizeof(sh) + (uint64_t)sizeof(Checkpoint) * sh.count + sizeof(check))
+        goto out;
+    points = (Checkpoint*)malloc(sizeof(Checkpoint) * (sh.count + 1));
+    if(points == NULL
+        || (sh.count != 0 && fread(points, sizeof(Checkpoint), sh.count, f) != sh.count)
+        || fread(&check, sizeof(check), 1, f) != 1)
+        goto out;
+
+    uLong sum = crc32(0L, (Bytef*)&sh, sizeof(sh));
+    sum = crc32(sum, (Bytef*)points, sizeof(Checkpoint) * sh.count);
+    if(sum != check)
+        goto out;
+
+    uint32_t i;
+    for(i = 0; i < sh.count; i++)
+    {
+        if(points[i].bits > 7 || points[i].windowLength > RESUME_WINDOW
+            || (i != 0 && (points[i].entry < points[i - 1].entry
+                || (points[i].entry == points[i - 1].entry && points[i].output <= points[i - 1].output))))
+            goto out;
+    }
+
+    pthread_mutex_lock(&si->lock);
+    si->header = sh;
+    free(si->points);
+    si->points = points;
+    si->capacity = sh.count + 1;
+    si->loaded = 1;
+    pthread_mutex_unlock(&si->lock);
+    points = NULL;
+    error = 0;
+out:
+    fclose(f);
+    free(points);
+    return error;
+}
+
+static int comparePoints(const void *a, const void *b)
+{
+    const Checkpoint *x = (const Checkpoint*)a, *y = (const Checkpoint*)b;
+    if(x->entry != y->entry)
+        return x->entry < y->entry ? -1 : 1;
+    return x->output < y->output ? -1 : x->output > y->output;
+}
+
+int saveSeekIndex(SeekIndex *si, const char *path)
+{
+    //entries unpacked on several threads add their points interleaved
+    pthread_mutex_lock(&si->lock);
+    if(si->header.count != 0)
+        qsort(si->points, si->header.count, sizeof(Checkpoint), comparePoints);
+    uLong sum = crc32(0L, (Bytef*)&si->header, sizeof(SeekIndexHeader));
+    sum = crc32(sum, (Bytef*)si->points, sizeof(Checkpoint) * si->header.count);
+    uint32_t check = sum;
+
+    //same as index, readers see either whole old one or whole new one
+    char *tmpPath = (char*)malloc(strlen(path) + 8);
+    sprintf(tmpPath, "%s.XXXXXX", path);
+    int fd = mkstemp(tmpPath);
+    if(fd < 0)
+    {
+        int error = errno;
+        pthread_mutex_unlock(&si->lock);
+        free(tmpPath);
+        return error;
+    }
+
+    int error = 0;
+    FILE *f = fdopen(fd, "w");
+    if(f == NULL)
+    {
+        error = errno;
+        close(fd);
+    }
+    else
+    {
+        if(fwrite(&si->header, sizeof(SeekIndexHeader), 1, f) != 1
+            || (si->header.count != 0
+                && fwrite(si->points, sizeof(Checkpoint), si->header.count, f) != si->header.count)
+            || fwrite(&check, sizeof(check), 1, f) != 1
+            || fflush(f) != 0)
+            error = errno ? errno : EIO;
+        if(fclose(f) != 0 && error == 0)
+            error = errno;
+    }
+    pthread_mutex_unlock(&si->lock);
+    if(error == 0 && rename(tmpPath, path) != 0)
+        error = errno;
+    if(error != 0)
+        unlink(tmpPath);
+    free(tmpPath);
+    return error;
+}
+
+int addSeekPoint(SeekIndex *si, const Checkpoint *point)
+{
+    pthread_mutex_lock(&si->lock);
+    if(si->header.count == si->capacity)
+    {
+        uint32_t capacity = si->capacity ? si->capacity * 2 : 16;
+        Checkpoint *points = (Checkpoint*)realloc(si->points, sizeof(Checkpoint) * capacity);
+        if(points == NULL)
+        {
+            pthread_mutex_unlock(&si->lock);
+            return ENOMEM;
+        }
+        si->points = points;
+        si->capacity = capacity;
+    }
+    si->points[si->header.count++] = *point;
+    pthread_mutex_unlock(&si->lock);
+    return 0;
+}
+
+uint32_t entrySeekPoints(SeekIndex *si, uint32_t index, const Checkpoint **first)
+{
+    //first point of entry not before INDEX
+    uint32_t low = 0, high = si->header.count;
+    while(low < high)
+    {
+        uint32_t middle = (low + high) / 2;
+        if(si->points[middle].entry < index)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    uint32_t end = low;
+    while(end < si->header.count && si->points[end].entry == index)
+        end++;
+    *first = si->points + low;
+    return end - low;
+}
@@ -0,0 +1,73 @@
+#ifndef SEEKINDEX_H
+#define SEEKINDEX_H
+
+#include "index.h"
+#include "resume.h"
+
+//name of seek-point index stored next to container, appended to its path
+#define SEEKINDEX_SUFFIX ".xsdm-points"
+
+#define SEEKINDEX_MAGIC "XSDMPTS1"
+
+//default amount of output between two seek points
+#define SEEKINDEX_SPAN 0x1000000
+
+typedef struct __attribute__ ((__packed__))
+{
+  char          magic[8];	//SEEKINDEX_MAGIC
+  IndexKey      key;	//index of other container or key is ignored
+  uint64_t      span;	//output between points it was built with
+  uint32_t      count;	//points following this struct
+} SeekIndexHeader;
+//   Checkpoint    points[count];	sorted by entry, then by output
+//   uint32_t      check;	crc32 of everything above
+
+/*
+ * points where inflate of an entry can start without inflating what is before
+ * them, recorded during sequential unpacking and used to unpack one entry on
+ * several threads; adding is thread safe
+ */
+typedef struct seekindex_t
+{
+  SeekIndexHeader header;
+  Checkpoint    *points;
+  uint32_t      capacity;
+  int           loaded;	//points come from file, nothing is recorded
+  pthread_mutex_t lock;
+} SeekIndex;
+
+/*
+ * initialize empty index SI of container with KEY recording point every SPAN
+ * bytes of output (SEEKINDEX_SPAN if 0)
+ */
+void initSeekIndex(SeekIndex *si, const IndexKey *key, uint64_t span);
+
+/*
+ * free everything allocated for SI
+ */
+void freeSeekIndex(SeekIndex *si);
+
+/*
+ * replace points of SI with index at PATH if it was made for the same container
+ * and key; only size and key hash are compared unless EXACT; returns 0 or ENOENT
+ * if there is none (or it is stale or damaged)
+ */
+int loadSeekIndex(SeekIndex *si, const char *path, int exact);
+
+/*
+ * atomically replace index at PATH with SI, returns 0 or errno
+ */
+int saveSeekIndex(SeekIndex *si, const char *path);
+
+/*
+ * add copy of POINT to SI, returns 0 or ENOMEM
+ */
+int addSeekPoint(SeekIndex *si, const Checkpoint *point);
+
+/*
+ * store first point of entry INDEX into FIRST and return their number, SI has to
+ * be sorted (as every loaded one is)
+ */
+uint32_t entrySeekPoints(SeekIndex *si, uint32_t index, const Checkpoint **first);
+
+#endif
@@ -0,0 +1,211 @@
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+typedef struct stagetotal_t
+{
+  _Atomic uint64_t wallNs;	//summed over threads
+  _Atomic uint64_t cpuNs;	//of sampled calls only
+  _Atomic uint64_t sampledNs;	//wall time of sampled calls
+  _Atomic uint64_t bytesIn;
+  _Atomic uint64_t bytesOut;
+  _Atomic uint64_t calls;
+  _Atomic uint64_t syscalls;
+} StageTotal;
+
+typedef struct entryrow_t
+{
+  char          *container;
+  char          *name;
+  uint64_t      compressed;
+  uint64_t      size;
+  int           status;
+  EntryStats    stats;
+} EntryRow;
+
+int statsEnabled = 0;
+
+static StageTotal totals[STS_COUNT];
+static EntryRow *rows = NULL;
+static uint32_t rowCount = 0, rowCapacity = 0;
+static pthread_mutex_t rowLock = PTHREAD_MUTEX_INITIALIZER;
+
+//monotonic time when next call of every stage on this thread is sampled
+static __thread uint64_t cpuDue[STS_COUNT];
+
+static const char *stageNames[STS_COUNT] =
+{
+  "read", "crc", "decrypt", "inflate", "xor", "write", "mkdir"
+};
+
+void enableStats()
+{
+    int i;
+    for(i = 0; i < STS_COUNT; i++)
+    {
+        atomic_store(&totals[i].wallNs, 0);
+        atomic_store(&totals[i].cpuNs, 0);
+        atomic_store(&totals[i].sampledNs, 0);
+        atomic_store(&totals[i].bytesIn, 0);
+        atomic_store(&totals[i].bytesOut, 0);
+        atomic_store(&totals[i].calls, 0);
+        atomic_store(&totals[i].syscalls, 0);
+    }
+    pthread_mutex_lock(&rowLock);
+    rowCount = 0;
+    pthread_mutex_unlock(&rowLock);
+    statsEnabled = 1;
+}
+
+static uint64_t clockNs(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void statNow(StatStage stage, StatMark *mark)
+{
+    //thread cpu clock is a syscall, monotonic one is not
+    mark->wall = clockNs(CLOCK_MONOTONIC);
+    mark->sampled = stage != STS_COUNT && mark->wall >= cpuDue[stage];
+    if(mark->sampled)
+        mark->cpu = clockNs(CLOCK_THREAD_CPUTIME_ID);
+}
+
+void statAdd(StatStage stage, const StatMark *mark, uint64_t bytesIn, uint64_t bytesOut,
+             uint64_t syscalls, EntryStats *entry)
+{
+    uint64_t now = clockNs(CLOCK_MONOTONIC);
+    uint64_t wall = now - mark->wall;
+    StageTotal *total = &totals[stage];
+    atomic_fetch_add_explicit(&total->wallNs, wall, memory_order_relaxed);
+    if(mark->sampled)
+    {
+        atomic_fetch_add_explicit(&total->cpuNs, clockNs(CLOCK_THREAD_CPUTIME_ID) - mark->cpu, memory_order_relaxed);
+        atomic_fetch_add_explicit(&total->sampledNs, wall, memory_order_relaxed);
+        cpuDue[stage] = now + STATS_CPU_INTERVAL;
+    }
+    atomic_fetch_add_explicit(&total->bytesIn, bytesIn, memory_order_relaxed);
+    atomic_fetch_add_explicit(&total->bytesOut, bytesOut, memory_order_relaxed);
+    atomic_fetch_add_explicit(&total->calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&total->syscalls, syscalls, memory_order_relaxed);
+
+    //entry is owned by one thread, except for pipeline stages of the same entry
+    if(entry != NULL)
+        __atomic_fetch_add(&entry->stageNs[stage], wall, __ATOMIC_RELAXED);
+}
+
+void statEntry(const char *container, const char *name, uint64_t compressed, uint64_t size,
+               int status, const EntryStats *es)
+{
+    pthread_mutex_lock(&rowLock);
+    if(rowCount == rowCapacity)
+    {
+        rowCapacity = rowCapacity ? rowCapacity * 2 : 64;
+        rows = (EntryRow*)realloc(rows, sizeof(EntryRow) * rowCapacity);
+    }
+    EntryRow *row = &rows[rowCount++];
+    row->container = strdup(container);
+    row->name = strdup(name);
+    row->compressed = compressed;
+    row->size = size;
+    row->status = status;
+    row->stats = *es;
+    pthread_mutex_unlock(&rowLock);
+}
+
+/*
+ * write S to OUT as json string
+ */
+static void printJsonString(FILE *out, const char *s)
+{
+    fputc('"', out);
+    for(; *s; s++)
+    {
+        unsigned char c = *s;
+        if(c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if(c < 0x20)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static double rate(uint64_t bytes, uint64_t ns)
+{
+    return ns ? (bytes / 1048576.0) / (ns / 1e9) : 0.0;
+}
+
+/*
+ * return cpu time of stage T, scaled from calls that were sampled to all of them
+ */
+static uint64_t stageCpu(StageTotal *t)
+{
+    uint64_t sampled = atomic_load(&t->sampledNs);
+    return sampled ? (uint64_t)((double)atomic_load(&t->cpuNs) * atomic_load(&t->wallNs) / sampled) : 0;
+}
+
+void printStats(FILE *out, StatFormat format, double wallSeconds)
+{
+    int i;
+    uint32_t r;
+    pthread_mutex_lock(&rowLock);
+    if(format == SF_JSON)
+    {
+        fprintf(out, "{\n  \"wall_seconds\": %.6f,\n  \"stages\": {\n", wallSeconds);
+        for(i = 0; i < STS_COUNT; i++)
+        {
+            StageTotal *t = &totals[i];
+            fprintf(out, "    \"%s\": {\"wall_ns\": %llu, \"cpu_ns\": %llu, \"bytes_in\": %llu, "
+                    "\"bytes_out\": %llu, \"calls\": %llu, \"syscalls\": %llu, \"mib_per_s\": %.1f}%s\n",
+                    stageNames[i],
+                    (unsigned long long)atomic_load(&t->wallNs), (unsigned long long)stageCpu(t),
+                    (unsigned long long)atomic_load(&t->bytesIn), (unsigned long long)atomic_load(&t->bytesOut),
+                    (unsigned long long)atomic_load(&t->calls), (unsigned long long)atomic_load(&t->syscalls),
+                    rate(atomic_load(&t->bytesIn), atomic_load(&t->wallNs)),
+                    i + 1 < STS_COUNT ? "," : "");
+        }
+        fprintf(out, "  },\n  \"entries\": [\n");
+        for(r = 0; r < rowCount; r++)
+        {
+            EntryRow *row = &rows[r];
+            fprintf(out, "    {\"container\": ");
+            printJsonString(out, row->container);
+            fprintf(out, ", \"name\": ");
+            printJsonString(out, row->name);
+            fprintf(out, ", \"compressed\": %llu, \"size\": %llu, \"status\": %d, \"wall_ns\": %llu",
+                    (unsigned long long)row->compressed, (unsigned long long)row->size, row->status,
+                    (unsigned long long)row->stats.wallNs);
+            for(i = 0; i < STS_COUNT; i++)
+            {
+                if(i != STS_DECRYPT && i != STS_MKDIR)
+                    fprintf(out, ", \"%s_ns\": %llu", stageNames[i], (unsigned long long)row->stats.stageNs[i]);
+            }
+            fprintf(out, "}%s\n", r + 1 < rowCount ? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+    }
+    else
+    {
+        fprintf(out, "%-8s %12s %12s %14s %14s %10s %10s %10s\n",
+                "stage", "wall ms", "cpu ms", "bytes in", "bytes out", "calls", "syscalls", "MiB/s");
+        for(i = 0; i < STS_COUNT; i++)
+        {
+            StageTotal *t = &totals[i];
+            fprintf(out, "%-8s %12.3f %12.3f %14llu %14llu %10llu %10llu %10.1f\n", stageNames[i],
+                    atomic_load(&t->wallNs) / 1e6, stageCpu(t) / 1e6,
+                    (unsigned long long)atomic_load(&t->bytesIn), (unsigned long long)atomic_load(&t->bytesOut),
+                    (unsigned long long)atomic_load(&t->calls), (unsigned long long)atomic_load(&t->syscalls),
+                    rate(atomic_load(&t->bytesIn), atomic_load(&t->wallNs)));
+        }
+        fprintf(out, "%u entries in %.3f s\n", rowCount, wallSeconds);
+    }
+    pthread_mutex_unlock(&rowLock);
+}
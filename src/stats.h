@@ -0,0 +1,92 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum
+{
+  STS_READ = 0,	//reading container, syscalls are preads (freads on stream)
+  STS_CRC,	//checksumming data area
+  STS_DECRYPT,	//decrypting header and file names
+  STS_INFLATE,
+  STS_XOR,
+  STS_WRITE,	//writing unpacked files, syscalls are pwrites
+  STS_MKDIR,	//creating directories
+  STS_COUNT
+} StatStage;
+
+typedef enum
+{
+  SF_TEXT = 0,	//table for humans
+  SF_JSON
+} StatFormat;
+
+//cpu time of thread is read for first call of a stage on every thread and then
+//once per this interval (ns) of the stage, per-stage cpu is scaled from those calls
+#define STATS_CPU_INTERVAL 10000000ULL
+
+typedef struct statmark_t
+{
+  uint64_t      wall;	//monotonic clock, ns
+  uint64_t      cpu;	//cpu time of calling thread, ns, valid if sampled
+  int           sampled;	//cpu was read for this call
+} StatMark;
+
+typedef struct entrystats_t
+{
+  uint64_t      wallNs;	//whole entry from open to close
+  uint64_t      stageNs[STS_COUNT];	//wall time of stages spent on this entry
+} EntryStats;
+
+/*
+ * set by enableStats, every probe checks it first so disabled ones cost a branch
+ */
+extern int statsEnabled;
+
+/*
+ * start collecting counters, stage totals and entry rows are cleared
+ */
+void enableStats();
+
+/*
+ * store current time into MARK for call of STAGE, cpu time is read only when
+ * the call is sampled (never for STS_COUNT, which is wall time only), used by
+ * statBegin
+ */
+void statNow(StatStage stage, StatMark *mark);
+
+/*
+ * add call to STAGE started at MARK with BYTESIN consumed, BYTESOUT produced
+ * and SYSCALLS made to totals and to ENTRY (may be NULL), used by statEnd
+ */
+void statAdd(StatStage stage, const StatMark *mark, uint64_t bytesIn, uint64_t bytesOut,
+             uint64_t syscalls, EntryStats *entry);
+
+static inline void statBegin(StatStage stage, StatMark *mark)
+{
+    if(statsEnabled)
+        statNow(stage, mark);
+}
+
+static inline void statEnd(StatStage stage, const StatMark *mark, uint64_t bytesIn, uint64_t bytesOut,
+                           uint64_t syscalls, EntryStats *entry)
+{
+    if(statsEnabled)
+        statAdd(stage, mark, bytesIn, bytesOut, syscalls, entry);
+}
+
+/*
+ * record row of entry NAME of CONTAINER with COMPRESSED and SIZE bytes that
+ * finished with STATUS, timings are taken from ES; thread safe
+ */
+void statEntry(const char *container, const char *name, uint64_t compressed, uint64_t size,
+               int status, const EntryStats *es);
+
+/*
+ * write totals of every stage and entry rows to OUT in FORMAT, WALLSECONDS is
+ * duration of whole run
+ */
+void printStats(FILE *out, StatFormat format, double wallSeconds);
+
+#endif
@@ -1,18 +1,97 @@
 #include "xsdc.h"
 
+__thread int quietOutput = 0;
+
+typedef struct crcslices_t
+{
+  SdcInput      *in;
+  off_t         start;	//first byte of first slice
+  off_t         end;	//end of last slice
+  size_t        sliceSize;
+  uint32_t      count;	//number of slices
+  uint32_t      next;	//next slice to be handed out
+  uLong         *crc;	//crc of every slice
+  pthread_mutex_t lock;
+} CrcSlices;
+
 void print_help(Shortness Short,char *name)
 {
     if(Short == PH_SHORT)
-        fprintf(stderr,"Usage: %s [-vf] [SDC-FILE]\n", name);
+        fprintf(stderr,"Usage: %s [-vf1MpsDltr] [-I[DIR]] [-U[N]] [-R MIB] [-j N] [-k KEY] [-x PATTERN]... [-m MANIFEST] [SDC-FILE... | -]\n", name);
     else
         fprintf(
             stdout,
-            "Usage: %s [OPTIONS] [SDC-FILE]\n"
+            "Usage: %s [OPTIONS] [SDC-FILE... | -]\n"
             "OPTIONS can be one or more of the following\n"
 //             "Mandatory arguments to long options are mandatory for short options too.\n"
             "\t-f, --force\t\tunpack file even if checksum is invalid\n"
             "\t-v, --verbose\t\tbe verbose\n"
             "\t-H, --header FILE\twrite SDC file header to FILE\n"
+            "\t-1, --single-pass\tverify checksum while unpacking, files are\n"
+            "\t\t\t\tunpacked under temporary names and renamed\n"
+            "\t\t\t\tonly if checksum matches\n"
+            "\t-l, --list\t\tprint size, compressed size, modification time,\n"
+            "\t\t\t\toffset and name of every entry, nothing is\n"
+            "\t\t\t\tunpacked and data area is not read\n"
+            "\t-x, --extract PATTERN\tunpack only entries whose path matches shell\n"
+            "\t\t\t\tPATTERN ('*' matches '/' too), may be given\n"
+            "\t\t\t\tmore times; checksum is not verified unless\n"
+            "\t\t\t\treading a stream\n"
+            "\t-t, --test\t\tverify checksum and that every file inflates to\n"
+            "\t\t\t\texactly its size without writing anything,\n"
+            "\t\t\t\treport first failing file\n"
+            "\t-I, --index[=DIR]\tkeep decrypted header and checksum of SDC file\n"
+            "\t\t\t\tin SDC-FILE.xsdm-index (or in DIR) and reuse\n"
+            "\t\t\t\tthem while SDC file and key stay the same\n"
+            "\t-r, --resume\t\tcontinue unpacking interrupted earlier: skip\n"
+            "\t\t\t\tfiles and checksum done, go on from last\n"
+            "\t\t\t\tcheckpoint kept in SDC-FILE.xsdm-resume\n"
+            "\t-R, --checkpoint MIB\twith --resume, make checkpoint every MIB\n"
+            "\t\t\t\tmegabytes unpacked (default: 256)\n"
+            "\t-P, --seek-points[=MIB]\trecord seek points of large files every MIB\n"
+            "\t\t\t\t(default: 16) in SDC-FILE.xsdm-points; once\n"
+            "\t\t\t\tthey are there, unpack each file on --jobs\n"
+            "\t\t\t\tthreads, one part between points per thread\n"
+            "\t-Z, --inflate BACKEND\tinflate files up to 8 MiB in one call with\n"
+            "\t\t\t\tBACKEND: libdeflate (default if built in)\n"
+            "\t\t\t\tor zlib\n"
+            "\t-M, --no-mmap\t\tread SDC file with stdio instead of mapping it\n"
+            "\t-U, --io-uring[=N]\tread SDC file and write unpacked files through\n"
+            "\t\t\t\tio_uring, keeping N (default: 8) reads and N\n"
+            "\t\t\t\twrites queued per thread; implies --no-mmap\n"
+            "\t-D, --direct\t\twrite unpacked files with O_DIRECT, bypassing\n"
+            "\t\t\t\tpage cache\n"
+            "\t-G, --progress MODE\tshow percentage, MiB/s and ETA of checksum and\n"
+            "\t\t\t\tfiles being unpacked: bar redraws status\n"
+            "\t\t\t\tline (default on terminal), lines prints\n"
+            "\t\t\t\tkey=value lines to stderr every second, off\n"
+            "\t\t\t\tshows nothing (default otherwise)\n"
+            "\t-T, --stats[=FORMAT]\tprint time, bytes, calls and syscalls of every\n"
+            "\t\t\t\tstage and entry, FORMAT is text or json\n"
+            "\t-O, --stats-file FILE\twrite stats to FILE instead of stderr\n"
+            "\t-j, --jobs N\t\tunpack up to N files at once and checksum\n"
+            "\t\t\t\tSDC file on N threads; with more SDC files\n"
+            "\t\t\t\tunpack up to N of them at once\n"
+            "\t-S, --crc-slice MIB\tchecksum MIB megabytes at a time on each\n"
+            "\t\t\t\tthread (default: 64)\n"
+            "\t-p, --pipeline\t\tread, inflate and write large files on\n"
+            "\t\t\t\tseparate threads\n"
+            "\t-Q, --queue-depth N\tkeep up to N chunks between pipeline\n"
+            "\t\t\t\tstages (default: 8)\n"
+            "\t-C, --chunk-size KIB\tsize of pipeline chunk (default: 256)\n"
+            "\t-s, --stream\t\tread SDC file strictly in order, without\n"
+            "\t\t\t\tseeking; stdin is used if SDC-FILE is - or\n"
+            "\t\t\t\tmissing, implies --single-pass\n"
+            "\t-k, --key KEY\t\tuse KEY instead of content of SDC-FILE.key\n"
+            "\t-K, --keyring FILE\tfind key of every SDC file among key strings\n"
+            "\t\t\t\tin FILE (one per line, as in key file) by\n"
+            "\t\t\t\tchecksum of its data area, which verifies\n"
+            "\t\t\t\tit at the same time\n"
+            "\t-m, --manifest FILE\tunpack also containers listed in FILE, one\n"
+            "\t\t\t\tpath per line, optionally followed by tab\n"
+            "\t\t\t\tand key\n"
+            "\t-B, --memory-budget MIB\tin batch, start containers only while their\n"
+            "\t\t\t\testimated memory fits in MIB megabytes\n"
             "\t-h, --help\t\tprint this help and exit\n"
             "\t-V, --version\t\toutput version information and exit\n"
 //             "\t-?, --??\t\ttext\n"
@@ -38,32 +117,52 @@ void print_version()
 
 void xorBuffer(uint8_t factor, unsigned char *buffer, uint32_t bufferSize)
 {
-    unsigned int i;
-    for(i = 0; i < bufferSize; i++)
-    {
-        buffer[i] ^= factor;
-    }
+    xorKernel(factor, buffer, bufferSize);
 }
 
-UnpackStatus fillUnpackStruct(UnpackData *unpackData, void *edv)
+/*
+ * split EDV into CHECKSUM, XORVAL and KEYS (fileNameKey followed by headerKey)
+ */
+static UnpackStatus splitEdv(const char *edv, uint32_t *checksum, uint32_t *xorVal, const char **keys)
 {
-    UnpackData ud;
-    ud.unformatted = edv;
-    if(strlen((char*)edv)<0x44)
+    if(strlen(edv)<0x44)
         return FUS_LNG;
-    char *keyStart = strstr((char*)ud.unformatted,"^^");
+    const char *keyStart = strstr(edv,"^^");
     if(keyStart == NULL)
         return FUS_NFND;
     keyStart += 2;
-    ud.fileNameKey = keyStart;
-    ud.headerKey = keyStart+0x20;
+    *keys = keyStart;
     char *endptr = NULL;
-    ud.checksum = strtoul((char*)ud.unformatted,&endptr,10);
-    if(ud.unformatted == endptr)
+    *checksum = strtoul(edv,&endptr,10);
+    if(edv == endptr)
         return FUS_NAN;
-    ud.xorVal = strtoul(keyStart+0x40,&endptr,10);
+    *xorVal = strtoul(keyStart+0x40,&endptr,10);
     if(keyStart+0x40 == endptr)
         return FUS_NAN;
+    return FUS_OK;
+}
+
+UnpackStatus edvChecksum(const char *edv, uint32_t *checksum)
+{
+    uint32_t xorVal;
+    const char *keys;
+    return splitEdv(edv, checksum, &xorVal, &keys);
+}
+
+UnpackStatus fillUnpackStruct(UnpackData *unpackData, void *edv)
+{
+    UnpackData ud;
+    ud.unformatted = edv;
+    const char *keyStart;
+    UnpackStatus us = splitEdv((char*)edv, &ud.checksum, &ud.xorVal, &keyStart);
+    if(us != FUS_OK)
+        return us;
+    ud.fileNameKey = (char*)keyStart;
+    ud.headerKey = (char*)keyStart+0x20;
+
+    //expand keys once, they are used for every block
+    blowfishInit(&ud.fileNameBf, ud.fileNameKey, 32);
+    blowfishInit(&ud.headerBf, ud.headerKey, 32);
 
     //ok, copy to unpackData
     memcpy(unpackData,(void*)&ud,sizeof(UnpackData));
@@ -83,68 +182,445 @@ uint32_t getDataOutputSize(uint32_t inputSize)
 
 DecrError decryptData(void *buffer, uint32_t *bufferSize, void *outputBuffer, void *key, uint32_t keyLength)
 {
-    //open encryption desciptor
-    int err = 0;
-    MCRYPT td = mcrypt_module_open("blowfish-compat", NULL, "ecb", NULL);
-    if(td == MCRYPT_FAILED)
+    if(keyLength == 0 || keyLength > 56)
+        return DD_IE;
+
+    BlowfishKey bf;
+    blowfishInit(&bf, key, keyLength);
+
+    //decrypt
+    *bufferSize = getDataOutputSize(*bufferSize);
+    if(outputBuffer != buffer)
+        memcpy(outputBuffer, buffer, *bufferSize);
+    blowfishDecrypt(&bf, outputBuffer, *bufferSize);
+
+    return DD_OK;
+}
+
+/*
+ * find size of container opened as in->file and map it unless NOMMAP is set
+ */
+static void setupInput(SdcInput *in, int noMmap)
+{
+    struct stat st;
+    if(fstat(fileno(in->file), &st) == 0 && S_ISREG(st.st_mode))
     {
-        return DD_AO;
+        in->size = st.st_size;
+    }
+    else
+    {
+        fseeko(in->file, 0, SEEK_END);
+        in->size = ftello(in->file);
+        fseeko(in->file, 0, SEEK_SET);
     }
 
-    //set decryption key
-    err = mcrypt_generic_init(td, key, keyLength, NULL);
-    if(err < 0)
+    //map whole container, on failure just stay with stdio
+    if(!noMmap && S_ISREG(st.st_mode) && in->size > 0 && (uint64_t)in->size <= SIZE_MAX)
     {
-        return DD_IE;
+        void *map = mmap(NULL, in->size, PROT_READ, MAP_PRIVATE, fileno(in->file), 0);
+        if(map != MAP_FAILED)
+        {
+            in->map = (uint8_t*)map;
+            madvise(in->map, in->size, MADV_SEQUENTIAL);
+        }
     }
+}
 
-    //decrypt
-    *bufferSize = getDataOutputSize(*bufferSize);
-    memcpy(outputBuffer, buffer, *bufferSize);
-    int offset = 0;
-    int blockSize = mcrypt_enc_get_block_size(td);
-    while(offset<*bufferSize)
+int openInput(SdcInput *in, const char *path, int noMmap)
+{
+    in->ioDepth = 0;
+    in->checked = NULL;
+    in->map = NULL;
+    in->borrowed = 0;
+    in->stream = 0;
+    in->file = fopen(path, "r");
+    if(in->file == NULL)
+        return errno;
+    setupInput(in, noMmap);
+    return 0;
+}
+
+int openInputFd(SdcInput *in, int fd, int noMmap)
+{
+    in->ioDepth = 0;
+    in->checked = NULL;
+    in->map = NULL;
+    in->borrowed = 0;
+    in->stream = 0;
+
+    //own descriptor, so that closeInput leaves caller's one open
+    int own = dup(fd);
+    if(own < 0)
+        return errno;
+    in->file = fdopen(own, "r");
+    if(in->file == NULL)
+    {
+        int error = errno;
+        close(own);
+        return error;
+    }
+    setupInput(in, noMmap);
+    return 0;
+}
+
+void openMemory(SdcInput *in, const void *data, size_t size)
+{
+    in->ioDepth = 0;
+    in->checked = NULL;
+    in->file = NULL;
+    in->map = (uint8_t*)data;
+    in->borrowed = 1;
+    in->size = size;
+    in->stream = 0;
+}
+
+int openStream(SdcInput *in, const char *path)
+{
+    in->ioDepth = 0;
+    in->checked = NULL;
+    in->map = NULL;
+    in->borrowed = 0;
+    in->file = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    if(in->file == NULL)
+        return errno;
+
+    //size is not known until the end is reached
+    in->size = 0;
+    in->stream = 1;
+    in->pos = 0;
+    in->crcStart = -1;
+    in->crc = crc32(0L, Z_NULL, 0);
+    return 0;
+}
+
+static size_t consumeStream(SdcInput *in, void *buffer, size_t length)
+{
+    StatMark mark;
+    statBegin(STS_READ, &mark);
+    size_t bytes = fread(buffer, 1, length, in->file);
+    statEnd(STS_READ, &mark, bytes, bytes, 1, NULL);
+
+    //checksum only the part at or after crcStart
+    if(bytes > 0 && in->crcStart >= 0 && in->pos + (off_t)bytes > in->crcStart)
+    {
+        size_t skip = in->crcStart > in->pos ? in->crcStart - in->pos : 0;
+        statBegin(STS_CRC, &mark);
+        in->crc = crcKernel(in->crc, (Bytef*)buffer + skip, bytes - skip);
+        statEnd(STS_CRC, &mark, bytes - skip, 0, 0, NULL);
+    }
+    in->pos += bytes;
+    if(in->pos > in->size)
+        in->size = in->pos;
+    return bytes;
+}
+
+static size_t readStream(SdcInput *in, off_t offset, void *buffer, size_t length)
+{
+    //cannot go back, gap before OFFSET is read and thrown away
+    if(offset < in->pos)
+        return 0;
+    uint8_t skip[0x4000];
+    while(in->pos < offset)
     {
-        err = mdecrypt_generic(td, outputBuffer + offset, blockSize);
-        if(err != 0)
+        size_t gap = (offset - in->pos) < (off_t)sizeof(skip) ? (size_t)(offset - in->pos) : sizeof(skip);
+        if(consumeStream(in, skip, gap) == 0)
+            return 0;
+    }
+    return consumeStream(in, buffer, length);
+}
+
+uLong drainStream(SdcInput *in)
+{
+    uint8_t buffer[0x4000];
+    while(consumeStream(in, buffer, sizeof(buffer)) != 0)
+        ;
+    return in->crc;
+}
+
+void closeInput(SdcInput *in)
+{
+    if(in->map != NULL && !in->borrowed)
+        munmap(in->map, in->size);
+    in->map = NULL;
+    if(in->file != NULL)
+        fclose(in->file);
+    in->file = NULL;
+}
+
+size_t readInput(SdcInput *in, off_t offset, void *buffer, size_t length)
+{
+    if(in->stream)
+        return readStream(in, offset, buffer, length);
+    if(in->map == NULL)
+    {
+        //pread does not move file position, so it is safe to use from many threads
+        StatMark mark;
+        statBegin(STS_READ, &mark);
+        size_t done = 0;
+        uint64_t calls = 0;
+        while(done < length)
         {
-            return DD_DE;
+            ssize_t bytes = pread(fileno(in->file), (uint8_t*)buffer + done, length - done, offset + done);
+            calls++;
+            if(bytes <= 0)
+                break;
+            done += bytes;
         }
-        offset += blockSize;
+        statEnd(STS_READ, &mark, done, done, calls, NULL);
+        return done;
+    }
+
+    if(offset >= in->size)
+        return 0;
+    if(length > in->size - offset)
+        length = in->size - offset;
+    memcpy(buffer, in->map + offset, length);
+    return length;
+}
+
+void adviseInput(SdcInput *in, off_t offset, off_t length)
+{
+    if(in->map == NULL || offset >= in->size)
+        return;
+    if(length > in->size - offset)
+        length = in->size - offset;
+
+    //madvise wants page aligned address
+    off_t aligned = offset & ~((off_t)sysconf(_SC_PAGESIZE) - 1);
+    madvise(in->map + aligned, length + (offset - aligned), MADV_WILLNEED);
+}
+
+ulong countCrc(SdcInput *in, uint32_t hdrSize)
+{
+    return updateCrc(in, hdrSize+4, in->size, crc32(0L, Z_NULL, 0));
+}
+
+/*
+ * count BYTES checksummed from IN to its progress counter
+ */
+static inline void crcProgress(SdcInput *in, size_t bytes)
+{
+    if(in->checked != NULL)
+        atomic_fetch_add_explicit(in->checked, bytes, memory_order_relaxed);
+}
+
+/*
+ * update CRC with bytes from START to END of unmapped IN read through RING
+ */
+static uLong ringCrc(IoRing *ring, SdcInput *in, off_t start, off_t end, uLong crc)
+{
+    StatMark mark;
+    uint64_t enters = ring->enters;
+    startRingRead(ring, fileno(in->file), start, end);
+    while(1)
+    {
+        const uint8_t *block;
+        statBegin(STS_READ, &mark);
+        ssize_t bytes = nextRingRead(ring, &block);
+        statEnd(STS_READ, &mark, bytes > 0 ? bytes : 0, bytes > 0 ? bytes : 0, ring->enters - enters, NULL);
+        enters = ring->enters;
+        if(bytes <= 0)
+            break;
+        statBegin(STS_CRC, &mark);
+        crc = crcKernel(crc, block, bytes);
+        statEnd(STS_CRC, &mark, bytes, 0, 0, NULL);
+        crcProgress(in, bytes);
     }
+    stopRingRead(ring);
+    return crc;
+}
 
-    //close descriptor
-    err = mcrypt_generic_deinit(td);
-    if(err < 0)
+static void *crcWorker(void *arg)
+{
+    CrcSlices *cs = (CrcSlices*)arg;
+    void *buffer = NULL;
+    IoRing ring;
+    int ringed = cs->in->map == NULL && cs->in->ioDepth != 0 && initRing(&ring, cs->in->ioDepth) == 0;
+    if(cs->in->map == NULL && !ringed)
+        buffer = malloc(0x100000);
+
+    while(1)
     {
-        return DD_DIE;
+        pthread_mutex_lock(&cs->lock);
+        uint32_t slice = cs->next++;
+        pthread_mutex_unlock(&cs->lock);
+        if(slice >= cs->count)
+            break;
+
+        off_t start = cs->start + (off_t)slice * cs->sliceSize;
+        off_t end = start + cs->sliceSize;
+        if(end > cs->end)
+            end = cs->end;
+        uLong crc = crc32(0L, Z_NULL, 0);
+        if(cs->in->map != NULL)
+        {
+            crc = updateCrc(cs->in, start, end, crc);
+        }
+        else if(ringed)
+        {
+            //reads of the slice are queued ahead of checksumming
+            crc = ringCrc(&ring, cs->in, start, end, crc);
+        }
+        else
+        {
+            //pread does not share file position with other threads
+            while(start < end)
+            {
+                size_t length = (end - start) < 0x100000 ? (end - start) : 0x100000;
+                length = readInput(cs->in, start, buffer, length);
+                if(length == 0)
+                    break;
+                StatMark mark;
+                statBegin(STS_CRC, &mark);
+                crc = crcKernel(crc, (Bytef*)buffer, length);
+                statEnd(STS_CRC, &mark, length, 0, 0, NULL);
+                crcProgress(cs->in, length);
+                start += length;
+            }
+        }
+        cs->crc[slice] = crc;
     }
-    err = mcrypt_module_close(td);
 
-    return DD_OK;
+    if(ringed)
+        freeRing(&ring);
+    free(buffer);
+    return NULL;
 }
 
-ulong countCrc(FILE *f, uint32_t hdrSize)
+ulong countCrcParallel(SdcInput *in, uint32_t hdrSize, int threads, size_t sliceSize)
 {
-    void *buffer = malloc(0x1000);
+    CrcSlices cs;
+    cs.in = in;
+    cs.start = hdrSize + 4;
+    cs.end = in->size;
+    if(cs.end <= cs.start)
+        return crc32(0L, Z_NULL, 0);
+    if(sliceSize == 0)
+        sliceSize = CRC_SLICE;
+    cs.sliceSize = sliceSize;
+    cs.count = (cs.end - cs.start + sliceSize - 1) / sliceSize;
+    cs.next = 0;
+    if(threads > cs.count)
+        threads = cs.count;
+    if(threads <= 1)
+        return countCrc(in, hdrSize);
+    cs.crc = (uLong*)malloc(sizeof(uLong) * cs.count);
+    pthread_mutex_init(&cs.lock, NULL);
+
+    pthread_t *tids = (pthread_t*)malloc(sizeof(pthread_t) * threads);
+    int i, started = 0;
+    for(i = 0; i < threads; i++)
+    {
+        if(pthread_create(&tids[started], NULL, crcWorker, &cs) == 0)
+            started++;
+    }
+    if(started == 0)
+        crcWorker(&cs);
+    for(i = 0; i < started; i++)
+        pthread_join(tids[i], NULL);
+
+    //merge slices in order, last one may be shorter
     uLong crc = crc32(0L, Z_NULL, 0);
-    fseek(f, hdrSize+4, SEEK_SET);
+    uint32_t slice;
+    for(slice = 0; slice < cs.count; slice++)
+    {
+        off_t length = cs.sliceSize;
+        if(slice == cs.count - 1)
+            length = cs.end - cs.start - (off_t)slice * cs.sliceSize;
+        crc = crc32_combine(crc, cs.crc[slice], length);
+    }
+
+    free(tids);
+    free(cs.crc);
+    pthread_mutex_destroy(&cs.lock);
+    return crc;
+}
+
+uLong updateCrc(SdcInput *in, off_t start, off_t end, uLong crc)
+{
+    if(end > in->size)
+        end = in->size;
+    if(start >= end)
+        return crc;
+    StatMark mark;
+    if(in->map != NULL)
+    {
+        //in pieces, so that progress of large slices can be followed
+        statBegin(STS_CRC, &mark);
+        off_t pos;
+        for(pos = start; pos < end; pos += CRC_PIECE)
+        {
+            size_t length = end - pos < CRC_PIECE ? end - pos : CRC_PIECE;
+            crc = crcKernel(crc, in->map + pos, length);
+            crcProgress(in, length);
+        }
+        statEnd(STS_CRC, &mark, end - start, 0, 0, NULL);
+        return crc;
+    }
+    IoRing ring;
+    if(in->ioDepth != 0 && initRing(&ring, in->ioDepth) == 0)
+    {
+        crc = ringCrc(&ring, in, start, end, crc);
+        freeRing(&ring);
+        return crc;
+    }
+
+    void *buffer = malloc(0x100000);
     size_t bytes = 0;
-    while((bytes = fread(buffer, 1, 0x1000, f)) != 0)
+    while(start < end && (bytes = readInput(in, start, buffer, (end - start) < 0x100000 ? (end - start) : 0x100000)) != 0)
     {
-        crc = crc32(crc, (Bytef*)buffer, bytes);
+        statBegin(STS_CRC, &mark);
+        crc = crcKernel(crc, (Bytef*)buffer, bytes);
+        statEnd(STS_CRC, &mark, bytes, 0, 0, NULL);
+        crcProgress(in, bytes);
+        start += bytes;
     }
     free(buffer);
     return crc;
 }
 
-DecrError loadHeader(FILE *f, Header *hdr, uint32_t hdrSize, UnpackData *ud)
+DecrError loadHeader(SdcInput *in, Header *hdr, uint32_t hdrSize, UnpackData *ud)
 {
-    void *data = malloc(hdrSize);
-    fread(data,1,hdrSize,f);
-    DecrError err = decryptData(data, &hdrSize, hdr, ud->headerKey, 32);
-    free(data);
-    return err;
+    //read straight into HDR and decrypt in place, nothing past the header is
+    //read, as a stream could not go back to it
+    uint32_t size = getDataOutputSize(hdrSize);
+    size_t bytes = readInput(in, 4, hdr, hdrSize);
+    if(bytes < hdrSize)
+        return DD_DE;
+    memset((uint8_t*)hdr + bytes, 0, size - bytes);
+    StatMark mark;
+    statBegin(STS_DECRYPT, &mark);
+    blowfishDecrypt(&ud->headerBf, hdr, size);
+    statEnd(STS_DECRYPT, &mark, size, size, 0, NULL);
+    return DD_OK;
+}
+
+DecrError decodeFileNames(Header *hdr, uint32_t hdrSize, UnpackData *ud)
+{
+    //file name table follows entries
+    uint64_t start = sizeof(Header) + (uint64_t)sizeof(FileUnion) * hdr->headerSize;
+    if(start + sizeof(FileName) > hdrSize)
+        return DD_DE;
+    FileName *fn = (FileName*)&hdr->files[hdr->headerSize];
+    uint32_t size = getDataOutputSize(fn->fileNameLength);
+    if(start + sizeof(FileName) + size > getDataOutputSize(hdrSize))
+        return DD_DE;
+    StatMark mark;
+    statBegin(STS_DECRYPT, &mark);
+    blowfishDecrypt(&ud->fileNameBf, &fn->fileName, size);
+    statEnd(STS_DECRYPT, &mark, size, size, 0, NULL);
+    return DD_OK;
+}
+
+int inflateAtPoint(z_stream *stream, uint32_t bits, uint8_t previous, const uint8_t *window, uint32_t windowLength)
+{
+    //point is past zlib header of 0xd1, rest of stream is raw deflate
+    int r = inflateReset2(stream, -MAX_WBITS);
+    if(r == Z_OK && bits != 0)
+        r = inflatePrime(stream, bits, previous >> (8 - bits));
+    if(r == Z_OK && windowLength != 0)
+        r = inflateSetDictionary(stream, window, windowLength);
+    return r;
 }
 
 void dosPathToUnix(char* path)
@@ -173,60 +649,3 @@ void unixTimeToStr(char *buffer, size_t bufSize, uint64_t time)
     struct tm *ts = localtime(&time);
     strftime(buffer, bufSize, "%Y/%m/%d %H:%M:%S", ts);
 }
-
-int createDir(char* dir)
-{
-    DIR *f = NULL;
-    if((f = opendir(dir)) == NULL)
-    {
-        if(mkdir(dir,S_IRWXU | S_IRWXG | S_IROTH | S_IWOTH | S_IXOTH) != 0)
-        {
-            //mkdir failed
-            if(errno == ENOENT)
-            {
-                size_t baselen = strlen(dir);
-                char *base = (char*)malloc(baselen + 1);
-                strcpy(base, dir);
-                base = dirname(base);
-                int ret = createDir(base);
-                if(!ret)
-                {
-                    if(mkdir(dir,S_IRWXU | S_IRWXG | S_IROTH | S_IWOTH | S_IXOTH) != 0)
-                    {
-                        // fail
-                        return errno;
-                    }
-                    else
-                    {
-                        return 0;
-                    }
-                }
-            }
-            else
-            {
-                return errno;
-            }
-        }
-    }
-    else
-    {
-        // directory exists
-        closedir(f);
-    }
-    f = NULL;
-    return 0;
-}
-
-void printProgress(uint8_t progress)
-{
-    if(progress > 6)
-        return;
-    int i;
-    char progressbar[7] = "      ";
-    for(i = 0; i < progress; i++)
-    {
-        progressbar[i] = '#';
-    }
-    printf(" [%s]\r", progressbar);
-    fflush(stdout);
-}
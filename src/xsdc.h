@@ -1,3 +1,6 @@
+#ifndef XSDC_H
+#define XSDC_H
+
 #include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -5,20 +8,37 @@
 #include <stdio.h>
 #include <time.h>
 #include <zlib.h>
-#include <mcrypt.h>
 #include <dirent.h>
 #include <sys/stat.h>
 #include <libgen.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "kernels.h"
+#include "stats.h"
+#include "blowfish.h"
+#include "ioring.h"
 
 #define SIG_PLAIN 0xb3
 #define SIG_UNKNOWN 0xc4
 #define SIG_ENCRYPTED 0xb5
 #define SIG_ELARGE 0xd1
 
-#define print_status(fmt, ...) { printf(" [      ] "fmt"\r", ##__VA_ARGS__); fflush(stdout); }
-#define print_ok() { printf(" [  OK  ]\n"); }
-#define print_fail() { printf(" [ FAIL ]\n"); }
-#define print_progress printProgress
+//default size of a slice checksummed by one thread at a time
+#define CRC_SLICE 0x4000000
+
+//mapped container is checksummed in pieces of this size, progress is counted after each
+#define CRC_PIECE 0x1000000
+
+//set on threads whose status lines would interleave with others (batch workers)
+extern __thread int quietOutput;
+
+#define print_status(fmt, ...) { if(!quietOutput) { printf(" [      ] "fmt"\r", ##__VA_ARGS__); fflush(stdout); } }
+#define print_ok() { if(!quietOutput) printf(" [  OK  ]\n"); }
+#define print_fail() { if(!quietOutput) printf(" [ FAIL ]\n"); }
 
 typedef struct __attribute__ ((__packed__))
 {
@@ -81,8 +101,25 @@ typedef struct unpackdata_t
   void *headerKey;
   void *fileNameKey;
   void *unformatted;
+  BlowfishKey headerBf;		//expanded headerKey
+  BlowfishKey fileNameBf;	//expanded fileNameKey
 } UnpackData;
 
+typedef struct sdcinput_t
+{
+  FILE          *file;	//stdio stream, used when container is not mapped
+  uint8_t       *map;	//whole container mapped into memory or NULL
+  int           borrowed;	//map is caller's buffer, it is not unmapped
+  off_t         size;	//size of container in bytes
+  int           stream;	//read strictly in order, no seeks (pipe or stdin)
+  off_t         pos;	//bytes consumed from stream so far
+  off_t         crcStart;	//stream bytes from here on are checksummed, -1 for none
+  uLong         crc;	//crc of checksummed stream bytes consumed so far
+  uint32_t      ioDepth;	//reads of unmapped container kept queued on io_uring,
+				//0 reads with pread
+  _Atomic uint64_t *checked;	//bytes checksummed by countCrc are added to it, may be NULL
+} SdcInput;
+
 typedef enum
 {
   FUS_OK = 0,	//success
@@ -119,19 +156,27 @@ void print_help(Shortness Short,char *name);
 void print_version();
 
 /*
- * xor every byte of a BUFFER by FACTOR
+ * xor every byte of a BUFFER by FACTOR, using fastest kernel supported by cpu
  */
 void xorBuffer(uint8_t factor, unsigned char* buffer, uint32_t bufferSize);
 
 /*
- * transforms edv in format "[int]^^[key2][key1][int]" into UnpackData struct,
- * returns FUS_OK on success and appropriate error on fail
+ * transforms edv in format "[int]^^[key2][key1][int]" into UnpackData struct
+ * and expands both keys, returns FUS_OK on success and appropriate error on fail
  */
 UnpackStatus fillUnpackStruct(UnpackData* unpackData, void* edv);
 
+/*
+ * check format of EDV as fillUnpackStruct does and store its checksum into
+ * CHECKSUM, without expanding keys
+ */
+UnpackStatus edvChecksum(const char *edv, uint32_t *checksum);
+
 /*
  * decrypts data from BUFFER of BUFFERSIZE size in bytes using KEY of length of KEYLENGTH,
- * returns buffer with decrypted data and sets BUFFERSIZE according to its size
+ * returns buffer with decrypted data and sets BUFFERSIZE according to its size;
+ * OUTPUTBUFFER may be the same as BUFFER, key is expanded on every call so
+ * blowfishDecrypt with key from UnpackData should be preferred
  */
 DecrError decryptData(void* buffer, uint32_t* bufferSize, void* outputBuffer, void* key, uint32_t keyLength);
 
@@ -140,15 +185,87 @@ DecrError decryptData(void* buffer, uint32_t* bufferSize, void* outputBuffer, vo
  */
 uint32_t getDataOutputSize(uint32_t inputSize);
 
+/*
+ * open sdc file at PATH as IN, it is mapped into memory unless NOMMAP is set
+ * or file is not mappable (then stdio is used), returns 0 on success or errno
+ */
+int openInput(SdcInput *in, const char *path, int noMmap);
+
+/*
+ * open sdc file already opened as FD as IN, like openInput; FD stays open
+ * after closeInput, returns 0 on success or errno
+ */
+int openInputFd(SdcInput *in, int fd, int noMmap);
+
+/*
+ * use SIZE bytes of container at DATA as IN, they are read in place and have
+ * to stay there until closeInput
+ */
+void openMemory(SdcInput *in, const void *data, size_t size);
+
+/*
+ * open sdc file at PATH (stdin for "-") as non-seekable stream IN; readInput
+ * then only moves forward, skipping bytes before requested offset by reading
+ * them, returns 0 on success or errno
+ */
+int openStream(SdcInput *in, const char *path);
+
+/*
+ * read rest of stream IN up to its end and return crc of all bytes consumed
+ * from in->crcStart on
+ */
+uLong drainStream(SdcInput *in);
+
+/*
+ * unmap and close sdc file opened by openInput, openInputFd or openMemory
+ */
+void closeInput(SdcInput *in);
+
+/*
+ * read up to LENGTH bytes at OFFSET of IN into BUFFER, returns number of bytes read;
+ * on stream OFFSET must not be behind already consumed bytes
+ */
+size_t readInput(SdcInput *in, off_t offset, void *buffer, size_t length);
+
+/*
+ * tell the kernel that LENGTH bytes at OFFSET of mapped IN will be needed soon
+ */
+void adviseInput(SdcInput *in, off_t offset, off_t length);
+
 /*
  * count and return crc of sdc file's data area
  */
-ulong countCrc(FILE *f, uint32_t hdrSize);
+ulong countCrc(SdcInput *in, uint32_t hdrSize);
+
+/*
+ * count crc of sdc file's data area on THREADS threads, each one checksumming
+ * SLICESIZE bytes at a time; result is the same as of countCrc
+ */
+ulong countCrcParallel(SdcInput *in, uint32_t hdrSize, int threads, size_t sliceSize);
 
 /*
- * load sdc file header from current position in F into HDR buffer
+ * update CRC with bytes from START to END (exclusive) of IN and return it
  */
-DecrError loadHeader(FILE* f, Header* hdr, uint32_t hdrSize, UnpackData* ud);
+uLong updateCrc(SdcInput *in, off_t start, off_t end, uLong crc);
+
+/*
+ * load sdc file header following its size field in IN into HDR buffer
+ * of at least getDataOutputSize(HDRSIZE) bytes and decrypt it there
+ */
+DecrError loadHeader(SdcInput *in, Header* hdr, uint32_t hdrSize, UnpackData* ud);
+
+/*
+ * decrypt file name table of decrypted HDR of HDRSIZE bytes in place,
+ * returns DD_DE if table does not fit in header
+ */
+DecrError decodeFileNames(Header *hdr, uint32_t hdrSize, UnpackData *ud);
+
+/*
+ * make STREAM continue inflating at deflate block boundary: block starts with BITS
+ * (0-7) top bits of PREVIOUS byte and WINDOW of WINDOWLENGTH bytes is output
+ * preceding it, as recorded by zlib's zran example; returns Z_OK or zlib error code
+ */
+int inflateAtPoint(z_stream *stream, uint32_t bits, uint8_t previous, const uint8_t *window, uint32_t windowLength);
 
 /*
  * converts MS-DOS path into UNIX path
@@ -169,12 +286,4 @@ uint64_t winTimeToUnix(uint64_t win);
  */
 void unixTimeToStr(char *buffer, size_t bufSize, uint64_t time);
 
-/*
- * create directory, if its root directory does not exist, create it recursively
- */
-int createDir(char* dir);
-
-/*
- * print progress of current task (0-6)
- */
-void printProgress(uint8_t progress);
+#endif
@@ -2,6 +2,18 @@
 #include <stdio.h>
 #include <errno.h>
 #include "../src/xsdc.h"
+#include "../src/extract.h"
+#include "../src/batch.h"
+#include "../src/pack.h"
+#include "../src/index.h"
+#include "../src/inflater.h"
+#include "../src/resume.h"
+#include "../src/libxsdm.h"
+#include "../src/blockcache.h"
+#include "../src/dirtree.h"
+#include "../src/progress.h"
+#include "../src/keyring.h"
+#include "../src/ring.h"
 
 START_TEST (test_check_fillunpackstruct)
 {
@@ -44,6 +56,29 @@ START_TEST (test_check_decryptdata)
 }
 END_TEST
 
+START_TEST (test_check_blowfish)
+{
+    //encrypting plain text of test_check_decryptdata must give its cipher text
+    unsigned char expected[] = {
+        0x42, 0x3f, 0x3b, 0x95, 0xdc, 0x05, 0xa3, 0x55, 0x08, 0xb3, 0x09, 0xc5, 0xb2, 0xc2, 0x11, 0x1a,
+        0x87, 0x02, 0x17, 0x16, 0xfe, 0xcd, 0x6e, 0x11, 0x6c, 0xd3, 0x71, 0x09, 0x4d, 0xc7, 0xb0, 0x04,
+        0x32, 0xb1, 0x36, 0xac, 0xdc, 0x7a, 0x30, 0x0e, 0x58, 0x92, 0xbf, 0xc6, 0x17, 0x58, 0x17, 0x8f,
+        0xfd, 0x66, 0xfb, 0xf7, 0xe2, 0x60, 0xcd, 0x4a, 0xe1, 0xa3, 0xf2, 0x47, 0x6f, 0xd8, 0x1b, 0x02,
+        0x4f, 0x13, 0xcb, 0x6b, 0x52, 0xab, 0x97, 0x2e
+    };
+    unsigned char actual[sizeof(expected)] = "I am chunk of private data encrypted in a target. Can you decrypt me?";
+    char key[] = "IAMAKEYIAMAKEYIAMAKEYIAMAKEYIAMA";
+    BlowfishKey bf;
+    blowfishInit(&bf, key, 32);
+    blowfishEncrypt(&bf, actual, sizeof(actual));
+    ck_assert (memcmp(expected, actual, sizeof(expected)) == 0);
+
+    //decrypting in place goes through 4-lane and single block paths
+    blowfishDecrypt(&bf, actual, sizeof(actual));
+    ck_assert_str_eq ((char*)actual, "I am chunk of private data encrypted in a target. Can you decrypt me?");
+}
+END_TEST
+
 START_TEST (test_check_xorbuffer)
 {
     unsigned char buf[] = {'\x0', '\x80', '\x7f', '\xff', '\0'};
@@ -89,6 +124,1234 @@ START_TEST (test_check_windatetounix)
 }
 END_TEST
 
+START_TEST (test_check_combineentrycrc)
+{
+    //data area: entry 0, gap not read by entry, entry 1 and trailing bytes
+    unsigned char data[300];
+    int i;
+    for(i = 0; i < sizeof(data); i++)
+        data[i] = i * 7;
+    char path[] = "/tmp/check_xsdcXXXXXX";
+    int fd = mkstemp(path);
+    ck_assert_int_ne (fd, -1);
+    uint32_t hdrSize = 0x100;
+    unsigned char *file = (unsigned char*)calloc(1, hdrSize + 4 + sizeof(data));
+    memcpy(file + hdrSize + 4, data, sizeof(data));
+    write(fd, file, hdrSize + 4 + sizeof(data));
+    close(fd);
+
+    SdcInput in;
+    ck_assert_int_eq (openInput(&in, path, 1), 0);
+    SdcEntry entries[2];
+    entries[0].offset = hdrSize + 4;
+    entries[0].crc = crc32(crc32(0L, Z_NULL, 0), data, 100);
+    entries[0].crcLength = 100;
+    entries[1].offset = hdrSize + 4 + 120;
+    entries[1].crc = crc32(crc32(0L, Z_NULL, 0), data + 120, 150);
+    entries[1].crcLength = 150;
+    uLong crc = combineEntryCrc(&in, entries, 2, hdrSize + 4);
+    ck_assert_int_eq (crc, crc32(crc32(0L, Z_NULL, 0), data, sizeof(data)));
+    ck_assert_int_eq (crc, countCrc(&in, hdrSize));
+    closeInput(&in);
+    unlink(path);
+    free(file);
+}
+END_TEST
+
+START_TEST (test_check_countcrcparallel)
+{
+    unsigned char data[1000];
+    int i;
+    for(i = 0; i < sizeof(data); i++)
+        data[i] = i * 13;
+    char path[] = "/tmp/check_xsdcXXXXXX";
+    int fd = mkstemp(path);
+    ck_assert_int_ne (fd, -1);
+    write(fd, data, sizeof(data));
+    close(fd);
+
+    //header of 0x10 bytes, slices do not divide data area evenly
+    uLong expected = crc32(crc32(0L, Z_NULL, 0), data + 0x14, sizeof(data) - 0x14);
+    int noMmap;
+    for(noMmap = 0; noMmap <= 1; noMmap++)
+    {
+        SdcInput in;
+        ck_assert_int_eq (openInput(&in, path, noMmap), 0);
+        ck_assert_int_eq (countCrc(&in, 0x10), expected);
+        ck_assert_int_eq (countCrcParallel(&in, 0x10, 3, 7), expected);
+        ck_assert_int_eq (countCrcParallel(&in, 0x10, 4, 0x100), expected);
+        closeInput(&in);
+    }
+    unlink(path);
+}
+END_TEST
+
+START_TEST (test_check_output)
+{
+    unsigned char data[3 * OUTPUT_ALIGN + 123];
+    int i;
+    for(i = 0; i < sizeof(data); i++)
+        data[i] = i * 11;
+    char path[] = "/tmp/check_xsdcXXXXXX";
+    close(mkstemp(path));
+
+    int direct;
+    for(direct = 0; direct <= 1; direct++)
+    {
+        //preallocated more than will be written, buffer smaller than data
+        Output out;
+        uint8_t *buffer = allocOutputBuffer(2 * OUTPUT_ALIGN);
+        ck_assert_int_eq (openOutput(&out, path, sizeof(data) + 5000, buffer, 2 * OUTPUT_ALIGN, direct), 0);
+        size_t avail;
+        uint8_t *space = outputSpace(&out, &avail);
+        ck_assert_int_eq (avail, 2 * OUTPUT_ALIGN);
+        memcpy(space, data, 100);
+        ck_assert_int_eq (commitOutput(&out, 100), 0);
+        ck_assert_int_eq (writeOutput(&out, data + 100, sizeof(data) - 100), 0);
+        ck_assert_int_eq (closeOutput(&out), 0);
+        free(buffer);
+
+        unsigned char check[sizeof(data) + 1];
+        FILE *f = fopen(path, "r");
+        ck_assert_int_eq (fread(check, 1, sizeof(check), f), sizeof(data));
+        fclose(f);
+        ck_assert_int_eq (memcmp(check, data, sizeof(data)), 0);
+    }
+    unlink(path);
+}
+END_TEST
+
+static void *ringProducer(void *arg)
+{
+    Ring *ring = (Ring*)arg;
+    intptr_t i;
+    for(i = 1; i <= 200; i++)
+    {
+        //consumer runs dry and has to sleep now and then
+        if(i % 50 == 0)
+            usleep(20000);
+        ringPush(ring, (void*)i);
+    }
+    return NULL;
+}
+
+static void *ringConsumer(void *arg)
+{
+    return ringPop((Ring*)arg);
+}
+
+START_TEST (test_check_ring)
+{
+    _Atomic int abort;
+    atomic_init(&abort, 0);
+    Ring ring;
+    ck_assert_int_eq (ringInit(&ring, 3, &abort), 0);
+    ck_assert_uint_eq (ring.mask, 3);
+
+    //items arrive in order, also across parked waits on both sides
+    pthread_t thread;
+    pthread_create(&thread, NULL, ringProducer, &ring);
+    intptr_t i;
+    for(i = 1; i <= 200; i++)
+    {
+        if(i == 20)
+            usleep(20000);
+        ck_assert_int_eq ((intptr_t)ringPop(&ring), i);
+    }
+    pthread_join(thread, NULL);
+    ck_assert_ptr_eq (ringTryPop(&ring), NULL);
+
+    //abort wakes sleeping consumer
+    void *item = &ring;
+    pthread_create(&thread, NULL, ringConsumer, &ring);
+    usleep(20000);
+    atomic_store(&abort, 1);
+    ringWake(&ring);
+    pthread_join(thread, &item);
+    ck_assert_ptr_eq (item, NULL);
+    ringFree(&ring);
+}
+END_TEST
+
+START_TEST (test_check_ioring)
+{
+    IoRing ring;
+    int r = initRing(&ring, 2);
+    if(r == ENOSYS)
+        return;
+    ck_assert_int_eq (r, 0);
+
+    //more blocks than are queued at once, last one short
+    size_t size = 5 * IORING_BLOCK + 777;
+    uint8_t *data = (uint8_t*)malloc(size);
+    size_t i;
+    for(i = 0; i < size; i++)
+        data[i] = i * 7 + (i >> 12);
+    char path[] = "/tmp/check_xsdcXXXXXX";
+    close(mkstemp(path));
+
+    //full buffers are queued, the rest is written by close
+    Output out;
+    ck_assert_int_eq (openOutput(&out, path, size, NULL, 0, 0), 0);
+    ringOutput(&out, &ring);
+    ck_assert_ptr_eq (out.ring, &ring);
+    ck_assert_int_eq (writeOutput(&out, data, size), 0);
+    ck_assert_int_eq (closeOutput(&out), 0);
+    ck_assert_ptr_eq (out.ring, NULL);
+
+    //range past end of file ends with it
+    int fd = open(path, O_RDONLY);
+    ck_assert_int_ge (fd, 0);
+    startRingRead(&ring, fd, 100, size + IORING_BLOCK);
+    const uint8_t *block;
+    ssize_t bytes;
+    size_t pos = 100;
+    while((bytes = nextRingRead(&ring, &block)) > 0)
+    {
+        ck_assert_int_eq (memcmp(block, data + pos, bytes), 0);
+        pos += bytes;
+    }
+    ck_assert_int_eq (bytes, 0);
+    ck_assert_uint_eq (pos, size);
+    stopRingRead(&ring);
+
+    //reading by checksum gives the same as pread
+    SdcInput in;
+    ck_assert_int_eq (openInput(&in, path, 1), 0);
+    uLong sync = updateCrc(&in, 4, size, crc32(0L, Z_NULL, 0));
+    in.ioDepth = 3;
+    ck_assert_uint_eq (updateCrc(&in, 4, size, crc32(0L, Z_NULL, 0)), sync);
+    ck_assert_uint_eq (countCrcParallel(&in, 0, 2, IORING_BLOCK + 5), sync);
+    closeInput(&in);
+
+    close(fd);
+    freeRing(&ring);
+    unlink(path);
+    free(data);
+}
+END_TEST
+
+static unsigned char packData[2][5000];
+
+static size_t packSource(void *arg, uint32_t index, uint8_t *buffer, size_t length)
+{
+    size_t *done = (size_t*)arg;
+    memcpy(buffer, packData[index] + done[index], length);
+    done[index] += length;
+    return length;
+}
+
+START_TEST (test_check_pack)
+{
+    int i;
+    for(i = 0; i < sizeof(packData[0]); i++)
+    {
+        packData[0][i] = i % 7;
+        packData[1][i] = (i * 2654435761u) >> 13;
+    }
+    PackEntry entries[2] = {{"dir/a.txt", sizeof(packData[0]), 0}, {"b.bin", 3333, 0}};
+    uint32_t signatures[] = {SIG_ENCRYPTED, SIG_ELARGE};
+    int variant;
+    for(variant = 0; variant < 2; variant++)
+    {
+        char path[] = "/tmp/check_xsdcXXXXXX";
+        close(mkstemp(path));
+        PackOptions opt;
+        initPackOptions(&opt, variant);
+        opt.signature = signatures[variant];
+        opt.gap = 19;
+        opt.trail = 5;
+        size_t done[2] = {0, 0};
+        uLong crc;
+        ck_assert_int_eq (packContainer(path, &opt, entries, 2, packSource, done, &crc), 0);
+
+        //unpack it the way xsdm does
+        char key[96];
+        formatKey(key, &opt, crc);
+        UnpackData ud;
+        ck_assert_int_eq (fillUnpackStruct(&ud, key), FUS_OK);
+        ck_assert_int_eq (ud.checksum, crc);
+        SdcInput in;
+        ck_assert_int_eq (openInput(&in, path, variant), 0);
+        uint32_t hdrSize;
+        readInput(&in, 0, &hdrSize, 4);
+        ck_assert_int_eq (countCrc(&in, hdrSize), crc);
+        Header *hdr = (Header*)malloc(getDataOutputSize(hdrSize));
+        ck_assert_int_eq (loadHeader(&in, hdr, hdrSize, &ud), DD_OK);
+        ck_assert_int_eq (hdr->headerSignature, opt.signature);
+        ck_assert_int_eq (hdr->headerSize, 2);
+        ck_assert_int_eq (decodeFileNames(hdr, hdrSize, &ud), DD_OK);
+        SdcEntry sdcEntries[2];
+        fillEntries(sdcEntries, hdr, hdrSize, (FileName*)&hdr->files[2]);
+        ck_assert_str_eq (sdcEntries[0].name, "dir/a.txt");
+        ck_assert_str_eq (sdcEntries[1].name, "b.bin");
+        ck_assert_int_eq (sdcEntries[1].status, EX_PENDING);
+
+        Extractor ex;
+        memset(&ex, 0, sizeof(ex));
+        ex.in = &in;
+        ex.signature = hdr->headerSignature;
+        ex.xorVal = ud.xorVal % 0x100;
+        ExtractState st;
+        ck_assert_int_eq (initExtractState(&st, ex.signature), Z_OK);
+        int e;
+        for(e = 0; e < 2; e++)
+        {
+            char out[] = "/tmp/check_xsdcXXXXXX";
+            close(mkstemp(out));
+            sdcEntries[e].outFile = out;
+            ck_assert_int_eq (extractEntry(&ex, &st, &sdcEntries[e]), EX_OK);
+            unsigned char check[sizeof(packData[0]) + 1];
+            FILE *f = fopen(out, "r");
+            ck_assert_int_eq (fread(check, 1, sizeof(check), f), entries[e].size);
+            fclose(f);
+            ck_assert_int_eq (memcmp(check, packData[e], entries[e].size), 0);
+            unlink(out);
+        }
+
+        //verification writes nothing and wants exact size
+        ex.discard = 1;
+        SdcEntry probe = sdcEntries[0];
+        probe.outFile = "/tmp/check_xsdc_never_created";
+        ck_assert_int_eq (extractEntry(&ex, &st, &probe), EX_OK);
+        ck_assert_int_ne (access(probe.outFile, F_OK), 0);
+        probe.fileSize = sdcEntries[0].fileSize - 1;
+        ck_assert_int_eq (extractEntry(&ex, &st, &probe), EX_SIZE);
+        ck_assert_int_eq (probe.error, EFBIG);
+        //same on worker threads, where undersized entry is not the first one
+        SdcEntry probes[2] = {sdcEntries[1], probe};
+        probes[0].outFile = probes[1].outFile = "/tmp/check_xsdc_never_created";
+        probes[1].error = 0;
+        ck_assert_int_eq (extractParallel(&ex, probes, 2, 2, NULL), 1);
+        ck_assert_int_eq (probes[0].status, EX_OK);
+        ck_assert_int_eq (probes[1].status, EX_SIZE);
+        ck_assert_int_eq (probes[1].error, EFBIG);
+        //entries after failure are not started on single thread
+        probes[0] = probe;
+        probes[1] = sdcEntries[1];
+        probes[1].outFile = "/tmp/check_xsdc_never_created";
+        probes[1].status = EX_PENDING;
+        ck_assert_int_eq (extractParallel(&ex, probes, 2, 1, NULL), 1);
+        ck_assert_int_eq (probes[0].status, EX_SIZE);
+        ck_assert_int_eq (probes[1].status, EX_PENDING);
+        probe.fileSize = sdcEntries[0].fileSize + 1;
+        ck_assert_int_eq (extractEntry(&ex, &st, &probe), EX_EOF);
+        probe.fileSize = sdcEntries[0].fileSize;
+        probe.compressedSize = sdcEntries[0].compressedSize / 2;
+        ck_assert_int_eq (extractEntry(&ex, &st, &probe), EX_EOF);
+        freeExtractState(&st);
+        free(hdr);
+        closeInput(&in);
+        unlink(path);
+    }
+}
+END_TEST
+
+static size_t libLive;
+
+static void *libAlloc(void *opaque, size_t size)
+{
+    size_t *block = (size_t*)malloc(size + sizeof(size_t) * 2);
+    if(block == NULL)
+        return NULL;
+    __sync_fetch_and_add((size_t*)opaque, 1);
+    return block + 2;
+}
+
+static void libRelease(void *opaque, void *ptr)
+{
+    __sync_fetch_and_sub((size_t*)opaque, 1);
+    free((size_t*)ptr - 2);
+}
+
+START_TEST (test_check_libxsdm)
+{
+    int i;
+    for(i = 0; i < sizeof(packData[0]); i++)
+    {
+        packData[0][i] = i % 7;
+        packData[1][i] = (i * 2654435761u) >> 13;
+    }
+    PackEntry entries[2] = {{"dir\\a.txt", sizeof(packData[0]), 1234567890}, {"b.bin", 3333, 0}};
+    char path[] = "/tmp/check_xsdcXXXXXX";
+    close(mkstemp(path));
+    PackOptions opt;
+    initPackOptions(&opt, 3);
+    opt.signature = SIG_ELARGE;
+    size_t done[2] = {0, 0};
+    uLong crc;
+    ck_assert_int_eq (packContainer(path, &opt, entries, 2, packSource, done, &crc), 0);
+    char key[96];
+    formatKey(key, &opt, crc);
+
+    FILE *f = fopen(path, "r");
+    fseek(f, 0, SEEK_END);
+    size_t size = ftell(f);
+    uint8_t *image = (uint8_t*)malloc(size);
+    fseek(f, 0, SEEK_SET);
+    ck_assert_int_eq (fread(image, 1, size, f), size);
+    fclose(f);
+
+    XsdmAllocator allocator = {libAlloc, libRelease, &libLive};
+    int way;
+    for(way = 0; way < 3; way++)
+    {
+        XsdmArchive *ar;
+        int fd = -1;
+        if(way == 0)
+            ck_assert_int_eq (xsdmOpenPath(&ar, path, key, &allocator), 0);
+        else if(way == 1)
+        {
+            fd = open(path, O_RDONLY);
+            ck_assert_int_eq (xsdmOpenFd(&ar, fd, key, &allocator), 0);
+            close(fd);
+        }
+        else
+            ck_assert_int_eq (xsdmOpenMemory(&ar, image, size, key, &allocator), 0);
+        ck_assert_uint_gt (libLive, 0);
+        ck_assert_int_eq (xsdmVerify(ar), 0);
+        ck_assert_uint_eq (xsdmEntryCount(ar), 2);
+
+        XsdmEntryInfo info;
+        ck_assert_int_eq (xsdmEntryInfo(ar, 0, &info), 0);
+        ck_assert_str_eq (info.name, "dir/a.txt");
+        ck_assert_uint_eq (info.size, sizeof(packData[0]));
+        ck_assert_int_eq (info.modificationTime, 1234567890);
+        ck_assert_int_eq (xsdmEntryInfo(ar, 2, &info), ERANGE);
+        uint32_t index;
+        ck_assert_int_eq (xsdmFindEntry(ar, "b.bin", &index), 0);
+        ck_assert_uint_eq (index, 1);
+        ck_assert_int_eq (xsdmFindEntry(ar, "c.bin", &index), ENOENT);
+
+        //odd sized reads, two readers of one archive at once
+        XsdmReader *first, *second;
+        ck_assert_int_eq (xsdmOpenEntry(ar, 0, &first), 0);
+        ck_assert_int_eq (xsdmOpenEntry(ar, 1, &second), 0);
+        uint8_t buffer[sizeof(packData[0]) + 10];
+        size_t got[2] = {0, 0};
+        ssize_t bytes = 1;
+        while(bytes > 0)
+        {
+            bytes = xsdmRead(first, buffer + got[0], 77);
+            ck_assert_int_ge (bytes, 0);
+            got[0] += bytes;
+        }
+        ck_assert_uint_eq (got[0], sizeof(packData[0]));
+        ck_assert_int_eq (memcmp(buffer, packData[0], got[0]), 0);
+        got[1] = xsdmRead(second, buffer, sizeof(buffer));
+        ck_assert_uint_eq (got[1], 3333);
+        ck_assert_int_eq (memcmp(buffer, packData[1], got[1]), 0);
+        ck_assert_int_eq (xsdmRead(second, buffer, sizeof(buffer)), 0);
+        xsdmCloseEntry(first);
+        xsdmCloseEntry(second);
+        xsdmClose(ar);
+        ck_assert_uint_eq (libLive, 0);
+    }
+
+    //wrong key, damaged data
+    XsdmArchive *ar;
+    ck_assert_int_eq (xsdmOpenMemory(&ar, image, size, "nonsense", &allocator), EINVAL);
+    ck_assert_ptr_eq (ar, NULL);
+    char other[96];
+    initPackOptions(&opt, 4);
+    opt.signature = SIG_ELARGE;
+    formatKey(other, &opt, crc);
+    ck_assert_int_eq (xsdmOpenMemory(&ar, image, size, other, &allocator), EBADMSG);
+    ck_assert_uint_eq (libLive, 0);
+    image[size - 100] ^= 0xff;
+    ck_assert_int_eq (xsdmOpenMemory(&ar, image, size, key, NULL), 0);
+    ck_assert_int_eq (xsdmVerify(ar), EBADMSG);
+    XsdmReader *rd;
+    ck_assert_int_eq (xsdmOpenEntry(ar, 1, &rd), 0);
+    uint8_t buffer[4000];
+    ck_assert_int_eq (xsdmRead(rd, buffer, sizeof(buffer)), -EBADMSG);
+    ck_assert_int_eq (xsdmRead(rd, buffer, sizeof(buffer)), -EBADMSG);
+    xsdmCloseEntry(rd);
+    xsdmClose(ar);
+    free(image);
+    unlink(path);
+}
+END_TEST
+
+START_TEST (test_check_selectentries)
+{
+    char names[5][16] = {"a/x.txt", "a/b/y.bin", "z.txt", "b/x.txt", "a.txt"};
+    SdcEntry entries[5];
+    int i;
+    memset(entries, 0, sizeof(entries));
+    for(i = 0; i < 5; i++)
+    {
+        entries[i].name = names[i];
+        entries[i].offset = i * 10;
+    }
+
+    char *patterns[] = {"a/*", "*x.txt", "none"};
+    uint32_t hits[3];
+    uint32_t count = selectEntries(entries, 5, patterns, 3, hits);
+    ck_assert_uint_eq (count, 3);
+    ck_assert_str_eq (entries[0].name, "a/x.txt");
+    ck_assert_str_eq (entries[1].name, "a/b/y.bin");
+    ck_assert_str_eq (entries[2].name, "b/x.txt");
+    ck_assert_int_eq (entries[2].offset, 30);
+    ck_assert_uint_eq (hits[0], 2);
+    ck_assert_uint_eq (hits[1], 2);
+    ck_assert_uint_eq (hits[2], 0);
+}
+END_TEST
+
+START_TEST (test_check_dirtree)
+{
+    char root[] = "/tmp/check_xsdcXXXXXX";
+    ck_assert_ptr_ne (mkdtemp(root), NULL);
+    char names[6][16] = {"a/x.txt", "a/b/y.bin", "a/b/z.bin", "top.txt", "c//d/w", "a/./v"};
+    SdcEntry entries[6];
+    int i;
+    memset(entries, 0, sizeof(entries));
+    for(i = 0; i < 6; i++)
+        entries[i].name = names[i];
+
+    //every directory once, outputs relative to open directories
+    DirTree tree;
+    ck_assert_int_eq (buildDirTree(&tree, root, entries, 6, ".part", 1), 0);
+    ck_assert_uint_eq (tree.count, 7);
+    char path[64];
+    sprintf(path, "%s/a/b/y.bin.part", root);
+    ck_assert_str_eq (entries[1].outFile, path);
+    ck_assert_str_eq (entries[1].outName, "y.bin.part");
+    ck_assert_str_eq (entries[4].outName, "w.part");
+    ck_assert_str_eq (entries[5].outName, "./v.part");
+    ck_assert_int_eq (entries[1].dirFd, entries[2].dirFd);
+    ck_assert_int_eq (entries[0].dirFd, entries[5].dirFd);
+    for(i = 0; i < 6; i++)
+    {
+        ck_assert_int_eq (tree.dirs[i].error, 0);
+        Output out;
+        ck_assert_int_eq (openOutputAt(&out, entries[i].dirFd, entryOutput(&entries[i]), 0, NULL, 0, 0), 0);
+        ck_assert_int_eq (writeOutput(&out, names[i], 1), 0);
+        ck_assert_int_eq (closeOutput(&out), 0);
+        ck_assert_int_eq (finishOutput(&entries[i], ".part", i != 3), 0);
+    }
+    sprintf(path, "%s/c/d/w", root);
+    ck_assert_int_eq (access(path, F_OK), 0);
+    sprintf(path, "%s/top.txt.part", root);
+    ck_assert_int_ne (access(path, F_OK), 0);
+
+    //file in place of directory fails only entries below it
+    freeDirTree(&tree);
+    char clash[2][16] = {"top.txt/e", "a/b/y.bin"};
+    entries[0].name = clash[0];
+    entries[1].name = clash[1];
+    sprintf(path, "%s/top.txt", root);
+    close(creat(path, 0600));
+    ck_assert_int_eq (buildDirTree(&tree, root, entries, 2, NULL, 1), 0);
+    ck_assert_int_eq (tree.dirs[1].error, ENOTDIR);
+    ck_assert_int_eq (tree.dirs[3].error, 0);
+    sprintf(path, "%s/a/b/y.bin", root);
+    ck_assert_str_eq (entries[1].outFile, path);
+    freeDirTree(&tree);
+
+    char command[64];
+    sprintf(command, "rm -rf %s", root);
+    ck_assert_int_eq (system(command), 0);
+}
+END_TEST
+
+START_TEST (test_check_index)
+{
+    uint8_t raw[0x140];
+    uint32_t i;
+    for(i = 0; i < sizeof(raw); i++)
+        raw[i] = i * 7;
+    Header *hdr = (Header*)raw;
+
+    IndexKey key;
+    memset(&key, 0, sizeof(key));
+    key.inode = 42;
+    key.size = 0x100000;
+    key.keyHash = 0x1234;
+
+    char path[] = "/tmp/check_xsdcXXXXXX";
+    close(mkstemp(path));
+    ck_assert_int_eq (saveIndex(path, &key, hdr, sizeof(raw), 1, 0xdeadbeef), 0);
+
+    uint32_t size = 0;
+    int crcKnown = 0;
+    uLong crc = 0;
+    Header *loaded = loadIndex(path, &key, &size, &crcKnown, &crc);
+    ck_assert_ptr_ne (loaded, NULL);
+    ck_assert_uint_eq (size, sizeof(raw));
+    ck_assert_int_eq (crcKnown, 1);
+    ck_assert_uint_eq (crc, 0xdeadbeef);
+    ck_assert_int_eq (memcmp(loaded, raw, sizeof(raw)), 0);
+    free(loaded);
+
+    //changed container or key makes index stale
+    IndexKey other = key;
+    other.mtimeNsec = 1;
+    ck_assert_ptr_eq (loadIndex(path, &other, &size, &crcKnown, &crc), NULL);
+    other = key;
+    other.keyHash = 0x4321;
+    ck_assert_ptr_eq (loadIndex(path, &other, &size, &crcKnown, &crc), NULL);
+
+    //damaged index is ignored
+    FILE *f = fopen(path, "r+");
+    fseek(f, sizeof(IndexHeader) + 5, SEEK_SET);
+    fputc(raw[5] ^ 0xff, f);
+    fclose(f);
+    ck_assert_ptr_eq (loadIndex(path, &key, &size, &crcKnown, &crc), NULL);
+    truncate(path, sizeof(IndexHeader) + 10);
+    ck_assert_ptr_eq (loadIndex(path, &key, &size, &crcKnown, &crc), NULL);
+    unlink(path);
+}
+END_TEST
+
+START_TEST (test_check_inflater)
+{
+    size_t length = 300000, i;
+    uint8_t *plain = (uint8_t*)malloc(length);
+    for(i = 0; i < length; i++)
+        plain[i] = (i % 251) ^ (i / 4096);
+
+    //zlib wrapped for 0xd1, raw deflate for the rest
+    uLongf wrappedLength = compressBound(length);
+    uint8_t *wrapped = (uint8_t*)malloc(wrappedLength);
+    ck_assert_int_eq (compress2(wrapped, &wrappedLength, plain, length, 6), Z_OK);
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    ck_assert_int_eq (deflateInit2(&zs, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY), Z_OK);
+    size_t rawLength = deflateBound(&zs, length);
+    uint8_t *raw = (uint8_t*)malloc(rawLength + 16);
+    zs.next_in = plain;
+    zs.avail_in = length;
+    zs.next_out = raw;
+    zs.avail_out = rawLength;
+    ck_assert_int_eq (deflate(&zs, Z_FINISH), Z_STREAM_END);
+    rawLength = zs.total_out;
+    deflateEnd(&zs);
+    memset(raw + rawLength, 0xa5, 16);
+
+    uint8_t *out = (uint8_t*)malloc(length + 16);
+    int b;
+    for(b = 0; inflateBackendAt(b) != NULL; b++)
+    {
+        ck_assert_int_eq (selectInflateBackend(inflateBackendAt(b)), 0);
+        Inflater inf;
+        ck_assert_int_eq (initInflater(&inf, SIG_ELARGE), Z_OK);
+        memset(out, 0, length);
+        ck_assert_int_eq (inflateWhole(&inf, wrapped, wrappedLength, out, length), Z_OK);
+        ck_assert_int_eq (memcmp(out, plain, length), 0);
+        //the same inflater is reused for next entry
+        ck_assert_int_eq (inflateWhole(&inf, wrapped, wrappedLength, out, length), Z_OK);
+        freeInflater(&inf);
+
+        ck_assert_int_eq (initInflater(&inf, SIG_ENCRYPTED), Z_OK);
+        memset(out, 0, length);
+        ck_assert_int_eq (inflateWhole(&inf, raw, rawLength, out, length), Z_OK);
+        ck_assert_int_eq (memcmp(out, plain, length), 0);
+        //bytes past stream end are ignored, size has to match exactly
+        ck_assert_int_eq (inflateWhole(&inf, raw, rawLength + 16, out, length), Z_OK);
+        ck_assert_int_ne (inflateWhole(&inf, raw, rawLength, out, length - 1), Z_OK);
+        ck_assert_int_ne (inflateWhole(&inf, raw, rawLength, out, length + 16), Z_OK);
+        ck_assert_int_ne (inflateWhole(&inf, raw, rawLength / 2, out, length), Z_OK);
+        freeInflater(&inf);
+    }
+    ck_assert_int_eq (selectInflateBackend("none"), ENOENT);
+    selectInflateBackend(inflateBackendAt(0));
+    free(plain);
+    free(wrapped);
+    free(raw);
+    free(out);
+}
+END_TEST
+
+START_TEST (test_check_stats)
+{
+    EntryStats es;
+    memset(&es, 0, sizeof(es));
+    StatMark mark;
+    enableStats();
+    statBegin(STS_INFLATE, &mark);
+    ck_assert_int_ne (mark.sampled, 0);
+    statEnd(STS_INFLATE, &mark, 10, 40, 0, &es);
+    //cpu time of following calls of the same stage is not read until interval passes
+    statBegin(STS_INFLATE, &mark);
+    ck_assert_int_eq (mark.sampled, 0);
+    statEnd(STS_INFLATE, &mark, 0, 0, 0, &es);
+    statBegin(STS_WRITE, &mark);
+    ck_assert_int_ne (mark.sampled, 0);
+    statEnd(STS_WRITE, &mark, 40, 40, 3, &es);
+    statEntry("c.sdc", "dir/\"quoted\"", 10, 40, 0, &es);
+
+    char path[] = "/tmp/check_xsdcXXXXXX";
+    close(mkstemp(path));
+    FILE *f = fopen(path, "w");
+    printStats(f, SF_JSON, 1.0);
+    fclose(f);
+    char text[0x2000];
+    f = fopen(path, "r");
+    size_t length = fread(text, 1, sizeof(text) - 1, f);
+    fclose(f);
+    text[length] = '\0';
+    unlink(path);
+    statsEnabled = 0;
+
+    ck_assert_ptr_ne (strstr(text, "\"inflate\": {\"wall_ns\": "), NULL);
+    ck_assert_ptr_ne (strstr(text, "\"bytes_in\": 40, \"bytes_out\": 40, \"calls\": 1, \"syscalls\": 3"), NULL);
+    ck_assert_ptr_ne (strstr(text, "\"name\": \"dir/\\\"quoted\\\"\""), NULL);
+}
+END_TEST
+
+static int progressItems[4];
+static int progressReported = 0;
+static pthread_t progressThread;
+
+static void recordProgress(void *item)
+{
+    progressItems[progressReported++] = *(int*)item;
+    progressThread = pthread_self();
+}
+
+START_TEST (test_check_keyring)
+{
+    char path[] = "/tmp/check_xsdcXXXXXX";
+    int fd = mkstemp(path);
+    const char *text =
+        "# export\n"
+        "123^^0123456789qWeRtYuIoPaSdFgHjKlZxCcXzLkJhGfDsApOiUyTrEwQ0987654321666\n"
+        "\n"
+        "renamed.sdc\t4294967295^^0123456789qWeRtYuIoPaSdFgHjKlZxCcXzLkJhGfDsApOiUyTrEwQ098765432117\r\n"
+        "not a key\n"
+        "123^^0123456789qWeRtYuIoPaSdFgHjKlZxCcXzLkJhGfDsApOiUyTrEwQ0987654321999";
+    ck_assert_int_eq (write(fd, text, strlen(text)), strlen(text));
+    close(fd);
+
+    Keyring ring;
+    ck_assert_int_eq (loadKeyring(&ring, path), 0);
+    unlink(path);
+    ck_assert_uint_eq (ring.count, 3);
+    ck_assert_uint_eq (ring.rejected, 1);
+
+    uint32_t matches = 0;
+    const char *key = findKey(&ring, 4294967295u, &matches);
+    ck_assert_ptr_ne (key, NULL);
+    ck_assert_uint_eq (matches, 1);
+    UnpackData ud;
+    ck_assert_int_eq (fillUnpackStruct(&ud, (void*)key), FUS_OK);
+    ck_assert_int_eq (ud.xorVal, 17);
+
+    //first of keys with the same checksum is taken
+    key = findKey(&ring, 123, &matches);
+    ck_assert_uint_eq (matches, 2);
+    ck_assert_int_eq (fillUnpackStruct(&ud, (void*)key), FUS_OK);
+    ck_assert_int_eq (ud.xorVal, 666);
+    ck_assert_ptr_eq (findKey(&ring, 124, NULL), NULL);
+    freeKeyring(&ring);
+    ck_assert_int_eq (loadKeyring(&ring, path), ENOENT);
+}
+END_TEST
+
+START_TEST (test_check_progress)
+{
+    ck_assert_int_eq (progressMode("lines"), PM_LINES);
+    ck_assert_int_eq (progressMode("off"), PM_OFF);
+    ck_assert_int_eq (progressMode("dots"), -1);
+
+    //nothing is counted while reporter is not running
+    ck_assert_ptr_eq (progressEntry("a", 100), NULL);
+    ck_assert_int_eq (startProgress(PM_LINES, "Testing", 300, recordProgress), 0);
+    ProgressSlot *slot = progressEntry("a", 100);
+    ck_assert_ptr_ne (slot, NULL);
+    progressAdd(slot, 60);
+    progressAdd(NULL, 40);
+    ck_assert_uint_eq (atomic_load(progressCounter()), 100);
+    ck_assert_uint_eq (atomic_load(&slot->done), 60);
+    progressEntryDone(slot);
+    ck_assert_ptr_eq (progressEntry("b", 200), slot);
+
+    //items are reported in order on reporter thread
+    int items[3] = {7, 8, 9};
+    int i;
+    for(i = 0; i < 3; i++)
+        postProgress(&items[i]);
+    stopProgress();
+    ck_assert_int_eq (progressEnabled, 0);
+    ck_assert_int_eq (progressReported, 3);
+    ck_assert_int_eq (progressItems[0], 7);
+    ck_assert_int_eq (progressItems[2], 9);
+    ck_assert (!pthread_equal(progressThread, pthread_self()));
+}
+END_TEST
+
+/*
+ * byte POS of entry too large to be inflated in one call, compresses about 2:1
+ */
+static uint8_t resumeByte(uint64_t pos)
+{
+    uint64_t x = (pos / 3 + 1) * 0x9e3779b97f4a7c15ULL;
+    return "abcdefghijklmnop"[(x >> 59) & 0xf];
+}
+
+static size_t resumeSource(void *arg, uint32_t index, uint8_t *buffer, size_t length)
+{
+    uint64_t *done = (uint64_t*)arg;
+    size_t i;
+    for(i = 0; i < length; i++)
+        buffer[i] = resumeByte(*done + i);
+    *done += length;
+    return length;
+}
+
+START_TEST (test_check_resume)
+{
+    IndexKey key;
+    memset(&key, 0, sizeof(key));
+    key.inode = 7;
+    key.keyHash = 0x5678;
+    char path[] = "/tmp/check_xsdcXXXXXX";
+    close(mkstemp(path));
+
+    //state survives save and load
+    ResumeState rs, loaded;
+    ck_assert_int_eq (initResume(&rs, path, &key, 10, 1000), 0);
+    resumeFinish(&rs, 3, 100);
+    resumeCrc(&rs, 0xabcdef);
+    Checkpoint *point = (Checkpoint*)calloc(1, sizeof(Checkpoint));
+    point->entry = 5;
+    point->bits = 3;
+    point->input = 12345;
+    point->output = 67890;
+    point->windowLength = RESUME_WINDOW;
+    point->window[RESUME_WINDOW - 1] = 0x5a;
+    ck_assert_int_eq (resumeCheckpoint(&rs, point), 0);
+    ck_assert_int_eq (initResume(&loaded, path, &key, 10, 1000), 0);
+    ck_assert_int_eq (loadResume(&loaded), 0);
+    ck_assert_int_eq (loaded.header.crcKnown, 1);
+    ck_assert_uint_eq (loaded.header.crc, 0xabcdef);
+    ck_assert_int_ne (resumeDone(&loaded, 3), 0);
+    ck_assert_int_eq (resumeDone(&loaded, 5), 0);
+    memset(point, 0, sizeof(Checkpoint));
+    ck_assert_int_ne (resumePoint(&loaded, 5, point), 0);
+    ck_assert_uint_eq (point->input, 12345);
+    ck_assert_uint_eq (point->output, 67890);
+    ck_assert_uint_eq (point->window[RESUME_WINDOW - 1], 0x5a);
+    ck_assert_int_eq (resumePoint(&loaded, 4, point), 0);
+    resumeFinish(&loaded, 5, 100);
+    ck_assert_int_eq (resumePoint(&loaded, 5, point), 0);
+    freeResume(&loaded);
+
+    //other container or key starts over, save killed midway leaves nothing behind
+    key.keyHash++;
+    char stale[sizeof(path) + 7];
+    sprintf(stale, "%s.Ab3dE9", path);
+    close(open(stale, O_CREAT | O_WRONLY, 0600));
+    ck_assert_int_eq (initResume(&loaded, path, &key, 10, 1000), 0);
+    ck_assert_int_eq (loadResume(&loaded), ENOENT);
+    ck_assert_int_ne (access(stale, F_OK), 0);
+    freeResume(&loaded);
+    freeResume(&rs);
+    key.keyHash--;
+
+    //entry cut short leaves checkpoints, whole one goes on from the last of them
+    uint32_t signatures[] = {SIG_ENCRYPTED, SIG_ELARGE};
+    int variant;
+    for(variant = 0; variant < 2; variant++)
+    {
+        PackEntry entry = {"big.txt", INFLATE_WHOLE_MAX + 0x280000, 0};
+        char sdcPath[] = "/tmp/check_xsdcXXXXXX";
+        close(mkstemp(sdcPath));
+        PackOptions opt;
+        initPackOptions(&opt, variant);
+        opt.signature = signatures[variant];
+        uint64_t done = 0;
+        uLong crc;
+        ck_assert_int_eq (packContainer(sdcPath, &opt, &entry, 1, resumeSource, &done, &crc), 0);
+        char keyString[96];
+        formatKey(keyString, &opt, crc);
+        UnpackData ud;
+        ck_assert_int_eq (fillUnpackStruct(&ud, keyString), FUS_OK);
+        SdcInput in;
+        ck_assert_int_eq (openInput(&in, sdcPath, 0), 0);
+        uint32_t hdrSize;
+        readInput(&in, 0, &hdrSize, 4);
+        Header *hdr = (Header*)malloc(getDataOutputSize(hdrSize));
+        ck_assert_int_eq (loadHeader(&in, hdr, hdrSize, &ud), DD_OK);
+        ck_assert_int_eq (decodeFileNames(hdr, hdrSize, &ud), DD_OK);
+        SdcEntry sdcEntry;
+        fillEntries(&sdcEntry, hdr, hdrSize, (FileName*)&hdr->files[1]);
+        char out[] = "/tmp/check_xsdcXXXXXX";
+        close(mkstemp(out));
+        sdcEntry.outFile = out;
+
+        unlink(path);
+        ck_assert_int_eq (initResume(&rs, path, &key, 1, 0x100000), 0);
+        Extractor ex;
+        memset(&ex, 0, sizeof(ex));
+        ex.in = &in;
+        ex.signature = hdr->headerSignature;
+        ex.xorVal = ud.xorVal % 0x100;
+        ex.resume = &rs;
+        ExtractState st;
+        ck_assert_int_eq (initExtractState(&st, ex.signature), Z_OK);
+        SdcEntry cut = sdcEntry;
+        cut.compressedSize /= 2;
+        ck_assert_int_eq (extractEntry(&ex, &st, &cut), EX_EOF);
+        ck_assert_int_ne (resumePoint(&rs, 0, point), 0);
+        ck_assert_uint_ge (point->output, 0x100000);
+
+        //bytes before checkpoint are not written again
+        FILE *f = fopen(out, "r+");
+        fputc('#', f);
+        fclose(f);
+        ck_assert_int_eq (extractEntry(&ex, &st, &sdcEntry), EX_OK);
+        ck_assert_int_ne (resumeDone(&rs, 0), 0);
+        ck_assert_int_eq (resumePoint(&rs, 0, point), 0);
+        f = fopen(out, "r");
+        ck_assert_int_eq (fgetc(f), '#');
+        uint64_t pos;
+        int c, same = 1;
+        for(pos = 1; (c = fgetc(f)) != EOF; pos++)
+            same &= c == resumeByte(pos);
+        fclose(f);
+        ck_assert_int_eq (same, 1);
+        ck_assert_uint_eq (pos, entry.size);
+
+        //done entry is skipped while its file is whole
+        ck_assert_int_eq (extractEntry(&ex, &st, &sdcEntry), EX_OK);
+        f = fopen(out, "r");
+        ck_assert_int_eq (fgetc(f), '#');
+        fclose(f);
+
+        freeExtractState(&st);
+        freeResume(&rs);
+        free(hdr);
+        closeInput(&in);
+        unlink(out);
+        unlink(sdcPath);
+    }
+    free(point);
+    unlink(path);
+}
+END_TEST
+
+static pthread_mutex_t batchLock = PTHREAD_MUTEX_INITIALIZER;
+static size_t batchUsed, batchPeak;
+
+static int batchUnpack(BatchItem *item, void *arg)
+{
+    pthread_mutex_lock(&batchLock);
+    batchUsed += item->memory;
+    if(batchUsed > batchPeak)
+        batchPeak = batchUsed;
+    pthread_mutex_unlock(&batchLock);
+    usleep(1000);
+    pthread_mutex_lock(&batchLock);
+    batchUsed -= item->memory;
+    pthread_mutex_unlock(&batchLock);
+    //odd sized containers fail
+    return item->size % 2;
+}
+
+//hashed letters, unlike resumeByte they do not fit into one deflate block
+static uint8_t seekByte(uint64_t pos)
+{
+    uint64_t x = (pos / 2 + 1) * 0x9e3779b97f4a7c15ULL;
+    x ^= x >> 31;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    return "abcdefghijklmnop"[(x >> 60) & 0xf];
+}
+
+static size_t seekSource(void *arg, uint32_t index, uint8_t *buffer, size_t length)
+{
+    uint64_t *done = (uint64_t*)arg;
+    size_t i;
+    for(i = 0; i < length; i++)
+        buffer[i] = seekByte(*done + i);
+    *done += length;
+    return length;
+}
+
+START_TEST (test_check_seek)
+{
+    uint32_t signatures[] = {SIG_ENCRYPTED, SIG_ELARGE};
+    int variant;
+    for(variant = 0; variant < 2; variant++)
+    {
+        PackEntry entry = {"big.txt", 0x200000, 0};
+        char path[] = "/tmp/check_xsdcXXXXXX";
+        close(mkstemp(path));
+        PackOptions opt;
+        initPackOptions(&opt, variant + 5);
+        opt.signature = signatures[variant];
+        uint64_t done = 0;
+        uLong crc;
+        ck_assert_int_eq (packContainer(path, &opt, &entry, 1, seekSource, &done, &crc), 0);
+        char key[96];
+        formatKey(key, &opt, crc);
+
+        //backward seeks without points start over, with them go on from the nearest
+        uint64_t span;
+        for(span = 0; span <= 0x40000; span += 0x40000)
+        {
+            XsdmArchive *ar;
+            XsdmReader *rd;
+            ck_assert_int_eq (xsdmOpenPath(&ar, path, key, NULL), 0);
+            xsdmSetSeekSpan(ar, span);
+            ck_assert_int_eq (xsdmOpenEntry(ar, 0, &rd), 0);
+            uint8_t buffer[0x10000];
+            while(xsdmRead(rd, buffer, sizeof(buffer)) > 0)
+                ;
+            ck_assert_uint_eq (xsdmTell(rd), entry.size);
+            uint64_t offsets[] = {0x1f0001, 5, 0x123457, 0x123457, 0x80000, entry.size - 7};
+            int i;
+            for(i = 0; i < 6; i++)
+            {
+                ck_assert_int_eq (xsdmSeek(rd, offsets[i]), 0);
+                ck_assert_uint_eq (xsdmTell(rd), offsets[i]);
+                ssize_t bytes = xsdmRead(rd, buffer, 1000);
+                ck_assert_int_eq (bytes, offsets[i] + 1000 > entry.size ? entry.size - offsets[i] : 1000);
+                int j;
+                for(j = 0; j < bytes; j++)
+                    ck_assert_uint_eq (buffer[j], seekByte(offsets[i] + j));
+            }
+            ck_assert_int_eq (xsdmSeek(rd, entry.size + 1), EINVAL);
+
+            //blocks come back in any order, least recently used is dropped
+            BlockCache cache;
+            ck_assert_int_eq (initBlockCache(&cache, 0x10000, 0x30000), 0);
+            uint64_t ranges[][2] = {{0x1ffff0, 0x100}, {0x0fff0, 0x20}, {0x150000, 0x10000}, {0, 3}, {0x10005, 9}};
+            for(i = 0; i < 5; i++)
+            {
+                ssize_t bytes = readRange(&cache, rd, 0, entry.size, buffer, ranges[i][1], ranges[i][0]);
+                ck_assert_int_eq (bytes, ranges[i][0] + ranges[i][1] > entry.size ? entry.size - ranges[i][0] : ranges[i][1]);
+                int j;
+                for(j = 0; j < bytes; j++)
+                    ck_assert_uint_eq (buffer[j], seekByte(ranges[i][0] + j));
+                ck_assert_uint_le (cache.used, cache.budget);
+            }
+            ck_assert_uint_eq (cache.hits, 2);
+            ck_assert_ptr_ne (findBlock(&cache, 0, 1), NULL);
+            ck_assert_ptr_eq (findBlock(&cache, 0, 0x1f), NULL);
+            ck_assert_int_eq (readRange(&cache, rd, 0, entry.size, buffer, 10, entry.size), 0);
+            freeBlockCache(&cache);
+            xsdmCloseEntry(rd);
+            xsdmClose(ar);
+        }
+        unlink(path);
+    }
+}
+END_TEST
+
+START_TEST (test_check_seekindex)
+{
+    uint32_t signatures[] = {SIG_ENCRYPTED, SIG_ELARGE};
+    int variant;
+    for(variant = 0; variant < 2; variant++)
+    {
+        PackEntry entry = {"big.txt", 0x300000, 0};
+        char sdcPath[] = "/tmp/check_xsdcXXXXXX";
+        close(mkstemp(sdcPath));
+        PackOptions opt;
+        initPackOptions(&opt, variant + 9);
+        opt.signature = signatures[variant];
+        uint64_t done = 0;
+        uLong crc;
+        ck_assert_int_eq (packContainer(sdcPath, &opt, &entry, 1, seekSource, &done, &crc), 0);
+        char keyString[96];
+        formatKey(keyString, &opt, crc);
+        UnpackData ud;
+        ck_assert_int_eq (fillUnpackStruct(&ud, keyString), FUS_OK);
+        SdcInput in;
+        ck_assert_int_eq (openInput(&in, sdcPath, variant), 0);
+        uint32_t hdrSize;
+        readInput(&in, 0, &hdrSize, 4);
+        Header *hdr = (Header*)malloc(getDataOutputSize(hdrSize));
+        ck_assert_int_eq (loadHeader(&in, hdr, hdrSize, &ud), DD_OK);
+        ck_assert_int_eq (decodeFileNames(hdr, hdrSize, &ud), DD_OK);
+        SdcEntry sdcEntry;
+        fillEntries(&sdcEntry, hdr, hdrSize, (FileName*)&hdr->files[1]);
+        char out[] = "/tmp/check_xsdcXXXXXX";
+        close(mkstemp(out));
+        sdcEntry.outFile = out;
+
+        //points are recorded while entry is unpacked as usual
+        IndexKey key;
+        ck_assert_int_eq (indexKey(&key, fileno(in.file), &ud), 0);
+        SeekIndex si;
+        initSeekIndex(&si, &key, 0x80000);
+        Extractor ex;
+        memset(&ex, 0, sizeof(ex));
+        ex.in = &in;
+        ex.signature = hdr->headerSignature;
+        ex.xorVal = ud.xorVal % 0x100;
+        ex.points = &si;
+        ex.countCrc = 1;
+        ExtractState st;
+        ck_assert_int_eq (initExtractState(&st, ex.signature), Z_OK);
+        ck_assert_int_eq (extractEntry(&ex, &st, &sdcEntry), EX_OK);
+        uLong serialCrc = sdcEntry.crc;
+        ck_assert_uint_ge (si.header.count, 4);
+        char path[] = "/tmp/check_xsdcXXXXXX";
+        close(mkstemp(path));
+        ck_assert_int_eq (saveSeekIndex(&si, path), 0);
+        freeSeekIndex(&si);
+
+        //loaded ones split entry, its segments come out the same on several threads
+        initSeekIndex(&si, &key, 0);
+        ck_assert_int_eq (loadSeekIndex(&si, path, 1), 0);
+        ck_assert_int_ne (si.loaded, 0);
+        const Checkpoint *first;
+        ck_assert_uint_eq (entrySeekPoints(&si, 0, &first), si.header.count);
+        ck_assert_uint_eq (entrySeekPoints(&si, 1, &first), 0);
+        unlink(out);
+        ex.segments = 3;
+        ck_assert_int_eq (extractEntry(&ex, &st, &sdcEntry), EX_OK);
+        ck_assert_uint_eq (sdcEntry.crc, serialCrc);
+        ck_assert_uint_eq (sdcEntry.crcLength, sdcEntry.compressedSize);
+        FILE *f = fopen(out, "r");
+        uint64_t pos;
+        int c, same = 1;
+        for(pos = 0; (c = fgetc(f)) != EOF; pos++)
+            same &= c == seekByte(pos);
+        fclose(f);
+        ck_assert_int_eq (same, 1);
+        ck_assert_uint_eq (pos, entry.size);
+
+        //damaged segment fails entry
+        sdcEntry.compressedSize -= 10;
+        ck_assert_int_ne (extractEntry(&ex, &st, &sdcEntry), EX_OK);
+        sdcEntry.compressedSize += 10;
+        freeSeekIndex(&si);
+
+        //library takes them by content, not by identity of container file
+        XsdmArchive *ar;
+        XsdmReader *rd;
+        ck_assert_int_eq (xsdmOpenPath(&ar, sdcPath, keyString, NULL), 0);
+        ck_assert_int_eq (xsdmLoadSeekPoints(ar, path), 0);
+        ck_assert_int_eq (xsdmOpenEntry(ar, 0, &rd), 0);
+        ck_assert_int_eq (xsdmSeek(rd, entry.size - 5), 0);
+        uint8_t tail[8];
+        ck_assert_int_eq (xsdmRead(rd, tail, sizeof(tail)), 5);
+        ck_assert_uint_eq (tail[4], seekByte(entry.size - 1));
+        xsdmCloseEntry(rd);
+        xsdmClose(ar);
+
+        //other key or damaged index is not used
+        key.keyHash++;
+        initSeekIndex(&si, &key, 0);
+        ck_assert_int_eq (loadSeekIndex(&si, path, 1), ENOENT);
+        freeSeekIndex(&si);
+        key.keyHash--;
+        f = fopen(path, "r+");
+        fseek(f, sizeof(SeekIndexHeader) + 100, SEEK_SET);
+        fputc(0x55, f);
+        fclose(f);
+        initSeekIndex(&si, &key, 0);
+        ck_assert_int_eq (loadSeekIndex(&si, path, 1), ENOENT);
+        freeSeekIndex(&si);
+        ck_assert_int_eq (xsdmOpenPath(&ar, sdcPath, keyString, NULL), 0);
+        ck_assert_int_eq (xsdmLoadSeekPoints(ar, path), EBADMSG);
+        xsdmClose(ar);
+
+        freeExtractState(&st);
+        free(hdr);
+        closeInput(&in);
+        unlink(out);
+        unlink(path);
+        unlink(sdcPath);
+    }
+}
+END_TEST
+
+START_TEST (test_check_batch)
+{
+    BatchItem *items = NULL;
+    uint32_t count = 0, i;
+    off_t sizes[] = {10, 500, 30, 400, 20, 300, 7};
+    for(i = 0; i < 7; i++)
+    {
+        ck_assert_int_eq (addBatchItem(&items, &count, "c.sdc", NULL), 0);
+        items[i].size = sizes[i];
+        items[i].memory = sizes[i];
+    }
+
+    //largest and smallest alternate
+    uint32_t order[7];
+    uint32_t expected[] = {1, 6, 3, 0, 5, 4, 2};
+    orderBatch(items, count, order);
+    for(i = 0; i < 7; i++)
+        ck_assert_int_eq (order[i], expected[i]);
+
+    //budget fits largest one, but not two large ones together
+    batchUsed = batchPeak = 0;
+    ck_assert_int_eq (runBatch(items, count, 4, 600, batchUnpack, NULL, NULL), 1);
+    ck_assert_int_le (batchPeak, 600);
+    for(i = 0; i < count; i++)
+    {
+        ck_assert_int_eq (items[i].done, 1);
+        ck_assert_int_eq (items[i].status, sizes[i] % 2);
+    }
+
+    //item over budget still runs when it is alone
+    batchUsed = batchPeak = 0;
+    ck_assert_int_eq (runBatch(items, count, 2, 100, batchUnpack, NULL, NULL), 1);
+    ck_assert_int_eq (batchPeak, 500);
+    freeBatchItems(items, count);
+}
+END_TEST
+
+START_TEST (test_check_xorkernels)
+{
+    //odd sizes and offsets exercise vector bodies as well as scalar tails
+    unsigned char *expected = (unsigned char*)malloc(4096);
+    unsigned char *actual = (unsigned char*)malloc(4096);
+    void (*kernels[])(uint8_t, unsigned char*, size_t) = { xorSse2, xorAvx2, xorAvx512 };
+    KernelLevel levels[] = { KL_SSE2, KL_AVX2, KL_AVX512 };
+    int i, k;
+    size_t size, offset;
+    for(i = 0; i < 4096; i++)
+        expected[i] = i * 31 + 7;
+    for(k = 0; k < 3; k++)
+    {
+        if(!xorKernelSupported(levels[k]))
+            continue;
+        for(size = 0; size < 600; size += 13)
+        {
+            for(offset = 0; offset < 3; offset++)
+            {
+                memcpy(actual, expected, 4096);
+                xorScalar(0xa7, expected + offset, size);
+                kernels[k](0xa7, actual + offset, size);
+                ck_assert_msg (memcmp(expected, actual, 4096) == 0, "level %d, size %zu, offset %zu", levels[k], size, offset);
+            }
+        }
+    }
+    free(expected);
+    free(actual);
+}
+END_TEST
+
+START_TEST (test_check_crckernels)
+{
+    unsigned char *buffer = (unsigned char*)malloc(4096);
+    int i;
+    size_t size, offset;
+    for(i = 0; i < 4096; i++)
+        buffer[i] = i * 131 + (i >> 3);
+    for(size = 0; size < 4000; size += 7)
+    {
+        for(offset = 0; offset < 5; offset++)
+        {
+            uLong expected = crc32(0x1234, buffer + offset, size);
+            ck_assert_int_eq (crcScalar(0x1234, buffer + offset, size), expected);
+            if(crcPclmulSupported())
+                ck_assert_int_eq (crcPclmul(0x1234, buffer + offset, size), expected);
+            ck_assert_int_eq (crcKernel(0x1234, buffer + offset, size), expected);
+        }
+    }
+    free(buffer);
+}
+END_TEST
+
 Suite *
 xsdc_suite (void)
 {
@@ -98,9 +1361,30 @@ xsdc_suite (void)
     TCase *tc_core = tcase_create ("Core");
     tcase_add_test (tc_core, test_check_fillunpackstruct);
     tcase_add_test (tc_core, test_check_decryptdata);
+    tcase_add_test (tc_core, test_check_blowfish);
     tcase_add_test (tc_core, test_check_xorbuffer);
     tcase_add_test (tc_core, test_check_dospathtounix);
     tcase_add_test (tc_core, test_check_windatetounix);
+    tcase_add_test (tc_core, test_check_combineentrycrc);
+    tcase_add_test (tc_core, test_check_countcrcparallel);
+    tcase_add_test (tc_core, test_check_output);
+    tcase_add_test (tc_core, test_check_ioring);
+    tcase_add_test (tc_core, test_check_ring);
+    tcase_add_test (tc_core, test_check_pack);
+    tcase_add_test (tc_core, test_check_libxsdm);
+    tcase_add_test (tc_core, test_check_batch);
+    tcase_add_test (tc_core, test_check_keyring);
+    tcase_add_test (tc_core, test_check_selectentries);
+    tcase_add_test (tc_core, test_check_dirtree);
+    tcase_add_test (tc_core, test_check_index);
+    tcase_add_test (tc_core, test_check_inflater);
+    tcase_add_test (tc_core, test_check_stats);
+    tcase_add_test (tc_core, test_check_progress);
+    tcase_add_test (tc_core, test_check_resume);
+    tcase_add_test (tc_core, test_check_seek);
+    tcase_add_test (tc_core, test_check_seekindex);
+    tcase_add_test (tc_core, test_check_xorkernels);
+    tcase_add_test (tc_core, test_check_crckernels);
     suite_add_tcase (s, tc_core);
 
     return s;